@@ -0,0 +1,402 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+
+#include "agent.hpp"
+#include "bash_tool.hpp"
+#include "event_loop.hpp"
+#include "file_tools.hpp"
+#include "http_client.hpp"
+#include "mock_server.hpp"
+#include "request_builder.hpp"
+#include "request_scheduler.hpp"
+#include "tool_executor.hpp"
+#include "trace.hpp"
+
+using json = nlohmann::json;
+using bench_clock = std::chrono::steady_clock;
+
+// end to end turns against a local mock, the cost of building the request body
+// as the conversation grows, and raw tool throughput. numbers go to stdout,
+// --json keeps them and --baseline compares a run against kept numbers
+
+namespace {
+
+struct BenchConfig {
+    bool quick = false;
+    int turns = 8;            // tool rounds per conversation, plus the final answer
+    int runs = 20;            // conversations per latency scenario
+    int latency_ms = 20;      // mock latency of the second latency scenario
+    size_t payload_bytes = 0; // filler in every mock answer
+    size_t file_bytes = 64 * 1024;
+    bool timings = false;
+    std::string json_file;
+    std::string baseline_file;
+    double tolerance = 0.25;  // allowed slowdown against the baseline
+};
+
+struct Result {
+    std::string name;
+    double value = 0;
+    std::string unit;
+    bool lower_is_better = true;
+};
+
+double elapsed_us(bench_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(bench_clock::now() - start).count();
+}
+
+double percentile(std::vector<double> samples, double p) {
+    if (samples.empty()) return 0;
+    std::sort(samples.begin(), samples.end());
+    size_t index = static_cast<size_t>(p * (samples.size() - 1) + 0.5);
+    return samples[std::min(index, samples.size() - 1)];
+}
+
+BenchConfig parse_args(int argc, char* argv[]) {
+    BenchConfig config;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--quick") {
+            config.quick = true;
+            config.turns = 3;
+            config.runs = 3;
+            config.latency_ms = 5;
+        }
+        else if (arg == "--turns" && i + 1 < argc) {
+            config.turns = std::stoi(argv[++i]);
+        }
+        else if (arg == "--runs" && i + 1 < argc) {
+            config.runs = std::stoi(argv[++i]);
+        }
+        else if (arg == "--latency-ms" && i + 1 < argc) {
+            config.latency_ms = std::stoi(argv[++i]);
+        }
+        else if (arg == "--payload-bytes" && i + 1 < argc) {
+            config.payload_bytes = std::stoul(argv[++i]);
+        }
+        else if (arg == "--file-bytes" && i + 1 < argc) {
+            config.file_bytes = std::stoul(argv[++i]);
+        }
+        else if (arg == "--timings") {
+            config.timings = true;
+        }
+        else if (arg == "--json" && i + 1 < argc) {
+            config.json_file = argv[++i];
+        }
+        else if (arg == "--baseline" && i + 1 < argc) {
+            config.baseline_file = argv[++i];
+        }
+        else if (arg == "--tolerance" && i + 1 < argc) {
+            config.tolerance = std::stod(argv[++i]) / 100.0;
+        }
+        else {
+            throw std::runtime_error("Unknown argument: " + arg);
+        }
+    }
+
+    if (config.turns < 1 || config.runs < 1 || config.latency_ms < 0) {
+        throw std::runtime_error("--turns and --runs must be at least 1, --latency-ms must not be negative");
+    }
+    return config;
+}
+
+void write_text(const std::string& path, size_t bytes) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    std::string line = "the quick brown fox jumps over the lazy dog 0123456789\n";
+    for (size_t written = 0; written < bytes; written += line.size()) {
+        out.write(line.data(), std::min(line.size(), bytes - written));
+    }
+}
+
+// each turn reads a file of its own, so the read cache never shortcuts one
+std::vector<MockTurn> conversation_script(int turns) {
+    std::vector<MockTurn> script;
+    for (int i = 0; i < turns; ++i) {
+        std::string path = "turn" + std::to_string(i) + ".txt";
+        write_text(path, 2048);
+        script.push_back({ { { "read_file", { { "path", path } } } } });
+    }
+    return script;
+}
+
+// full conversations through the real agent loop, client pool and tools.
+// adds the per turn latency (model wait included) and what is left after the mock's wait
+bool bench_turns(const BenchConfig& config, int latency_ms, std::vector<Result>& results) {
+    MockServerOptions mock;
+    mock.script = conversation_script(config.turns);
+    mock.latency = std::chrono::milliseconds(latency_ms);
+    mock.payload_bytes = config.payload_bytes;
+
+    MockChatServer server(std::move(mock));
+    std::string error;
+    if (!server.start(error)) {
+        std::cerr << "mock server: " << error << std::endl;
+        return false;
+    }
+
+    EventLoop loop;
+    ChatClientPool clients(loop, server.base_url(), "bench", 1);
+    clients.prewarm();
+
+    ToolRegistry registry;
+    registry.emplace<ReadFileTool>();
+    registry.emplace<WriteFileTool>();
+    registry.emplace<BashTool>();
+    ToolExecutor executor(loop, registry, 4);
+
+    RetryPolicy retry;
+    retry.max_retries = 0;
+    RequestScheduler scheduler(loop, retry);
+
+    Trace trace;
+    AgentEnv env{ clients, executor, scheduler, config.timings ? &trace : nullptr };
+
+    AgentOptions options;
+    options.max_iterations = config.turns + 1;
+
+    std::vector<double> per_turn;
+    for (int run = 0; run < config.runs; ++run) {
+        auto start = bench_clock::now();
+        AgentResult result = loop.block_on(run_agent(env, options, "benchmark conversation"));
+        double us = elapsed_us(start);
+
+        if (result.status != AgentResult::Status::Ok || result.iterations != config.turns + 1) {
+            std::cerr << "conversation " << run << " ended " << status_name(result.status)
+                << " after " << result.iterations << " turns: " << result.error << std::endl;
+            return false;
+        }
+        per_turn.push_back(us / result.iterations);
+    }
+
+    if (server.bad_requests() > 0) {
+        std::cerr << "mock server rejected " << server.bad_requests() << " requests" << std::endl;
+        return false;
+    }
+
+    const std::string prefix = "turn.latency_" + std::to_string(latency_ms) + "ms.";
+    const double median = percentile(per_turn, 0.5);
+    results.push_back({ prefix + "p50", median, "us" });
+    results.push_back({ prefix + "p95", percentile(per_turn, 0.95), "us" });
+    results.push_back({ prefix + "overhead_p50", std::max(0.0, median - latency_ms * 1000.0), "us" });
+
+    if (config.timings) {
+        std::cerr << "--- " << prefix << " trace" << std::endl;
+        trace.print_summary(std::cerr);
+    }
+    return true;
+}
+
+json history_message(size_t index, size_t bytes) {
+    std::string id = "call_" + std::to_string(index);
+    if (index % 2 == 0) {
+        return {
+            { "role", "assistant" },
+            { "content", nullptr },
+            { "tool_calls", json::array({ { { "id", id }, { "type", "function" },
+                { "function", { { "name", "read_file" }, { "arguments", R"({"path":"src/main.cpp"})" } } } } }) },
+        };
+    }
+    return { { "role", "tool" }, { "tool_call_id", "call_" + std::to_string(index - 1) }, { "content", std::string(bytes, 'x') } };
+}
+
+// what one more turn costs to serialize once the history holds n messages:
+// RequestBuilder only dumps the new message, a plain json body dumps everything
+void bench_serialization(const BenchConfig& config, std::vector<Result>& results) {
+    ToolRegistry registry;
+    registry.emplace<ReadFileTool>();
+    registry.emplace<WriteFileTool>();
+    registry.emplace<BashTool>();
+    const json tools = registry.schema();
+
+    const size_t message_bytes = std::max<size_t>(config.payload_bytes, 1024);
+    std::vector<size_t> sizes = config.quick ? std::vector<size_t>{ 10, 100 } : std::vector<size_t>{ 10, 100, 1000 };
+    const int rounds = config.quick ? 4 : 20;
+
+    for (size_t n : sizes) {
+        RequestBuilder builder;
+        builder.history().set_budget(static_cast<size_t>(1) << 40);
+        builder.set_param("model", "anthropic/claude-haiku-4.5");
+        builder.set_tools_json(registry.schema_json());
+        builder.pin({ { "role", "user" }, { "content", "benchmark conversation" } });
+
+        json plain = { { "model", "anthropic/claude-haiku-4.5" }, { "tools", tools }, { "messages", json::array() } };
+        plain["messages"].push_back({ { "role", "user" }, { "content", "benchmark conversation" } });
+
+        for (size_t i = 0; i < n; ++i) {
+            builder.append(history_message(i, message_bytes));
+            plain["messages"].push_back(history_message(i, message_bytes));
+        }
+        // the agent builds into the same buffer every turn
+        std::string request_body;
+        builder.build_into(request_body);
+
+        // two messages a round keep every tool result next to its call
+        double builder_us = 0;
+        double plain_us = 0;
+        size_t body_bytes = 0;
+        for (int round = 0; round < rounds; ++round) {
+            const size_t index = n + 2 * static_cast<size_t>(round);
+
+            auto start = bench_clock::now();
+            builder.append(history_message(index, message_bytes));
+            builder.append(history_message(index + 1, message_bytes));
+            builder.build_into(request_body);
+            body_bytes = request_body.size();
+            builder_us += elapsed_us(start);
+
+            start = bench_clock::now();
+            plain["messages"].push_back(history_message(index, message_bytes));
+            plain["messages"].push_back(history_message(index + 1, message_bytes));
+            std::string body = plain.dump();
+            plain_us += elapsed_us(start);
+        }
+
+        const std::string prefix = "serialize." + std::to_string(n) + "msgs.";
+        results.push_back({ prefix + "builder", builder_us / rounds, "us" });
+        results.push_back({ prefix + "full_dump", plain_us / rounds, "us" });
+        results.push_back({ prefix + "body", static_cast<double>(body_bytes), "bytes" });
+    }
+}
+
+// calls per second of one tool run directly, args built once
+bool bench_tool(Tool& tool, const std::string& name, const json& args, double seconds, size_t bytes_per_call,
+                std::vector<Result>& results)
+{
+    ToolContext ctx;
+    ctx.call_id = "bench";
+
+    size_t calls = 0;
+    auto start = bench_clock::now();
+    auto deadline = start + std::chrono::duration<double>(seconds);
+    do {
+        std::string out;
+        tool.execute(args, ctx, out);
+        if (out.starts_with("ERROR")) {
+            std::cerr << name << ": " << out.substr(0, 200) << std::endl;
+            return false;
+        }
+        calls++;
+    } while (bench_clock::now() < deadline);
+
+    const double elapsed = elapsed_us(start) / 1e6;
+    results.push_back({ "tool." + name + ".calls_per_s", calls / elapsed, "1/s", false });
+    if (bytes_per_call > 0) {
+        results.push_back({ "tool." + name + ".mb_per_s", calls * bytes_per_call / elapsed / 1e6, "MB/s", false });
+    }
+    return true;
+}
+
+bool bench_tools(const BenchConfig& config, std::vector<Result>& results) {
+    const double seconds = config.quick ? 0.2 : 1.0;
+    const size_t bytes = std::min(config.file_bytes, ReadFileTool::MAX_SIZE);
+
+    write_text("read_bench.txt", bytes);
+    std::string content(bytes, 'x');
+
+    ReadFileTool read;
+    WriteFileTool write;
+    BashTool bash;
+    return bench_tool(read, "read_file", { { "path", "read_bench.txt" } }, seconds, bytes, results) &&
+        bench_tool(write, "write_file", { { "path", "write_bench.txt" }, { "content", content } }, seconds, bytes, results) &&
+        bench_tool(bash, "bash", { { "command", "echo bench" } }, seconds, 0, results);
+}
+
+// slower than the baseline by more than the tolerance, for every result both runs have
+int compare(const std::vector<Result>& results, const std::string& path, double tolerance) {
+    std::ifstream in(path);
+    json baseline = in ? json::parse(in, nullptr, false) : json();
+    if (!baseline.is_object() || !baseline.contains("results")) {
+        std::cerr << "could not read baseline " << path << std::endl;
+        return 1;
+    }
+
+    int regressions = 0;
+    for (const auto& result : results) {
+        if (result.unit == "bytes") continue;
+        for (const auto& old : baseline["results"]) {
+            if (old.value("name", "") != result.name || !old.contains("value")) continue;
+
+            double before = old["value"].get<double>();
+            double change = before > 0 ? (result.value - before) / before : 0;
+            bool worse = result.lower_is_better ? change > tolerance : change < -tolerance;
+            if (worse) {
+                regressions++;
+                std::fprintf(stderr, "REGRESSION %s: %.1f -> %.1f %s (%+.0f%%)\n",
+                             result.name.c_str(), before, result.value, result.unit.c_str(), change * 100);
+            }
+        }
+    }
+    return regressions == 0 ? 0 : 1;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    BenchConfig config;
+    try {
+        config = parse_args(argc, argv);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    // the tools only write relative paths, so everything happens in a scratch directory
+    std::error_code ec;
+    const std::filesystem::path home = std::filesystem::current_path();
+    const std::filesystem::path scratch = std::filesystem::temp_directory_path() /
+        ("claude-code-bench-" + std::to_string(::getpid()));
+    std::filesystem::create_directories(scratch, ec);
+    std::filesystem::current_path(scratch, ec);
+    if (ec) {
+        std::cerr << "could not enter " << scratch << ": " << ec.message() << std::endl;
+        return 1;
+    }
+
+    std::vector<Result> results;
+    bool ok = bench_turns(config, 0, results) && bench_turns(config, config.latency_ms, results);
+    if (ok) {
+        bench_serialization(config, results);
+        ok = bench_tools(config, results);
+    }
+
+    std::filesystem::current_path(home, ec);
+    std::filesystem::remove_all(scratch, ec);
+
+    for (const auto& result : results) {
+        std::printf("%-40s %14.1f %s\n", result.name.c_str(), result.value, result.unit.c_str());
+    }
+    if (!ok) return 1;
+
+    if (!config.json_file.empty()) {
+        json out = { { "results", json::array() } };
+        for (const auto& result : results) {
+            out["results"].push_back({ { "name", result.name }, { "value", result.value }, { "unit", result.unit },
+                                       { "lower_is_better", result.lower_is_better } });
+        }
+        std::ofstream file(config.json_file);
+        file << out.dump(2) << std::endl;
+        if (!file) {
+            std::cerr << "could not write " << config.json_file << std::endl;
+            return 1;
+        }
+    }
+
+    if (!config.baseline_file.empty()) {
+        return compare(results, config.baseline_file, config.tolerance);
+    }
+    return 0;
+}
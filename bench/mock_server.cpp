@@ -0,0 +1,218 @@
+#include "mock_server.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string_view>
+#include <strings.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+bool send_all(int fd, std::string_view data) {
+    while (!data.empty()) {
+        ssize_t n = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data.remove_prefix(static_cast<size_t>(n));
+    }
+    return true;
+}
+
+std::string response(int status, const char* reason, std::string_view body) {
+    std::string out = "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+    out.append(body);
+    return out;
+}
+
+// words rather than one repeated byte, so the json and any compression see text
+std::string filler(size_t bytes) {
+    static const std::string_view WORDS = "lorem ipsum dolor sit amet consectetur adipiscing elit ";
+    std::string out;
+    out.reserve(bytes);
+    while (out.size() < bytes) out.append(WORDS.substr(0, std::min(WORDS.size(), bytes - out.size())));
+    return out;
+}
+
+}
+
+MockChatServer::MockChatServer(MockServerOptions options) : options(std::move(options)) {}
+
+MockChatServer::~MockChatServer() {
+    stop();
+}
+
+bool MockChatServer::start(std::string& error) {
+    listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        error = std::string("socket: ") + std::strerror(errno);
+        return false;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+
+    socklen_t length = sizeof(addr);
+    if (::bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listen_fd, 64) != 0 ||
+        ::getsockname(listen_fd, reinterpret_cast<sockaddr*>(&addr), &length) != 0)
+    {
+        error = std::string("listen: ") + std::strerror(errno);
+        ::close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+
+    port = ntohs(addr.sin_port);
+    acceptor = std::thread([this] { accept_loop(); });
+    return true;
+}
+
+void MockChatServer::stop() {
+    if (stopping.exchange(true)) return;
+
+    if (acceptor.joinable()) acceptor.join();
+    if (listen_fd >= 0) ::close(listen_fd);
+
+    // wakes every connection still waiting for its next request
+    std::lock_guard lock(mutex);
+    for (auto& [fd, thread] : connections) {
+        ::shutdown(fd, SHUT_RDWR);
+        thread.join();
+        ::close(fd);
+    }
+    connections.clear();
+}
+
+std::string MockChatServer::base_url() const {
+    return "http://127.0.0.1:" + std::to_string(port) + "/v1";
+}
+
+void MockChatServer::accept_loop() {
+    while (!stopping) {
+        pollfd pfd{ listen_fd, POLLIN, 0 };
+        if (::poll(&pfd, 1, 50) <= 0) continue;
+
+        int fd = ::accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) continue;
+
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        std::lock_guard lock(mutex);
+        connections.emplace_back(fd, std::thread([this, fd] { serve(fd); }));
+    }
+}
+
+void MockChatServer::serve(int fd) {
+    std::string buffer;
+    char chunk[64 * 1024];
+
+    auto fill = [&]() {
+        ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (n < 0 && errno == EINTR) return true;
+        if (n <= 0) return false;
+        buffer.append(chunk, static_cast<size_t>(n));
+        return true;
+    };
+
+    while (!stopping) {
+        size_t head_end;
+        while ((head_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+            if (!fill()) return;
+        }
+
+        std::string_view head(buffer.data(), head_end);
+        std::string_view request_line = head.substr(0, head.find("\r\n"));
+
+        size_t content_length = 0;
+        for (size_t pos = head.find("\r\n"); pos != std::string_view::npos && pos < head.size();) {
+            size_t next = head.find("\r\n", pos + 2);
+            std::string_view line = head.substr(pos + 2, (next == std::string_view::npos ? head.size() : next) - pos - 2);
+            static constexpr std::string_view KEY = "content-length:";
+            if (line.size() > KEY.size() && ::strncasecmp(line.data(), KEY.data(), KEY.size()) == 0) {
+                content_length = std::stoul(std::string(line.substr(KEY.size())));
+            }
+            pos = next;
+        }
+
+        const size_t total = head_end + 4 + content_length;
+        while (buffer.size() < total) {
+            if (!fill()) return;
+        }
+
+        std::string out;
+        if (request_line.starts_with("HEAD ")) {
+            out = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n";
+        }
+        else if (!request_line.starts_with("POST ") || request_line.find("/chat/completions") == std::string_view::npos) {
+            bad_requests_++;
+            out = response(404, "Not Found", R"({"error":{"message":"not found"}})");
+        }
+        else {
+            requests_++;
+            std::string body = answer(buffer.substr(head_end + 4, content_length));
+            if (body.empty()) {
+                bad_requests_++;
+                out = response(400, "Bad Request", R"({"error":{"message":"bad request body"}})");
+            }
+            else {
+                if (options.latency.count() > 0) std::this_thread::sleep_for(options.latency);
+                out = response(200, "OK", body);
+            }
+        }
+
+        buffer.erase(0, total);
+        if (!send_all(fd, out)) return;
+    }
+}
+
+std::string MockChatServer::answer(const std::string& body) {
+    json request = json::parse(body, nullptr, false);
+    if (request.is_discarded() || !request.contains("messages") || !request["messages"].is_array()) return "";
+
+    size_t turn = 0;
+    for (const auto& message : request["messages"]) {
+        if (message.value("role", "") == "assistant") turn++;
+    }
+
+    json message = { { "role", "assistant" } };
+    std::string finish = "stop";
+
+    if (turn < options.script.size() && !options.script[turn].calls.empty()) {
+        json calls = json::array();
+        const auto& script = options.script[turn].calls;
+        for (size_t i = 0; i < script.size(); ++i) {
+            calls.push_back({
+                { "id", "call_" + std::to_string(turn) + "_" + std::to_string(i) },
+                { "type", "function" },
+                { "function", { { "name", script[i].name }, { "arguments", script[i].arguments.dump() } } },
+            });
+        }
+        message["content"] = options.payload_bytes > 0 ? json(filler(options.payload_bytes)) : json(nullptr);
+        message["tool_calls"] = std::move(calls);
+        finish = "tool_calls";
+    }
+    else {
+        message["content"] = "done after " + std::to_string(turn) + " turns. " + filler(options.payload_bytes);
+    }
+
+    json completion = {
+        { "id", "mock-" + std::to_string(requests_.load()) },
+        { "model", request.value("model", "") },
+        { "choices", json::array({ { { "index", 0 }, { "message", std::move(message) }, { "finish_reason", finish } } }) },
+        { "usage", { { "prompt_tokens", body.size() / 4 }, { "completion_tokens", 16 + options.payload_bytes / 4 },
+                     { "total_tokens", body.size() / 4 + 16 + options.payload_bytes / 4 } } },
+    };
+    return completion.dump();
+}
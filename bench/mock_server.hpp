@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// one tool call the mock asks for
+struct MockCall {
+    std::string name;
+    json arguments;
+};
+
+// what the mock answers on one turn: the calls, or a plain answer when there are none
+struct MockTurn {
+    std::vector<MockCall> calls;
+};
+
+struct MockServerOptions {
+    // turn i answers a request that already holds i assistant messages,
+    // past the end of the script every request gets a plain answer
+    std::vector<MockTurn> script;
+    std::chrono::microseconds latency{ 0 }; // before every answer, a stand in for the model
+    size_t payload_bytes = 0;               // filler content in every answer
+};
+
+// a local /chat/completions endpoint speaking just enough http/1.1 (keep-alive,
+// Content-Length bodies, HEAD for the prewarm) for ChatClient. it keeps no
+// state between requests, the turn comes from the messages the client sends
+class MockChatServer {
+public:
+    explicit MockChatServer(MockServerOptions options);
+    ~MockChatServer();
+
+    MockChatServer(const MockChatServer&) = delete;
+    MockChatServer& operator=(const MockChatServer&) = delete;
+
+    // listens on an ephemeral port on 127.0.0.1, false with error set when it can not
+    bool start(std::string& error);
+    void stop();
+
+    // what goes where OPENROUTER_BASE_URL would
+    std::string base_url() const;
+
+    size_t requests() const { return requests_; }
+    size_t bad_requests() const { return bad_requests_; }
+
+private:
+    void accept_loop();
+    void serve(int fd);
+    std::string answer(const std::string& body);
+
+    MockServerOptions options;
+    int listen_fd = -1;
+    int port = 0;
+    std::atomic<bool> stopping{ false };
+    std::atomic<size_t> requests_{ 0 };
+    std::atomic<size_t> bad_requests_{ 0 };
+
+    std::thread acceptor;
+    std::mutex mutex; // guards connections
+    std::vector<std::pair<int, std::thread>> connections;
+};
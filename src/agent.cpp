@@ -0,0 +1,544 @@
+#include "agent.hpp"
+
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "checkpoint.hpp"
+#include "completion_parser.hpp"
+#include "read_cache.hpp"
+#include "request_builder.hpp"
+#include "sse_stream.hpp"
+
+namespace {
+
+// two copies of one request in flight, shared by both legs and the turn waiting on them
+struct Race {
+    AsyncEvent decided;
+    int running = 2;
+    int winner = -1;
+    cpr::Response responses[2];
+    Completion completions[2];
+    ChatTransport* in_flight[2] = { nullptr, nullptr };
+};
+
+bool usable(const cpr::Response& response, Completion& completion) {
+    if (response.error || response.status_code < 200 || response.status_code >= 300) return false;
+    std::string parse_error;
+    return parse_completion(response.text, completion, parse_error) && completion.error.empty() &&
+        completion.has_message && completion.message.is_object();
+}
+
+Task<void> race_leg(AgentEnv& env, std::shared_ptr<Race> race, int index, std::string body) {
+    co_await env.scheduler.acquire();
+
+    if (race->winner < 0) {
+        auto client = co_await env.clients.acquire();
+        if (race->winner < 0) {
+            race->in_flight[index] = &*client;
+            race->responses[index] = co_await client->post(body);
+            race->in_flight[index] = nullptr;
+            env.scheduler.observe(race->responses[index]);
+
+            if (race->winner < 0 && usable(race->responses[index], race->completions[index])) {
+                race->winner = index;
+                // the slower model's answer is not needed any more, free its connection
+                if (ChatTransport* other = race->in_flight[1 - index]) other->cancel();
+            }
+        }
+    }
+
+    race->running--;
+    if (!race->decided.is_set() && (race->winner == index || race->running == 0)) race->decided.set();
+}
+
+}
+
+const char* status_name(AgentResult::Status status) {
+    switch (status) {
+    case AgentResult::Status::Ok: return "ok";
+    case AgentResult::Status::Error: return "error";
+    case AgentResult::Status::MaxIterations: return "max_iterations";
+    }
+    return "error";
+}
+
+AgentSession::AgentSession(AgentEnv& env, AgentOptions options, ToolRegistry* tools)
+    : env(env), options(std::move(options)), tools(tools ? *tools : env.executor.registry())
+{
+    tag = this->options.label.empty() ? "" : "[" + this->options.label + "] ";
+}
+
+AgentSession::~AgentSession() {
+    // killed processes take a moment to leave the cgroup, a whole batch
+    // must not stand still for that
+    std::string left = sandbox.release();
+    if (!left.empty()) {
+        env.executor.pool().submit([left = std::move(left)]() { remove_cgroup(left); });
+    }
+}
+
+void AgentSession::finish(AgentResult::Status status, std::string error) {
+    done_ = true;
+    result_.status = status;
+    result_.error = std::move(error);
+}
+
+// every message is appended to the log right after it joins the history,
+// in the serialized form the history already holds
+void AgentSession::log_message() {
+    if (checkpoint.is_open()) checkpoint.append(request.history().entries().back().json_text);
+}
+
+bool AgentSession::start(std::string prompt) {
+    if (started) return false;
+    started = true;
+    turn_limit = options.max_iterations;
+
+    std::string sandbox_error;
+    if (!sandbox.open(options.sandbox, sandbox_error)) {
+        finish(AgentResult::Status::Error, "Sandbox error: " + sandbox_error);
+        return false;
+    }
+
+    request.set_param("model", options.model);
+    request.set_param("tool_choice", "auto");
+    if (options.stream) {
+        request.set_param("stream", true);
+        request.set_param("stream_options", { {"include_usage", true} });
+    }
+    request.history().set_budget(options.context_tokens);
+
+    if (options.prompt_cache) {
+        // ask openrouter for the cached token counts, and keep the prefix
+        // stable by evicting in big steps instead of one turn at a time
+        request.set_param("usage", { {"include", true} });
+        request.set_cache_breakpoints(true);
+        request.history().set_low_water(75);
+    }
+
+    bool finished = false;
+    if (options.resume) {
+        Checkpoint loaded;
+        std::string error;
+        if (!load_checkpoint(options.checkpoint, loaded, error)) {
+            finish(AgentResult::Status::Error, "Checkpoint error: " + error);
+            return false;
+        }
+
+        finished = loaded.finished();
+        if (finished) {
+            const json& last = loaded.messages.back();
+            if (last.contains("content") && last["content"].is_string()) result_.output = last["content"];
+        }
+
+        request.pin(loaded.messages[0]);
+        for (size_t i = 1; i < loaded.messages.size(); ++i) {
+            request.append(std::move(loaded.messages[i]));
+        }
+
+        if (options.verbose && !finished) {
+            std::cerr << tag << "resuming " << loaded.messages.size() << " messages from " << options.checkpoint << std::endl;
+        }
+    }
+    else {
+        request.pin({ {"role", "user"}, {"content", std::move(prompt)} });
+    }
+
+    if (!options.checkpoint.empty()) {
+        // a resumed log is rewritten without its torn or incomplete tail first
+        std::vector<std::string_view> lines;
+        for (const auto& entry : request.history().pinned()) lines.push_back(entry.json_text);
+        for (const auto& entry : request.history().entries()) lines.push_back(entry.json_text);
+
+        std::string error;
+        if (!checkpoint.start(options.checkpoint, lines, error)) {
+            finish(AgentResult::Status::Error, "Checkpoint error: " + error);
+            return false;
+        }
+    }
+
+    // re-reads of unchanged files point at the earlier result while it is still in the window
+    request.history().on_evict = [this](const HistoryEntry& entry) {
+        if (!entry.tool_call_id.empty()) read_cache.forget_call(entry.tool_call_id);
+    };
+
+    // a finished log only needs its answer handed back, unless a follow up comes
+    if (finished) finish(AgentResult::Status::Ok);
+    return true;
+}
+
+bool AgentSession::follow_up(std::string message) {
+    if (!done_ || result_.status != AgentResult::Status::Ok) return false;
+
+    request.append({ {"role", "user"}, {"content", std::move(message)} });
+    log_message();
+
+    done_ = false;
+    result_.output.clear();
+    turn_limit = result_.iterations + options.max_iterations;
+    return true;
+}
+
+Task<AgentResult> AgentSession::run() {
+    if (!started) finish(AgentResult::Status::Error, "session was not started");
+    while (!done_) {
+        co_await step();
+    }
+    co_return result_;
+}
+
+Task<void> AgentSession::step() {
+    if (!started || done_) co_return;
+
+    AgentResult& result = result_;
+    Trace* trace = env.trace;
+    auto now_us = [trace]() -> int64_t { return trace ? trace->now_us() : 0; };
+
+    // with a fast model, tool turns go to it and only the final answer to the strong one
+    const bool routing = !options.fast_model.empty() && options.fast_model != options.model && !options.race;
+
+    // the registry may have changed since the last turn, the schema is cached there
+    request.set_tools_json(tools.schema_json());
+
+    const int iterations = ++result.iterations;
+    ScopedSpan turn_span(trace, iterations, "turn");
+
+    const std::string& turn_model = routing && !final_pass ? options.fast_model : options.model;
+    const bool hold_content = routing && !final_pass; // a plain answer from the fast model is thrown away
+    std::string held_content;
+    request.set_param("model", turn_model);
+
+    // whichever way the turn ends, its memory is accounted for
+    struct TurnEnd {
+        TurnBuffers& buffers;
+        const ContextWindow& history;
+        MemoryStats& out;
+        ~TurnEnd() {
+            buffers.end_turn(history.bytes());
+            out = buffers.stats();
+        }
+    } turn_end{ buffers, request.history(), result.memory };
+
+    // reused from turn to turn, the transport sends it from here
+    std::string& request_body = buffers.body();
+    {
+        ScopedSpan span(trace, iterations, "serialize");
+        request.build_into(request_body);
+        span.set_bytes(request.last_reserialized_bytes());
+    }
+    buffers.add(request.last_body_bytes());
+
+    if (options.verbose) {
+        std::cerr << tag << "[turn " << iterations << "] request " << request.last_body_bytes()
+            << " bytes, " << request.last_reserialized_bytes() << " re-serialized, ~"
+            << request.history().tokens() << " tokens, " << request.history().evicted() << " evicted, "
+            << (options.race ? options.fast_model + " vs " + options.model : turn_model) << std::endl;
+    }
+
+    //  giving request to models 
+
+    /*The request goes out through a warm client leased from the shared pool,
+    so every turn after the first reuses an open TCP/TLS connection (and h2
+    stream multiplexing when the server supports it) instead of a fresh
+    handshake. Auth and content type headers are set once per client.
+    While it is in flight the coroutine is parked and the loop serves
+    other conversations and tool calls.
+    */
+
+    cpr::Response response;
+
+    // in stream mode calls are added (and started) while the rest of the
+    // response is still coming in
+    ToolContext session;
+    session.read_cache = &read_cache;
+    session.shell = &shell;
+    if (options.sandbox.enabled()) session.sandbox = &sandbox;
+    session.trace = trace;
+    session.turn = iterations;
+    session.max_result_bytes = request.history().max_result_bytes();
+    ToolBatch batch(env.executor, session, &tools);
+
+    SseParser parser;
+    StreamAssembler assembler;
+
+    int64_t first_token_us = -1;
+    int64_t stream_parse_us = 0;
+
+    // set when a race decided the turn, already parsed
+    std::optional<Completion> raced;
+
+    // a stream that ended without a finish_reason or [DONE], cut off by a proxy
+    bool truncated = false;
+
+    // transient failures are retried instead of throwing the session away.
+    // a stream is only replayed while nothing of it was used yet
+    for (int attempt = 0;; ++attempt) {
+        const int64_t http_start = now_us();
+        first_token_us = -1;
+        stream_parse_us = 0;
+        raced.reset();
+        truncated = false;
+
+        if (options.race) {
+            auto race = std::make_shared<Race>();
+            request.set_param("model", options.fast_model);
+            env.executor.loop().spawn(race_leg(env, race, 0, request.build()));
+            request.set_param("model", options.model);
+            // a copy, the turn buffer keeps its capacity. the losing leg may
+            // still be sending it after this turn is over
+            env.executor.loop().spawn(race_leg(env, race, 1, request_body));
+
+            co_await race->decided.wait();
+            if (race->winner >= 0) {
+                raced = std::move(race->completions[race->winner]);
+                response = std::move(race->responses[race->winner]);
+                if (options.verbose) {
+                    std::cerr << tag << "[turn " << iterations << "] race won by "
+                        << (race->winner == 0 ? options.fast_model : options.model) << std::endl;
+                }
+            }
+            else {
+                // both failed, the strong model's failure decides about retrying
+                response = std::move(race->responses[1]);
+            }
+        }
+        else {
+            co_await env.scheduler.acquire();
+            auto client = co_await env.clients.acquire();
+
+            if (options.stream) {
+                parser = SseParser{};
+                assembler = StreamAssembler{};
+
+                assembler.on_content = [&](std::string_view piece) {
+                    if (first_token_us < 0) first_token_us = now_us();
+                    if (hold_content) held_content += piece;
+                    else if (on_content) on_content(piece);
+                };
+
+                // a call is complete once the next one begins, start it right away
+                assembler.on_tool_call = [&](const json& call) {
+                    if (first_token_us < 0) first_token_us = now_us();
+                    batch.add(call);
+                };
+
+                parser.on_event = [&](std::string_view data) {
+                    const int64_t parse_start = now_us();
+                    try {
+                        assembler.apply(json::parse(data));
+                    }
+                    catch (const json::parse_error&) {
+                        // ignore keep-alive junk, a broken stream shows up as a missing finish_reason below
+                    }
+                    catch (const json::exception& e) {
+                        // nothing may unwind through curl's write callback
+                        if (assembler.error().empty()) assembler.fail(e.what());
+                    }
+                    stream_parse_us += now_us() - parse_start;
+                };
+
+                response = co_await client->post_stream(request_body, [&](std::string_view bytes) {
+                    buffers.add(bytes.size());
+                    parser.feed(bytes);
+                    return true;
+                });
+            }
+            else {
+                response = co_await client->post(request_body, buffers.take_response());
+            }
+
+            env.scheduler.observe(response);
+        }
+
+        if (trace) {
+            trace->record(iterations, "http", "", http_start, now_us() - http_start, response.text.size());
+            if (first_token_us >= 0) {
+                trace->record(iterations, "ttft", "", http_start, first_token_us - http_start);
+            }
+            if (options.stream) {
+                trace->record(iterations, "parse", "", http_start, stream_parse_us);
+            }
+        }
+
+        const bool failed = response.error || response.status_code < 200 || response.status_code >= 300;
+        if (options.stream && !failed) {
+            truncated = assembler.error().empty() && assembler.finish_reason().empty() && !parser.done();
+        }
+
+        const bool consumed = first_token_us >= 0 || batch.size() > 0;
+        if ((!failed && !truncated) || consumed) break;
+
+        auto delay = env.scheduler.retry_delay(response, attempt + 1, truncated);
+        if (!delay) break;
+
+        std::cerr << tag << "[turn " << iterations << "] "
+            << (truncated ? std::string("stream truncated")
+                : response.error ? response.error.message : "HTTP " + std::to_string(response.status_code))
+            << ", retrying in " << delay->count() << " ms (" << attempt + 1 << "/"
+            << env.scheduler.policy().max_retries << ")" << std::endl;
+
+        {
+            ScopedSpan span(trace, iterations, "retry");
+            co_await env.executor.loop().sleep_for(*delay);
+        }
+
+        // the fragments are still serialized, this is only the concatenation
+        request.build_into(request_body);
+    }
+
+    // connection check
+
+    std::string error;
+    json message;
+    json usage;
+
+    // the fast model is only trusted with picking tools, a plain answer
+    // from it goes to the strong model again (unless that was the last turn)
+    auto escalates = [&](const json& answer) {
+        return hold_content && !answer.contains("tool_calls") && iterations < turn_limit;
+    };
+
+    if (response.error) {
+        error = "HTTP error: " + response.error.message;
+    }
+    else if (response.status_code < 200 || response.status_code >= 300) {
+        error = "HTTP error: " + std::to_string(response.status_code) + "\n" + response.text;
+    }
+    else if (options.stream) {
+        if (!assembler.error().empty()) {
+            error = "Stream error: " + assembler.error();
+        }
+        else if (truncated) {
+            // the last call's arguments may be cut short, it is not started
+            error = "Stream error: truncated";
+        }
+        else {
+            assembler.finish();
+            message = assembler.take_message();
+            usage = assembler.usage();
+            if (on_content && !escalates(message)) {
+                if (!held_content.empty()) on_content(held_content);
+                if (message["content"].is_string() && !message["content"].get_ref<const std::string&>().empty()) {
+                    on_content("\n");
+                }
+            }
+        }
+    }
+    else {
+        ScopedSpan span(trace, iterations, "parse");
+
+        // only the message, usage and error are materialized, and the big
+        // strings are moved out of the parser instead of copied around
+        Completion completion;
+        std::string parse_error;
+        if (raced) {
+            message = std::move(raced->message);
+            usage = std::move(raced->usage);
+        }
+        else if (!parse_completion(response.text, completion, parse_error)) {
+            error = "Invalid JSON response ";
+        }
+        else if (!completion.error.empty()) {
+            error = "API error: " + completion.error;
+        }
+        else if (!completion.has_message || !completion.message.is_object()) {
+            error = "No choices in response";
+        }
+        else {
+            message = std::move(completion.message);
+            usage = std::move(completion.usage);
+        }
+    }
+
+    // everything needed from the text is out of it, its buffer serves the next turn
+    if (!options.stream) buffers.give_back(std::move(response.text));
+
+    if (!error.empty()) {
+        // calls started mid stream still point at this conversation's read cache
+        co_await batch.results();
+
+        finish(AgentResult::Status::Error, std::move(error));
+        co_return;
+    }
+
+    Usage turn_usage = parse_usage(usage);
+    result.usage.add(turn_usage);
+    if (turn_usage.cached_tokens > 0) result.cache_hits++;
+    if (trace) trace->record_usage(iterations, turn_usage);
+
+    if (options.verbose && turn_usage.present) {
+        std::cerr << tag << "[turn " << iterations << "] usage: prompt " << turn_usage.prompt_tokens
+            << " (cached " << turn_usage.cached_tokens << ", cache write " << turn_usage.cache_write_tokens
+            << "), completion " << turn_usage.completion_tokens << std::endl;
+    }
+
+    if (escalates(message)) {
+        final_pass = true;
+        if (options.verbose) {
+            std::cerr << tag << "[turn " << iterations << "] " << options.fast_model
+                << " answered, asking " << options.model << " for the final answer" << std::endl;
+        }
+        co_return;
+    }
+    final_pass = false;
+
+    // append  assistant message
+    if (!message.contains("role")) {
+        message["role"] = "assistant";
+    }
+
+    // old turns are evicted by token budget on the next build()
+    request.append(message);
+    log_message();
+
+    //check for the tool calls
+    if (message.contains("tool_calls")) {
+        // independent calls run side by side, results keep the call order
+        if (batch.size() == 0) {
+            for (const auto& call : message["tool_calls"]) {
+                batch.add(call);
+            }
+        }
+
+        std::vector<std::string> tool_results;
+        {
+            ScopedSpan span(trace, iterations, "tools");
+            tool_results = co_await batch.results();
+        }
+        for (const auto& tool_result : tool_results) buffers.add(tool_result.size());
+
+        size_t index = 0;
+        for (auto& call : message["tool_calls"]) {
+            // built by hand, an initializer list would copy the (possibly huge) result
+            json tool_message = json::object();
+            tool_message["role"] = "tool";
+            tool_message["tool_call_id"] = call["id"];
+            tool_message["content"] = std::move(tool_results[index++]);
+
+            //append tool result
+            request.append(std::move(tool_message));
+            log_message();
+        }
+
+        // the model still wants to go on, but this conversation is out of turns
+        if (iterations >= turn_limit) finish(AgentResult::Status::MaxIterations);
+        co_return;
+    }
+
+    if (message.contains("content") && message["content"].is_string()) {
+        result.output = std::move(message["content"].get_ref<std::string&>());
+    }
+
+    finish(AgentResult::Status::Ok);
+}
+
+Task<AgentResult> run_agent(AgentEnv& env, AgentOptions options, std::string prompt,
+                            std::function<void(std::string_view)> on_content)
+{
+    AgentSession session(env, std::move(options));
+    session.on_content = std::move(on_content);
+    if (!session.start(std::move(prompt))) co_return session.result();
+    co_return co_await session.run();
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include <nlohmann/json.hpp>
+
+#include "checkpoint.hpp"
+#include "context_window.hpp"
+#include "http_client.hpp"
+#include "read_cache.hpp"
+#include "request_builder.hpp"
+#include "request_scheduler.hpp"
+#include "sandbox.hpp"
+#include "subprocess.hpp"
+#include "task.hpp"
+#include "tool_executor.hpp"
+#include "turn_buffers.hpp"
+#include "trace.hpp"
+#include "usage.hpp"
+
+using json = nlohmann::json;
+
+// knobs of a single conversation
+struct AgentOptions {
+    std::string model = "anthropic/claude-haiku-4.5"; // final answers, and every turn without fast_model
+    std::string fast_model; // tool turns when set, a plain answer from it is asked of model again
+    bool race = false;      // every turn goes to fast_model and model at once, the first usable answer wins (no streaming)
+    int max_iterations = 10;
+    size_t context_tokens = ContextWindow::DEFAULT_BUDGET;
+    bool stream = false;
+    bool prompt_cache = false;
+    bool verbose = false;
+    std::string label; // prefixes stderr lines when several conversations run at once
+    std::string checkpoint; // json-lines log every message is appended to, empty = none
+    bool resume = false;    // continue the conversation in checkpoint instead of starting one from prompt
+    SandboxOptions sandbox; // limits for the commands its tools run
+};
+
+// everything conversations in one process can share, all on one event loop.
+// the pool decides where requests go (ChatTransport), the executor's registry
+// is the tool set of every session that does not bring its own
+struct AgentEnv {
+    ChatClientPool& clients;
+    ToolExecutor& executor;
+    RequestScheduler& scheduler; // retries and the rate limit shared by every conversation
+    Trace* trace = nullptr;
+};
+
+struct AgentResult {
+    enum class Status { Ok, Error, MaxIterations };
+
+    Status status = Status::Ok;
+    std::string output; // content of the final assistant message
+    std::string error;
+    int iterations = 0;
+    Usage usage;
+    int cache_hits = 0; // turns that read from the provider prompt cache
+    MemoryStats memory;
+};
+
+const char* status_name(AgentResult::Status status);
+
+// one conversation, driven a turn at a time. an embedder keeps one per
+// conversation for as long as it likes, the loop, clients and tools of the env
+// stay warm between them. only used from the env's loop thread, and it must
+// stay where it is while a step is running
+class AgentSession {
+public:
+    // tools replaces the executor's registry for this conversation when set
+    AgentSession(AgentEnv& env, AgentOptions options, ToolRegistry* tools = nullptr);
+
+    // the cgroup of its commands is removed on a tool thread, not on the loop
+    ~AgentSession();
+
+    AgentSession(const AgentSession&) = delete;
+    AgentSession& operator=(const AgentSession&) = delete;
+
+    // streamed text is handed over as it arrives
+    std::function<void(std::string_view)> on_content;
+
+    // starts from prompt, or from options.checkpoint with options.resume.
+    // false when the checkpoint can not be read or written or the sandbox
+    // can not be set up, result() says why
+    bool start(std::string prompt);
+
+    // one request to the model and the tool calls it asked for.
+    // done() once it answered without tools, something failed or the turns ran out
+    Task<void> step();
+
+    // steps until done
+    Task<AgentResult> run();
+
+    // appends another user message to a conversation that ended with an
+    // answer, the next steps get max_iterations more turns. false when it did not
+    bool follow_up(std::string message);
+
+    bool done() const { return done_; }
+    const AgentResult& result() const { return result_; }
+    const ContextWindow& history() const { return request.history(); }
+
+private:
+    void finish(AgentResult::Status status, std::string error = "");
+    void log_message();
+
+    AgentEnv& env;
+    AgentOptions options;
+    ToolRegistry& tools;
+    std::string tag;
+
+    // conversation state, kept serialized so each turn only dumps the new messages
+    RequestBuilder request;
+    CheckpointLog checkpoint;
+    FileReadCache read_cache;
+    TurnBuffers buffers;
+    Sandbox sandbox;    // before the shell, which lives in it
+    ShellSession shell; // started by the first shell call, killed with the session
+
+    AgentResult result_;
+    bool started = false;
+    bool done_ = false;
+    bool final_pass = false;
+    int turn_limit = 0;
+};
+
+// runs one conversation until the model stops calling tools, something fails
+// or max_iterations is reached (a resumed one gets max_iterations more turns). streamed text is handed to on_content as it arrives.
+// http and tool waits yield, so many conversations can share the executor's loop
+Task<AgentResult> run_agent(AgentEnv& env, AgentOptions options, std::string prompt,
+                            std::function<void(std::string_view)> on_content = {});
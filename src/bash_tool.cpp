@@ -0,0 +1,86 @@
+#include "bash_tool.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+void BashTool::execute(const json& args, const ToolContext& ctx, std::string& out) {
+    std::string command;
+    SubprocessOptions options;
+    if (!prepare(args, command, options, out)) return;
+    options.sandbox = ctx.sandbox;
+
+    SubprocessResult run = run_subprocess(command, options);
+    format(run, options, out);
+}
+
+#ifndef _WIN32
+Task<void> BashTool::execute_async(const json& args, const ToolContext& ctx, std::string& out) {
+    if (!ctx.loop) {
+        execute(args, ctx, out);
+        co_return;
+    }
+
+    std::string command;
+    SubprocessOptions options;
+    if (!prepare(args, command, options, out)) co_return;
+    options.sandbox = ctx.sandbox;
+
+    SubprocessResult run = co_await run_subprocess_async(*ctx.loop, command, options);
+    format(run, options, out);
+}
+#endif
+
+bool BashTool::prepare(const json& args, std::string& command, SubprocessOptions& options, std::string& out) {
+
+    if (!args.contains("command") || !args["command"].is_string()) {
+        out = "ERROR: inveild arguments.";
+        return false;
+    }
+
+    command = args["command"].get<std::string>();
+
+    if (command.empty()) {
+        out = "ERROR: empty command";
+        return false;
+    }
+
+    if (command.find("sudo") != std::string::npos ||
+        command.find("rm -rf /") != std::string::npos) {
+        out = "ERROR: command not allowed.";
+        return false;
+    }
+
+    if (args.contains("timeout") && args["timeout"].is_number()) {
+        // seconds, clamped so the model can not park the agent forever
+        double seconds = std::clamp(args["timeout"].get<double>(), 1.0, MAX_TIMEOUT_SECONDS);
+        options.timeout = std::chrono::milliseconds(static_cast<long long>(seconds * 1000));
+    }
+
+    return true;
+}
+
+void BashTool::format(const SubprocessResult& run, const SubprocessOptions& options, std::string& out) {
+    if (!run.error.empty()) {
+        out = "ERROR: " + run.error;
+        return;
+    }
+
+    // sized up front, the captures are copied straight into out
+    out.clear();
+    out.reserve(96 + run.out.text_size() + run.err.text_size());
+
+    out += "EXIT_CODE: ";
+    out += std::to_string(run.exit_code);
+    out += "\n";
+    if (run.timed_out) {
+        out += "TIMED_OUT: killed after ";
+        out += std::to_string(std::chrono::duration_cast<std::chrono::seconds>(options.timeout).count());
+        out += "s\n";
+    }
+    out += "OUTPUT:\n";
+    run.out.append_to(out);
+    if (run.err.total() > 0) {
+        out += "\nSTDERR:\n";
+        run.err.append_to(out);
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include "subprocess.hpp"
+#include "tool.hpp"
+
+using json = nlohmann::json;
+
+class BashTool : public Tool {
+public:
+    static constexpr double MAX_TIMEOUT_SECONDS = 600;
+
+    static constexpr ToolParam PARAMS[] = {
+        { "command", "string", "Shell command to execute", true },
+        { "timeout", "number", "Seconds before the command is killed (default 120, max 600)" },
+    };
+    static constexpr ToolSpec SPEC{
+        "bash",
+        "Execute a shell command and return exit code, stdout and stderr. Large outputs keep their start and end",
+        PARAMS
+    };
+
+    const ToolSpec& spec() const override { return SPEC; }
+
+    // a command can read or write any file, so it runs alone and in call order
+    ToolAccess access(const json& args) const override { return { "", true }; }
+    void execute(const json& args, const ToolContext& ctx, std::string& out) override;
+
+#ifndef _WIN32
+    // the child's pipes are polled on the loop, a long build does not hold a tool thread
+    Task<void> execute_async(const json& args, const ToolContext& ctx, std::string& out) override;
+#endif
+
+    // false with the error in out when the command must not run, shell uses it too
+    static bool prepare(const json& args, std::string& command, SubprocessOptions& options, std::string& out);
+
+private:
+    static void format(const SubprocessResult& run, const SubprocessOptions& options, std::string& out);
+};
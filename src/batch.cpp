@@ -0,0 +1,153 @@
+#include "batch.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+BatchTask parse_batch_task(const std::string& line, size_t line_number) {
+    BatchTask task;
+    task.id = std::to_string(line_number);
+
+    json parsed = json::parse(line, nullptr, false);
+    if (parsed.is_discarded() || !parsed.is_object()) {
+        task.error = "line " + std::to_string(line_number) + " is not a json object";
+        return task;
+    }
+
+    if (parsed.contains("id")) {
+        task.id = parsed["id"].is_string() ? parsed["id"].get<std::string>() : parsed["id"].dump();
+    }
+
+    if (!parsed.contains("prompt") || !parsed["prompt"].is_string() || parsed["prompt"].get_ref<const std::string&>().empty()) {
+        task.error = "missing prompt";
+        return task;
+    }
+    task.prompt = std::move(parsed["prompt"].get_ref<std::string&>());
+
+    if (parsed.contains("max_iterations") && parsed["max_iterations"].is_number_integer()) {
+        task.max_iterations = parsed["max_iterations"].get<int>();
+    }
+
+    if (parsed.contains("sandbox")) {
+        std::string error;
+        if (!parsed["sandbox"].is_string()) {
+            task.error = "sandbox must be a string like \"memory=1G,cpus=1\"";
+        }
+        else if (!parse_sandbox_spec(parsed["sandbox"].get_ref<const std::string&>(), task.sandbox, error)) {
+            task.error = error;
+        }
+    }
+
+    return task;
+}
+
+json batch_result(const std::string& id, const AgentResult& result) {
+    json record = json::object();
+    record["id"] = id;
+    record["status"] = status_name(result.status);
+    record["output"] = result.output;
+    if (!result.error.empty()) record["error"] = result.error;
+    record["iterations"] = result.iterations;
+    if (result.memory.turns > 0) {
+        record["memory"] = {
+            {"session_peak_bytes", result.memory.session_peak},
+            {"turn_peak_bytes", result.memory.turn_peak},
+            {"turn_total_bytes", result.memory.turn_total},
+            {"history_peak_bytes", result.memory.history_peak}
+        };
+    }
+    if (result.usage.present) {
+        record["usage"] = {
+            {"prompt_tokens", result.usage.prompt_tokens},
+            {"completion_tokens", result.usage.completion_tokens},
+            {"cached_tokens", result.usage.cached_tokens}
+        };
+    }
+    return record;
+}
+
+AgentOptions task_options(const AgentOptions& defaults, const BatchTask& task) {
+    AgentOptions options = defaults;
+    options.label = task.id;
+    // a task may ask for fewer turns, never more than the global limit
+    if (task.max_iterations > 0) {
+        options.max_iterations = std::min(task.max_iterations, defaults.max_iterations);
+    }
+    // and tighter limits, never looser ones
+    options.sandbox = stricter(defaults.sandbox, task.sandbox);
+    return options;
+}
+
+namespace {
+
+struct BatchState {
+    AgentEnv& env;
+    const AgentOptions& defaults;
+    std::vector<BatchTask> tasks;
+    size_t next = 0;
+    int failed = 0;
+};
+
+void emit(const BatchTask& task, const AgentResult& result) {
+    std::cout << batch_result(task.id, result).dump(-1, ' ', false, json::error_handler_t::replace) << '\n' << std::flush;
+}
+
+// pulls tasks until none are left, a handful of these share the loop
+Task<void> batch_worker(BatchState& state) {
+    while (state.next < state.tasks.size()) {
+        const BatchTask& task = state.tasks[state.next++];
+        AgentResult result;
+
+        if (!task.error.empty()) {
+            result.status = AgentResult::Status::Error;
+            result.error = task.error;
+        }
+        else {
+            try {
+                result = co_await run_agent(state.env, task_options(state.defaults, task), task.prompt);
+            }
+            catch (const std::exception& e) {
+                result.status = AgentResult::Status::Error;
+                result.error = e.what();
+            }
+        }
+
+        if (result.status != AgentResult::Status::Ok) state.failed++;
+        emit(task, result);
+    }
+}
+
+} // namespace
+
+int run_batch(AgentEnv& env, const AgentOptions& defaults, const BatchOptions& options) {
+    std::ifstream file;
+    std::istream* input = &std::cin;
+    if (options.input != "-") {
+        file.open(options.input);
+        if (!file) {
+            std::cerr << "could not open batch file " << options.input << std::endl;
+            return -1;
+        }
+        input = &file;
+    }
+
+    BatchState state{ env, defaults };
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(*input, line)) {
+        line_number++;
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        state.tasks.push_back(parse_batch_task(line, line_number));
+    }
+
+    // no point in more workers than tasks, or than clients to hand out
+    size_t workers = std::min({ std::max<size_t>(1, options.concurrency), state.tasks.size(), env.clients.size() });
+    EventLoop& loop = env.executor.loop();
+    for (size_t i = 0; i < workers; ++i) {
+        loop.spawn(batch_worker(state));
+    }
+    loop.run();
+
+    return state.failed;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+
+#include "agent.hpp"
+
+// one {"id", "prompt"[, "max_iterations", "sandbox"]} job, as batch files and --serve take them.
+// sandbox is a --sandbox spec
+struct BatchTask {
+    std::string id;
+    std::string prompt;
+    int max_iterations = 0;
+    SandboxOptions sandbox;
+    std::string error; // malformed line, reported instead of run
+};
+
+// id defaults to the line (or job) number
+BatchTask parse_batch_task(const std::string& line, size_t line_number);
+
+// the line reported for a finished task
+json batch_result(const std::string& id, const AgentResult& result);
+
+// the options a task runs with
+AgentOptions task_options(const AgentOptions& defaults, const BatchTask& task);
+
+struct BatchOptions {
+    std::string input;   // json lines file, "-" for stdin
+    size_t concurrency = 4;
+};
+
+// runs every {"id", "prompt"[, "max_iterations", "sandbox"]} line of the input as its own
+// conversation, `concurrency` at a time as coroutines on the executor's loop,
+// sharing clients, tool threads and the tools schema. one result line per task goes to stdout as soon as it finishes.
+// returns the number of tasks that did not end with "ok", or -1 if the input
+// could not be read
+int run_batch(AgentEnv& env, const AgentOptions& defaults, const BatchOptions& options);
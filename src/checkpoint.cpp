@@ -0,0 +1,112 @@
+#include "checkpoint.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <unordered_set>
+
+bool Checkpoint::finished() const {
+    if (messages.size() < 2) return false;
+    const json& last = messages.back();
+    return last.value("role", "") == "assistant" && !last.contains("tool_calls");
+}
+
+bool load_checkpoint(const std::string& path, Checkpoint& checkpoint, std::string& error) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        error = "could not open checkpoint " + path;
+        return false;
+    }
+
+    checkpoint.messages.clear();
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(in, line)) {
+        line_number++;
+        if (line.empty()) continue;
+
+        json message = json::parse(line, nullptr, false);
+        if (message.is_discarded() || !message.is_object() || !message.contains("role")) {
+            // only the last line can be torn, anything earlier means this is not our log
+            if (in.peek() == std::char_traits<char>::eof()) break;
+            error = path + ":" + std::to_string(line_number) + " is not a checkpoint message";
+            return false;
+        }
+        checkpoint.messages.push_back(std::move(message));
+    }
+
+    auto& messages = checkpoint.messages;
+    if (messages.empty() || messages[0].value("role", "") != "user") {
+        error = path + " does not start with a prompt";
+        return false;
+    }
+
+    // an assistant message that asked for tools is only kept with all of its results
+    for (size_t i = messages.size(); i-- > 1;) {
+        const json& message = messages[i];
+        if (message.value("role", "") != "assistant" || !message.contains("tool_calls")) continue;
+
+        std::unordered_set<std::string> missing;
+        for (const auto& call : message["tool_calls"]) {
+            if (call.contains("id") && call["id"].is_string()) missing.insert(call["id"].get<std::string>());
+        }
+        for (size_t j = i + 1; j < messages.size(); ++j) {
+            if (messages[j].contains("tool_call_id") && messages[j]["tool_call_id"].is_string()) {
+                missing.erase(messages[j]["tool_call_id"].get<std::string>());
+            }
+        }
+
+        if (!missing.empty()) messages.resize(i);
+        break;
+    }
+
+    return true;
+}
+
+CheckpointLog::~CheckpointLog() {
+    if (file) std::fclose(file);
+}
+
+bool CheckpointLog::start(const std::string& path, const std::vector<std::string_view>& lines, std::string& error) {
+    if (file) {
+        std::fclose(file);
+        file = nullptr;
+    }
+    path_ = path;
+
+    // a resumed log may lose its torn tail, never rewrite it in place
+    std::string temp = path + ".tmp";
+    std::FILE* out = std::fopen(temp.c_str(), "wb");
+    if (!out) {
+        error = "could not write checkpoint " + temp;
+        return false;
+    }
+
+    bool ok = true;
+    for (std::string_view line : lines) {
+        ok = ok && std::fwrite(line.data(), 1, line.size(), out) == line.size() && std::fputc('\n', out) != EOF;
+    }
+    ok = std::fclose(out) == 0 && ok;
+
+    std::error_code ec;
+    if (ok) std::filesystem::rename(temp, path, ec);
+    if (!ok || ec) {
+        error = "could not write checkpoint " + path + (ec ? ": " + ec.message() : "");
+        std::filesystem::remove(temp, ec);
+        return false;
+    }
+
+    file = std::fopen(path.c_str(), "ab");
+    if (!file) {
+        error = "could not open checkpoint " + path + " for appending";
+        return false;
+    }
+    return true;
+}
+
+void CheckpointLog::append(std::string_view message) {
+    if (!file) return;
+    std::fwrite(message.data(), 1, message.size(), file);
+    std::fputc('\n', file);
+    std::fflush(file);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// what a checkpoint log holds: the prompt first, then every message of the
+// conversation in order, one json object per line exactly as it went on the wire
+struct Checkpoint {
+    std::vector<json> messages;
+
+    // the conversation already ended with a plain answer
+    bool finished() const;
+};
+
+// reads a log back. a torn last line (the process died mid write) is dropped,
+// so is a trailing tool round whose results are not all there: its calls run again.
+// false with error set when there is nothing usable
+bool load_checkpoint(const std::string& path, Checkpoint& checkpoint, std::string& error);
+
+// append-only writer, every line is flushed as soon as it is written so a
+// crash or a kill loses at most the message that was being written
+class CheckpointLog {
+public:
+    CheckpointLog() = default;
+    ~CheckpointLog();
+
+    CheckpointLog(const CheckpointLog&) = delete;
+    CheckpointLog& operator=(const CheckpointLog&) = delete;
+
+    // (re)writes the file with these serialized messages (temp file + rename),
+    // then keeps it open for appending
+    bool start(const std::string& path, const std::vector<std::string_view>& lines, std::string& error);
+
+    // one serialized message, must not contain a raw newline (dump() never emits one)
+    void append(std::string_view message);
+
+    bool is_open() const { return file != nullptr; }
+    const std::string& path() const { return path_; }
+
+private:
+    std::FILE* file = nullptr;
+    std::string path_;
+};
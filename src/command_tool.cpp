@@ -0,0 +1,152 @@
+#include "command_tool.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+const char* const PARAM_TYPES[] = { "string", "integer", "number", "boolean", "array", "object" };
+
+// what the providers accept as a function or property name
+bool valid_name(const std::string& name) {
+    if (name.empty() || name.size() > 64) return false;
+    return std::all_of(name.begin(), name.end(), [](unsigned char c) {
+        return std::isalnum(c) || c == '_' || c == '-';
+    });
+}
+
+std::string required_string(const json& object, const char* key, const std::string& where) {
+    if (!object.contains(key) || !object[key].is_string() || object[key].get_ref<const std::string&>().empty()) {
+        throw std::runtime_error(where + ": \"" + key + "\" must be a non-empty string");
+    }
+    return object[key].get<std::string>();
+}
+
+// 'it'\''s' style quoting, safe for anything sh gets to see
+std::string shell_quote(const std::string& text) {
+    std::string quoted = "'";
+    for (char c : text) {
+        if (c == '\'') quoted += "'\\''";
+        else quoted += c;
+    }
+    quoted += '\'';
+    return quoted;
+}
+
+}
+
+CommandTool::CommandTool(const json& manifest) {
+    if (!manifest.is_object()) throw std::runtime_error("tool manifest must be a json object");
+
+    name = required_string(manifest, "name", "tool manifest");
+    if (!valid_name(name)) throw std::runtime_error("tool name " + name + " may only use letters, digits, _ and -");
+
+    const std::string where = "tool " + name;
+    description = required_string(manifest, "description", where);
+    command = required_string(manifest, "command", where);
+
+    if (manifest.contains("timeout")) {
+        if (!manifest["timeout"].is_number()) throw std::runtime_error(where + ": \"timeout\" must be a number of seconds");
+        double seconds = std::clamp(manifest["timeout"].get<double>(), 1.0, MAX_TIMEOUT_SECONDS);
+        options.timeout = std::chrono::milliseconds(static_cast<long long>(seconds * 1000));
+    }
+
+    if (manifest.contains("parameters")) {
+        if (!manifest["parameters"].is_array()) throw std::runtime_error(where + ": \"parameters\" must be an array");
+
+        for (const auto& entry : manifest["parameters"]) {
+            if (!entry.is_object()) throw std::runtime_error(where + ": every parameter must be an object");
+
+            Param param;
+            param.name = required_string(entry, "name", where);
+            if (!valid_name(param.name)) throw std::runtime_error(where + ": bad parameter name " + param.name);
+
+            param.type = entry.contains("type") && entry["type"].is_string() ? entry["type"].get<std::string>() : "string";
+            if (std::find(std::begin(PARAM_TYPES), std::end(PARAM_TYPES), param.type) == std::end(PARAM_TYPES)) {
+                throw std::runtime_error(where + ": parameter " + param.name + " has unknown type " + param.type);
+            }
+
+            param.description = entry.contains("description") && entry["description"].is_string()
+                ? entry["description"].get<std::string>() : "";
+            param.required = entry.contains("required") && entry["required"].is_boolean() && entry["required"].get<bool>();
+            params.push_back(std::move(param));
+        }
+    }
+
+    for (const auto& param : params) {
+        param_views.push_back({ param.name, param.type, param.description, param.required });
+    }
+    spec_ = { name, description, param_views };
+}
+
+std::string CommandTool::shell_command(const json& args) const {
+    std::string dumped = args.dump(-1, ' ', false, json::error_handler_t::replace);
+    return "export TOOL_ARGS=" + shell_quote(dumped) + "; " + command;
+}
+
+void CommandTool::execute(const json& args, const ToolContext& ctx, std::string& out) {
+    SubprocessOptions limited = options;
+    limited.sandbox = ctx.sandbox;
+    SubprocessResult run = run_subprocess(shell_command(args), limited);
+    format(run, out);
+}
+
+#ifndef _WIN32
+Task<void> CommandTool::execute_async(const json& args, const ToolContext& ctx, std::string& out) {
+    if (!ctx.loop) {
+        execute(args, ctx, out);
+        co_return;
+    }
+
+    SubprocessOptions limited = options;
+    limited.sandbox = ctx.sandbox;
+    SubprocessResult run = co_await run_subprocess_async(*ctx.loop, shell_command(args), limited);
+    format(run, out);
+}
+#endif
+
+void CommandTool::format(const SubprocessResult& run, std::string& out) const {
+    if (!run.error.empty()) {
+        out = "ERROR: " + run.error;
+        return;
+    }
+
+    out.clear();
+    out.reserve(96 + run.out.text_size() + run.err.text_size());
+
+    // a clean exit is just the tool's answer, anything else says what happened
+    if (run.timed_out) {
+        out += "ERROR: " + name + " timed out\n";
+    }
+    else if (run.exit_code != 0) {
+        out += "ERROR: " + name + " exited with " + std::to_string(run.exit_code) + "\n";
+    }
+
+    run.out.append_to(out);
+    if (run.exit_code != 0 && run.err.total() > 0) {
+        out += "\nSTDERR:\n";
+        run.err.append_to(out);
+    }
+}
+
+std::unique_ptr<CommandTool> load_command_tool(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("could not open tool manifest " + path);
+
+    json manifest;
+    try {
+        manifest = json::parse(in);
+    }
+    catch (const json::parse_error& e) {
+        throw std::runtime_error("tool manifest " + path + " is not valid json: " + e.what());
+    }
+
+    try {
+        return std::make_unique<CommandTool>(manifest);
+    }
+    catch (const std::runtime_error& e) {
+        throw std::runtime_error(path + ": " + e.what());
+    }
+}
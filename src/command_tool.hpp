@@ -0,0 +1,64 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "subprocess.hpp"
+#include "tool.hpp"
+
+using json = nlohmann::json;
+
+// a tool defined at runtime by a json manifest instead of a class:
+//
+//   { "name": "lint", "description": "...", "command": "./scripts/lint.sh",
+//     "timeout": 60, "parameters": [ { "name": "path", "type": "string",
+//     "description": "...", "required": true } ] }
+//
+// the command runs through sh with the call's arguments as json in $TOOL_ARGS
+class CommandTool : public Tool {
+public:
+    static constexpr double MAX_TIMEOUT_SECONDS = 600;
+
+    // throws std::runtime_error for a manifest that does not describe a tool
+    explicit CommandTool(const json& manifest);
+
+    CommandTool(const CommandTool&) = delete;
+    CommandTool& operator=(const CommandTool&) = delete;
+
+    const ToolSpec& spec() const override { return spec_; }
+
+    // like bash, the command may touch any file
+    ToolAccess access(const json& args) const override { return { "", true }; }
+    void execute(const json& args, const ToolContext& ctx, std::string& out) override;
+
+#ifndef _WIN32
+    Task<void> execute_async(const json& args, const ToolContext& ctx, std::string& out) override;
+#endif
+
+private:
+    struct Param {
+        std::string name;
+        std::string type;
+        std::string description;
+        bool required = false;
+    };
+
+    std::string shell_command(const json& args) const;
+    void format(const SubprocessResult& run, std::string& out) const;
+
+    std::string name;
+    std::string description;
+    std::string command;
+    SubprocessOptions options;
+
+    // spec_ views into these, they never change after the constructor
+    std::vector<Param> params;
+    std::vector<ToolParam> param_views;
+    ToolSpec spec_;
+};
+
+// reads a manifest file, throws std::runtime_error with the path on any problem
+std::unique_ptr<CommandTool> load_command_tool(const std::string& path);
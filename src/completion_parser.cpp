@@ -0,0 +1,190 @@
+#include "completion_parser.hpp"
+
+#include <vector>
+
+namespace {
+
+class CompletionSax : public nlohmann::json_sax<json> {
+public:
+    explicit CompletionSax(Completion& out) : out(out) {}
+
+    std::string error_message;
+
+    bool null() override { return value(json(nullptr)); }
+    bool boolean(bool val) override { return value(json(val)); }
+    bool number_integer(number_integer_t val) override { return value(json(val)); }
+    bool number_unsigned(number_unsigned_t val) override { return value(json(val)); }
+    bool number_float(number_float_t val, const string_t&) override { return value(json(val)); }
+    bool binary(binary_t&) override { return value(json(nullptr)); }
+
+    bool string(string_t& val) override {
+        // the lexer clears its buffer before the next token, so taking it is safe
+        if (capturing() || target() == Target::FinishReason || target() == Target::Error) {
+            return value(json(std::move(val)));
+        }
+        return value(json());
+    }
+
+    bool key(string_t& val) override {
+        if (capturing()) {
+            capture_key = val;
+        }
+        frames.back().key = std::move(val);
+        return true;
+    }
+
+    bool start_object(std::size_t) override {
+        open(json::object());
+        frames.push_back({ false, 0, {} });
+        return true;
+    }
+
+    bool end_object() override {
+        frames.pop_back();
+        close();
+        return true;
+    }
+
+    bool start_array(std::size_t) override {
+        open(json::array());
+        frames.push_back({ true, 0, {} });
+        return true;
+    }
+
+    bool end_array() override {
+        frames.pop_back();
+        close();
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex) override {
+        error_message = ex.what();
+        return false;
+    }
+
+private:
+    enum class Target { None, Message, FinishReason, Usage, Error };
+
+    struct Frame {
+        bool array;
+        size_t count; // elements seen so far when array
+        std::string key;
+    };
+
+    bool capturing() const { return !capture_stack.empty(); }
+
+    // what the value that is about to start is, judged by where we are
+    Target target() const {
+        if (frames.size() == 1 && !frames[0].array) {
+            if (frames[0].key == "usage") return Target::Usage;
+            if (frames[0].key == "error") return Target::Error;
+        }
+        // { "choices": [ { "message": ..., "finish_reason": ... } ] }
+        if (frames.size() == 3 && !frames[0].array && frames[0].key == "choices" &&
+            frames[1].array && frames[1].count == 1 && !frames[2].array)
+        {
+            if (frames[2].key == "message") return Target::Message;
+            if (frames[2].key == "finish_reason") return Target::FinishReason;
+        }
+        return Target::None;
+    }
+
+    json* slot_for(Target t) {
+        switch (t) {
+        case Target::Message: out.has_message = true; return &out.message;
+        case Target::Usage: return &out.usage;
+        case Target::Error: return &error_value;
+        default: return nullptr;
+        }
+    }
+
+    // a scalar, or the start of a container, at the current position
+    json* place(json&& v) {
+        if (!frames.empty() && frames.back().array) frames.back().count++;
+
+        if (capturing()) {
+            json* parent = capture_stack.back();
+            if (parent->is_object()) {
+                json& slot = (*parent)[capture_key];
+                slot = std::move(v);
+                return &slot;
+            }
+            parent->push_back(std::move(v));
+            return &parent->back();
+        }
+
+        Target t = target();
+        if (t == Target::FinishReason) {
+            if (v.is_string()) out.finish_reason = v.get<std::string>();
+            return nullptr;
+        }
+        if (t == Target::Error && !v.is_structured()) {
+            if (v.is_string()) out.error = std::move(v.get_ref<std::string&>());
+            return nullptr;
+        }
+
+        json* slot = slot_for(t);
+        if (slot) *slot = std::move(v);
+        return slot;
+    }
+
+    bool value(json&& v) {
+        place(std::move(v));
+        return true;
+    }
+
+    void open(json&& container) {
+        // frames are pushed after placing, so target() still sees the parent
+        bool was_capturing = capturing();
+        json* slot = place(std::move(container));
+
+        if (was_capturing || slot) {
+            capture_stack.push_back(slot);
+        }
+        else {
+            // skipped subtree: keep the stacks aligned
+            capture_stack_skipped.push_back(frames.size());
+        }
+    }
+
+    void close() {
+        if (!capture_stack_skipped.empty() && capture_stack_skipped.back() == frames.size()) {
+            capture_stack_skipped.pop_back();
+            return;
+        }
+        if (!capture_stack.empty()) {
+            capture_stack.pop_back();
+            if (capture_stack.empty() && error_value.is_object()) {
+                finish_error();
+            }
+        }
+    }
+
+    void finish_error() {
+        if (error_value.contains("message") && error_value["message"].is_string()) {
+            out.error = error_value["message"].get<std::string>();
+        }
+        else {
+            out.error = error_value.dump();
+        }
+    }
+
+    Completion& out;
+    std::vector<Frame> frames;
+    std::vector<json*> capture_stack;
+    std::vector<size_t> capture_stack_skipped;
+    std::string capture_key;
+    json error_value;
+};
+
+}
+
+bool parse_completion(std::string_view text, Completion& out, std::string& parse_error) {
+    CompletionSax handler(out);
+
+    bool ok = json::sax_parse(text.begin(), text.end(), &handler);
+    if (!ok) {
+        parse_error = handler.error_message.empty() ? "invalid json" : handler.error_message;
+    }
+    return ok;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// the parts of a chat completion the agent loop actually looks at
+struct Completion {
+    json message;              // choices[0].message
+    json usage;
+    std::string finish_reason; // choices[0].finish_reason
+    std::string error;         // top level "error" from the provider
+    bool has_message = false;
+};
+
+// sax parse of a full completion body.
+// only choices[0].message, usage and error are turned into json, everything
+// else is skipped, and string values are moved out of the lexer instead of copied
+bool parse_completion(std::string_view text, Completion& out, std::string& parse_error);
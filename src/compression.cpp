@@ -0,0 +1,103 @@
+#include "compression.hpp"
+
+#include <curl/curl.h>
+
+#ifdef CLAUDE_CODE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef CLAUDE_CODE_ZSTD
+#include <zstd.h>
+#endif
+
+bool parse_body_encoding(std::string_view name, BodyEncoding& encoding) {
+    if (name == "gzip") encoding = BodyEncoding::Gzip;
+    else if (name == "zstd") encoding = BodyEncoding::Zstd;
+    else if (name == "none") encoding = BodyEncoding::None;
+    else return false;
+    return true;
+}
+
+const char* encoding_name(BodyEncoding encoding) {
+    switch (encoding) {
+    case BodyEncoding::Gzip: return "gzip";
+    case BodyEncoding::Zstd: return "zstd";
+    case BodyEncoding::None: break;
+    }
+    return "identity";
+}
+
+bool can_compress(BodyEncoding encoding) {
+    switch (encoding) {
+    case BodyEncoding::None: return true;
+#ifdef CLAUDE_CODE_ZLIB
+    case BodyEncoding::Gzip: return true;
+#endif
+#ifdef CLAUDE_CODE_ZSTD
+    case BodyEncoding::Zstd: return true;
+#endif
+    default: return false;
+    }
+}
+
+bool compress_body(BodyEncoding encoding, std::string_view data, std::string& out, int level) {
+    out.clear();
+
+    switch (encoding) {
+    case BodyEncoding::None:
+        out.assign(data);
+        return true;
+
+#ifdef CLAUDE_CODE_ZLIB
+    case BodyEncoding::Gzip: {
+        if (data.size() > 0xFFFFFFFFu) return false;
+
+        // json compresses well even at the fast end, the upload is what is slow
+        z_stream stream{};
+        if (deflateInit2(&stream, level > 0 ? level : 1, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) return false;
+
+        out.resize(deflateBound(&stream, static_cast<uLong>(data.size())) + 32);
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+        stream.avail_in = static_cast<uInt>(data.size());
+        stream.next_out = reinterpret_cast<Bytef*>(out.data());
+        stream.avail_out = static_cast<uInt>(out.size());
+
+        int rc = deflate(&stream, Z_FINISH);
+        out.resize(stream.total_out);
+        deflateEnd(&stream);
+        return rc == Z_STREAM_END;
+    }
+#endif
+
+#ifdef CLAUDE_CODE_ZSTD
+    case BodyEncoding::Zstd: {
+        out.resize(ZSTD_compressBound(data.size()));
+        size_t n = ZSTD_compress(out.data(), out.size(), data.data(), data.size(), level > 0 ? level : 3);
+        if (ZSTD_isError(n)) return false;
+        out.resize(n);
+        return true;
+    }
+#endif
+
+    default:
+        return false;
+    }
+}
+
+std::string accepted_encodings() {
+    const curl_version_info_data* info = curl_version_info(CURLVERSION_NOW);
+    std::string list;
+    auto add = [&list](const char* coding) {
+        if (!list.empty()) list += ", ";
+        list += coding;
+    };
+
+#ifdef CURL_VERSION_ZSTD
+    if (info->features & CURL_VERSION_ZSTD) add("zstd");
+#endif
+    if (info->features & CURL_VERSION_BROTLI) add("br");
+    if (info->features & CURL_VERSION_LIBZ) {
+        add("gzip");
+        add("deflate");
+    }
+    return list;
+}
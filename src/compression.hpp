@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// content codings for request bodies. responses are decoded by curl, which
+// knows more of them (brotli too when it was built with it)
+enum class BodyEncoding { None, Gzip, Zstd };
+
+// "gzip", "zstd" or "none"
+bool parse_body_encoding(std::string_view name, BodyEncoding& encoding);
+const char* encoding_name(BodyEncoding encoding);
+
+// whether this build can write it (zlib / libzstd found at configure time)
+bool can_compress(BodyEncoding encoding);
+
+// data in the encoding into out, which keeps its capacity. level 0 = the
+// encoding's fast default. false when the encoder failed or is not built in
+bool compress_body(BodyEncoding encoding, std::string_view data, std::string& out, int level = 0);
+
+// the Accept-Encoding value: every coding the linked curl can decode, better ratio first
+std::string accepted_encodings();
@@ -0,0 +1,117 @@
+#include "context_window.hpp"
+
+#include <algorithm>
+
+void truncate_middle(std::string& text, size_t max_bytes) {
+    if (text.size() <= max_bytes) return;
+
+    // never split a multi byte sequence, dump() throws on broken utf-8
+    auto is_continuation = [&](size_t i) {
+        return i < text.size() && (static_cast<unsigned char>(text[i]) & 0xC0) == 0x80;
+    };
+
+    size_t head = max_bytes * 6 / 10;
+    while (head > 0 && is_continuation(head)) head--;
+
+    size_t tail_start = text.size() - (max_bytes - head);
+    while (tail_start < text.size() && is_continuation(tail_start)) tail_start++;
+
+    std::string marker = "\n... [" + std::to_string(tail_start - head) + " bytes elided] ...\n";
+
+    std::string out;
+    out.reserve(head + marker.size() + (text.size() - tail_start));
+    out.append(text, 0, head);
+    out += marker;
+    out.append(text, tail_start, std::string::npos);
+    text = std::move(out);
+}
+
+void ContextWindow::set_budget(size_t tokens) {
+    token_budget = tokens ? tokens : DEFAULT_BUDGET;
+}
+
+void ContextWindow::set_low_water(size_t percent) {
+    low_water = std::min<size_t>(std::max<size_t>(percent, 1), 100);
+}
+
+HistoryEntry ContextWindow::make_entry(const json& message) {
+    HistoryEntry entry;
+    entry.role = message.value("role", "");
+    if (message.contains("tool_call_id") && message["tool_call_id"].is_string()) {
+        entry.tool_call_id = message["tool_call_id"];
+    }
+
+    if (entry.role == "tool" && message.contains("content") && message["content"].is_string() &&
+        message["content"].get_ref<const std::string&>().size() > max_result_bytes())
+    {
+        json shortened = message;
+        truncate_middle(shortened["content"].get_ref<std::string&>(), max_result_bytes());
+        entry.json_text = shortened.dump(-1, ' ', false, json::error_handler_t::replace);
+    }
+    else {
+        // binary file contents or command output must not take the run down
+        entry.json_text = message.dump(-1, ' ', false, json::error_handler_t::replace);
+    }
+
+    entry.tokens = estimate_tokens(entry.json_text.size());
+
+    // tool results stick to the assistant message in front of them
+    if (entry.role == "tool" && !entries_.empty()) {
+        entry.group = entries_.back().group;
+    }
+    else {
+        entry.group = next_group++;
+    }
+
+    return entry;
+}
+
+size_t ContextWindow::pin(const json& message) {
+    HistoryEntry entry = make_entry(message);
+    size_t dumped = entry.json_text.size();
+
+    bytes_ += dumped;
+    tokens_ += entry.tokens;
+    pinned_.push_back(std::move(entry));
+    return dumped;
+}
+
+size_t ContextWindow::append(const json& message) {
+    return push(make_entry(message));
+}
+
+size_t ContextWindow::append(json&& message) {
+    if (message.value("role", "") == "tool" && message.contains("content") && message["content"].is_string()) {
+        truncate_middle(message["content"].get_ref<std::string&>(), max_result_bytes());
+    }
+    return push(make_entry(message));
+}
+
+size_t ContextWindow::push(HistoryEntry entry) {
+    size_t dumped = entry.json_text.size();
+
+    bytes_ += dumped;
+    tokens_ += entry.tokens;
+    entries_.push_back(std::move(entry));
+    return dumped;
+}
+
+void ContextWindow::enforce() {
+    if (tokens_ <= token_budget) return;
+
+    const size_t target = token_budget / 100 * low_water;
+
+    while (tokens_ > target && !entries_.empty() &&
+           entries_.front().group != entries_.back().group)
+    {
+        size_t group = entries_.front().group;
+
+        while (!entries_.empty() && entries_.front().group == group) {
+            if (on_evict) on_evict(entries_.front());
+            bytes_ -= entries_.front().json_text.size();
+            tokens_ -= entries_.front().tokens;
+            entries_.pop_front();
+            evicted_++;
+        }
+    }
+}
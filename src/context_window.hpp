@@ -0,0 +1,78 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// one history message, kept the way it goes on the wire
+struct HistoryEntry {
+    std::string json_text;
+    std::string role;
+    std::string tool_call_id; // tool results only
+    size_t tokens = 0;
+    size_t group = 0; // an assistant tool_calls message and its tool results share a group
+};
+
+// token budgeted history.
+// eviction pops whole groups off the front of a deque, so a tool result is
+// never left behind without the assistant message that asked for it
+class ContextWindow {
+public:
+    static constexpr size_t DEFAULT_BUDGET = 100'000;
+
+    // told about every entry that leaves the window
+    std::function<void(const HistoryEntry&)> on_evict;
+
+    // budget for the whole history, single tool results get at most a quarter of it
+    void set_budget(size_t tokens);
+    size_t budget() const { return token_budget; }
+
+    // once over budget evict down to this percentage of it, so evictions (which
+    // change the prompt prefix) happen in rare larger steps instead of every turn
+    void set_low_water(size_t percent);
+
+    // messages that are never evicted (the original prompt)
+    size_t pin(const json& message);
+    // returns the number of freshly serialized bytes
+    size_t append(const json& message);
+    // same, but an oversized tool result is cut in place instead of copied first
+    size_t append(json&& message);
+
+    // drop the oldest groups until the estimate fits, the newest group always stays
+    void enforce();
+
+    const std::vector<HistoryEntry>& pinned() const { return pinned_; }
+    const std::deque<HistoryEntry>& entries() const { return entries_; }
+
+    size_t size() const { return pinned_.size() + entries_.size(); }
+    size_t bytes() const { return bytes_; }
+    size_t tokens() const { return tokens_; }
+    size_t evicted() const { return evicted_; }
+
+    // rough chars/4 estimate, good enough to keep the prompt size in check
+    static size_t estimate_tokens(size_t bytes) { return (bytes + 3) / 4; }
+
+    // the most of one tool result that is kept, longer ones lose their middle
+    size_t max_result_bytes() const { return token_budget; } // budget / 4 tokens ~ budget bytes
+
+private:
+    HistoryEntry make_entry(const json& message);
+    size_t push(HistoryEntry entry);
+
+    std::vector<HistoryEntry> pinned_;
+    std::deque<HistoryEntry> entries_;
+    size_t token_budget = DEFAULT_BUDGET;
+    size_t low_water = 100;
+    size_t next_group = 0;
+    size_t bytes_ = 0;
+    size_t tokens_ = 0;
+    size_t evicted_ = 0;
+};
+
+// keeps the start and the end of text, cutting on utf-8 boundaries
+void truncate_middle(std::string& text, size_t max_bytes);
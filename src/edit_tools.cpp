@@ -0,0 +1,255 @@
+#include "edit_tools.hpp"
+
+#include <filesystem>
+#include <optional>
+#include <set>
+#include <system_error>
+#include <vector>
+
+#include "file_tools.hpp"
+#include "mapped_file.hpp"
+#include "patch.hpp"
+#include "read_cache.hpp"
+
+namespace {
+
+bool load_file(const std::string& path, std::string& text, std::string& error) {
+    std::error_code ec;
+    auto size = std::filesystem::file_size(path, ec);
+    if (ec) {
+        error = "could not open " + path + ": " + ec.message();
+        return false;
+    }
+    if (size > EditFileTool::MAX_SIZE) {
+        error = path + " is too large to edit.";
+        return false;
+    }
+
+    MappedFile file;
+    if (!file.open(path)) {
+        error = path + ": " + file.error();
+        return false;
+    }
+    text.assign(file.view());
+    return true;
+}
+
+// a read right after the edit can point back at this call
+void remember_write(const ToolContext& ctx, const std::string& path, const std::string& content) {
+    if (!ctx.read_cache) return;
+    ctx.read_cache->record_write(normalize_tool_path(path), ReadFileTool::cache_key(path, json::object()),
+                                 stamp_file(path), content_hash(content), ctx.call_id);
+}
+
+bool parse_edits(const json& list, std::vector<TextEdit>& edits, std::string& error) {
+    if (!list.is_array() || list.empty()) {
+        error = "edits must be a non-empty array";
+        return false;
+    }
+    for (const auto& item : list) {
+        if (!item.is_object() || !item.contains("old_string") || !item["old_string"].is_string() ||
+            !item.contains("new_string") || !item["new_string"].is_string())
+        {
+            error = "every edit needs old_string and new_string";
+            return false;
+        }
+        TextEdit edit;
+        edit.old_text = item["old_string"].get<std::string>();
+        edit.new_text = item["new_string"].get<std::string>();
+        edit.replace_all = item.contains("replace_all") && item["replace_all"].is_boolean() && item["replace_all"].get<bool>();
+        edits.push_back(std::move(edit));
+    }
+    return true;
+}
+
+// one file of an apply_patch, fully computed before anything is written
+struct PendingFile {
+    std::string path;                   // what ends up on disk, empty when deleted
+    std::string removed;                // old path that goes away (delete or rename)
+    std::string content;
+    std::optional<std::string> before;  // what path held before, for the rollback
+    std::string summary;
+};
+
+}
+
+ToolAccess EditFileTool::access(const json& args) const {
+    if (!args.contains("path") || !args["path"].is_string()) return { "", true };
+    return { normalize_tool_path(args["path"]), true };
+}
+
+void EditFileTool::execute(const json& args, const ToolContext& ctx, std::string& out) {
+    if (!args.contains("path") || !args["path"].is_string()) {
+        out = "ERROR: invalid arguments";
+        return;
+    }
+    const std::string& path = args["path"].get_ref<const std::string&>();
+    if (!valid_write_path(path)) {
+        out = "ERROR: invalid arguments ";
+        return;
+    }
+
+    const bool has_edits = args.contains("edits") && !args["edits"].is_null();
+    const bool has_patch = args.contains("patch") && !args["patch"].is_null();
+    if (has_edits == has_patch) {
+        out = "ERROR: pass exactly one of edits or patch.";
+        return;
+    }
+
+    std::vector<TextEdit> edits;
+    std::vector<FilePatch> files;
+    std::string error;
+    if (has_edits && !parse_edits(args["edits"], edits, error)) {
+        out = "ERROR: " + error;
+        return;
+    }
+    if (has_patch) {
+        if (!args["patch"].is_string()) {
+            out = "ERROR: patch must be a string";
+            return;
+        }
+        if (!parse_unified_diff(args["patch"].get_ref<const std::string&>(), files, error, true)) {
+            out = "ERROR: " + error;
+            return;
+        }
+    }
+
+    // a file that is not there yet can only be filled, not edited
+    std::string text;
+    std::error_code ec;
+    const bool creating = !std::filesystem::exists(path, ec) && (has_patch || edits[0].old_text.empty());
+    if (!creating && !load_file(path, text, error)) {
+        out = "ERROR: " + error;
+        return;
+    }
+
+    size_t added = 0, removed = 0;
+    bool ok = has_edits ? apply_edits(text, edits, error)
+        : apply_hunks(text, files[0].hunks, error, &added, &removed);
+    if (!ok) {
+        out = "ERROR: " + path + ": " + error + ". Nothing was written.";
+        return;
+    }
+
+    if (creating) {
+        std::filesystem::path parent = std::filesystem::path(path).parent_path();
+        if (!parent.empty()) std::filesystem::create_directories(parent, ec);
+    }
+    if (!write_file_atomic(path, text, sync, error)) {
+        out = "ERROR: " + error;
+        return;
+    }
+    remember_write(ctx, path, text);
+
+    out = "SUCCESS: " + path + (creating ? " created" : " edited");
+    if (has_edits) out += ", " + std::to_string(edits.size()) + (edits.size() == 1 ? " edit" : " edits") + " applied.";
+    else out += ", +" + std::to_string(added) + " -" + std::to_string(removed) + " lines.";
+}
+
+void ApplyPatchTool::execute(const json& args, const ToolContext& ctx, std::string& out) {
+    namespace fs = std::filesystem;
+
+    if (!args.contains("patch") || !args["patch"].is_string()) {
+        out = "ERROR: invalid arguments";
+        return;
+    }
+
+    std::vector<FilePatch> files;
+    std::string error;
+    if (!parse_unified_diff(args["patch"].get_ref<const std::string&>(), files, error)) {
+        out = "ERROR: " + error;
+        return;
+    }
+
+    // everything is checked and computed first, a bad hunk in the last file
+    // leaves the first one alone
+    std::vector<PendingFile> pending;
+    std::set<std::string> touched;
+    for (const FilePatch& file : files) {
+        const std::string& name = file.deletes() ? file.old_path : file.new_path;
+        std::set<std::string> paths;
+        for (const std::string* p : { &file.old_path, &file.new_path }) {
+            if (p->empty()) continue;
+            if (!valid_write_path(*p)) {
+                out = "ERROR: invalid path " + *p + ". Nothing was written.";
+                return;
+            }
+            paths.insert(normalize_tool_path(*p));
+        }
+        for (const std::string& p : paths) {
+            if (!touched.insert(p).second) {
+                out = "ERROR: " + p + " appears twice in the patch. Nothing was written.";
+                return;
+            }
+        }
+
+        PendingFile change;
+        std::error_code ec;
+        size_t added = 0, removed = 0;
+        if (file.creates()) {
+            if (fs::exists(file.new_path, ec)) {
+                out = "ERROR: " + file.new_path + " already exists, it cannot be created. Nothing was written.";
+                return;
+            }
+        }
+        else if (!load_file(file.old_path, change.content, error)) {
+            out = "ERROR: " + error + ". Nothing was written.";
+            return;
+        }
+        if (!apply_hunks(change.content, file.hunks, error, &added, &removed)) {
+            out = "ERROR: " + name + ": " + error + ". Nothing was written.";
+            return;
+        }
+
+        if (file.deletes()) {
+            change.removed = file.old_path;
+            change.summary = "D " + file.old_path;
+        }
+        else {
+            change.path = file.new_path;
+            if (!file.creates() && file.old_path != file.new_path) change.removed = file.old_path;
+
+            std::string before;
+            if (fs::exists(change.path, ec) && load_file(change.path, before, error)) change.before = std::move(before);
+
+            const char* kind = file.creates() ? "A " : change.removed.empty() ? "M " : "R ";
+            change.summary = kind + (change.removed.empty() ? "" : change.removed + " -> ") + change.path +
+                " (+" + std::to_string(added) + " -" + std::to_string(removed) + ")";
+        }
+        pending.push_back(std::move(change));
+    }
+
+    // writes go first and deletes last, so a failed write can still be undone
+    size_t written = 0;
+    for (; written < pending.size(); ++written) {
+        PendingFile& change = pending[written];
+        if (change.path.empty()) continue;
+
+        fs::path parent = fs::path(change.path).parent_path();
+        std::error_code ec;
+        if (!parent.empty()) fs::create_directories(parent, ec);
+        if (!write_file_atomic(change.path, change.content, sync, error)) break;
+    }
+
+    if (written < pending.size()) {
+        for (size_t i = 0; i < written; ++i) {
+            const PendingFile& change = pending[i];
+            if (change.path.empty()) continue;
+            std::string ignored;
+            std::error_code ec;
+            if (change.before) write_file_atomic(change.path, *change.before, sync, ignored);
+            else fs::remove(change.path, ec);
+        }
+        out = "ERROR: writing " + pending[written].path + ": " + error + ". The files written before it were restored.";
+        return;
+    }
+
+    for (const PendingFile& change : pending) {
+        std::error_code ec;
+        if (!change.removed.empty()) fs::remove(change.removed, ec);
+        if (!change.path.empty()) remember_write(ctx, change.path, change.content);
+    }
+
+    out = "SUCCESS: patched " + std::to_string(pending.size()) + (pending.size() == 1 ? " file:" : " files:");
+    for (const PendingFile& change : pending) out += "\n" + change.summary;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include "tool.hpp"
+
+using json = nlohmann::json;
+
+// changes to existing files without sending them back whole. both tools
+// build the new content in memory and only touch the disk once every edit
+// applied, through write_file_atomic
+
+// edit-TOOL, search/replace edits or unified diff hunks on one file
+class EditFileTool : public Tool {
+public:
+    static constexpr size_t MAX_SIZE = 64 * 1024 * 1024;
+
+    static constexpr ToolParam PARAMS[] = {
+        { "path", "string", "The path of the file to edit", true },
+        { "edits", "array", "Replacements applied in order. old_string has to match the file exactly and only once (unless replace_all); an empty old_string fills a new or empty file", false,
+          R"({"type":"object","properties":{"old_string":{"type":"string"},"new_string":{"type":"string"},"replace_all":{"type":"boolean"}},"required":["old_string","new_string"]})" },
+        { "patch", "string", "Instead of edits: unified diff hunks (@@ -start,count +start,count @@) for this file" },
+    };
+    static constexpr ToolSpec SPEC{
+        "edit_file",
+        "Change part of a file by exact string replacement (edits) or unified diff hunks (patch), without resending the whole file. Pass exactly one of edits or patch",
+        PARAMS
+    };
+
+    // sync: fsync every write before answering
+    explicit EditFileTool(bool sync = false) : sync(sync) {}
+
+    const ToolSpec& spec() const override { return SPEC; }
+    ToolAccess access(const json& args) const override;
+    void execute(const json& args, const ToolContext& ctx, std::string& out) override;
+
+private:
+    bool sync;
+};
+
+// patch-TOOL, a unified diff over any number of files
+class ApplyPatchTool : public Tool {
+public:
+    static constexpr size_t MAX_SIZE = EditFileTool::MAX_SIZE;
+
+    static constexpr ToolParam PARAMS[] = {
+        { "patch", "string", "A unified diff (git diff style, ---/+++ headers per file). /dev/null as the old side creates a file, as the new side deletes it", true },
+    };
+    static constexpr ToolSpec SPEC{
+        "apply_patch",
+        "Apply a unified diff to one or more files. Every hunk is checked before anything is written, so either all files change or none do",
+        PARAMS
+    };
+
+    explicit ApplyPatchTool(bool sync = false) : sync(sync) {}
+
+    const ToolSpec& spec() const override { return SPEC; }
+
+    // paths are only known after parsing, so a patch runs alone
+    ToolAccess access(const json& args) const override { return { "", true }; }
+    void execute(const json& args, const ToolContext& ctx, std::string& out) override;
+
+private:
+    bool sync;
+};
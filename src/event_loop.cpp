@@ -0,0 +1,202 @@
+#include "event_loop.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+struct EventLoop::Detached {
+    struct promise_type {
+        Detached get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+EventLoop::EventLoop() {
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    multi = curl_multi_init();
+    if (!multi) {
+        throw std::runtime_error("curl_multi_init failed");
+    }
+
+    // h2 streams of concurrent requests share one connection when the server allows it
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+}
+
+EventLoop::~EventLoop() {
+    for (auto& [easy, transfer] : transfers) {
+        curl_multi_remove_handle(multi, easy);
+    }
+    curl_multi_cleanup(multi);
+}
+
+EventLoop::Detached EventLoop::run_detached(EventLoop& loop, Task<void> task) {
+    // never start inside whoever spawned us (that may be a curl callback)
+    co_await loop.yield();
+
+    try {
+        co_await task;
+    }
+    catch (...) {
+        if (!loop.first_error) loop.first_error = std::current_exception();
+    }
+
+    loop.active--;
+}
+
+void EventLoop::spawn(Task<void> task) {
+    active++;
+    run_detached(*this, std::move(task));
+}
+
+void EventLoop::post(std::function<void()> fn) {
+    {
+        std::lock_guard<std::mutex> lock(posted_mutex);
+        posted.push_back(std::move(fn));
+    }
+    curl_multi_wakeup(multi);
+}
+
+void EventLoop::run() {
+    while (active > 0) {
+        run_ready();
+        if (active == 0) break;
+        wait_for_events();
+    }
+
+    if (first_error) {
+        std::exception_ptr error = std::exchange(first_error, nullptr);
+        std::rethrow_exception(error);
+    }
+}
+
+void EventLoop::add_transfer(CURL* easy, std::coroutine_handle<> handle, CURLcode* result) {
+    CURLMcode rc = curl_multi_add_handle(multi, easy);
+    if (rc != CURLM_OK) {
+        *result = CURLE_FAILED_INIT;
+        resume_later(handle);
+        return;
+    }
+
+    transfers[easy] = Transfer{ handle, result };
+}
+
+bool EventLoop::cancel(CURL* easy) {
+    auto it = transfers.find(easy);
+    if (it == transfers.end()) return false;
+
+    curl_multi_remove_handle(multi, easy);
+    *it->second.result = CURLE_ABORTED_BY_CALLBACK;
+    resume_later(it->second.handle);
+    transfers.erase(it);
+    return true;
+}
+
+void EventLoop::add_wait(void* fds, size_t count, clock::time_point deadline, std::coroutine_handle<> handle, int* result) {
+    waits.push_back(Wait{ fds, count, deadline, handle, result });
+}
+
+void EventLoop::run_ready() {
+    while (true) {
+        std::vector<std::function<void()>> batch;
+        {
+            std::lock_guard<std::mutex> lock(posted_mutex);
+            batch.swap(posted);
+        }
+
+        if (batch.empty() && ready.empty()) return;
+
+        for (auto& fn : batch) {
+            fn();
+        }
+
+        // whatever these resume may queue more, the outer loop picks it up
+        size_t count = ready.size();
+        for (size_t i = 0; i < count; ++i) {
+            std::coroutine_handle<> handle = ready.front();
+            ready.pop_front();
+            handle.resume();
+        }
+    }
+}
+
+void EventLoop::wait_for_events() {
+    auto now = clock::now();
+
+    // nothing to wait on but offloaded work: sleep until a post() wakes us
+    long timeout_ms = 1000;
+    for (const auto& wait : waits) {
+        auto left = std::chrono::ceil<std::chrono::milliseconds>(wait.deadline - now).count();
+        timeout_ms = std::clamp<long>(left, 0, timeout_ms);
+    }
+
+    std::vector<curl_waitfd> extra;
+#ifndef _WIN32
+    for (const auto& wait : waits) {
+        auto* fds = static_cast<pollfd*>(wait.fds);
+        for (size_t i = 0; i < wait.count; ++i) {
+            curl_waitfd fd{};
+            fd.fd = fds[i].fd;
+            if (fds[i].events & POLLIN) fd.events |= CURL_WAIT_POLLIN;
+            if (fds[i].events & POLLOUT) fd.events |= CURL_WAIT_POLLOUT;
+            extra.push_back(fd);
+        }
+    }
+#endif
+
+    curl_multi_poll(multi, extra.data(), static_cast<unsigned>(extra.size()), static_cast<int>(timeout_ms), nullptr);
+
+    if (!transfers.empty()) {
+        int running = 0;
+        curl_multi_perform(multi, &running);
+
+        int left = 0;
+        while (CURLMsg* msg = curl_multi_info_read(multi, &left)) {
+            if (msg->msg != CURLMSG_DONE) continue;
+
+            CURL* easy = msg->easy_handle;
+            CURLcode code = msg->data.result;
+            curl_multi_remove_handle(multi, easy);
+
+            auto it = transfers.find(easy);
+            if (it == transfers.end()) continue;
+            *it->second.result = code;
+            resume_later(it->second.handle);
+            transfers.erase(it);
+        }
+    }
+
+    now = clock::now();
+    for (auto it = waits.begin(); it != waits.end();) {
+        int ready_fds = 0;
+#ifndef _WIN32
+        // curl only passes on in/out/pri, a pipe whose writer is gone shows up
+        // as POLLHUP alone, so take the real revents from a non blocking poll
+        if (it->count > 0) {
+            ready_fds = ::poll(static_cast<pollfd*>(it->fds), it->count, 0);
+            if (ready_fds < 0) ready_fds = 0;
+        }
+#endif
+        if (ready_fds > 0 || now >= it->deadline) {
+            if (it->result) *it->result = ready_fds;
+            resume_later(it->handle);
+            it = waits.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+void AsyncEvent::set() {
+    if (set_) return;
+    set_ = true;
+
+    std::vector<std::coroutine_handle<>> resume = std::move(waiters);
+    waiters.clear();
+    for (auto handle : resume) {
+        handle.resume();
+    }
+}
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <chrono>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <curl/curl.h>
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+#include "task.hpp"
+
+// single threaded scheduler for the agent coroutines.
+// http transfers run on one curl multi handle (so every client shares its
+// connection cache), and the loop sleeps in curl_multi_poll together with
+// whatever pipes the coroutines wait on. blocking work is offloaded to a
+// thread pool and resumes back on the loop thread
+class EventLoop {
+public:
+    using clock = std::chrono::steady_clock;
+
+    EventLoop();
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // starts task on the next pass of the loop
+    void spawn(Task<void> task);
+
+    // runs until every spawned task is done, then rethrows the first exception one of them let out
+    void run();
+
+    // spawns task and runs the loop until everything is done
+    template <typename T>
+    T block_on(Task<T> task) {
+        std::optional<T> value;
+        spawn(store(std::move(task), value));
+        run();
+        return std::move(*value);
+    }
+
+    // safe from any thread, fn runs on the loop thread
+    void post(std::function<void()> fn);
+
+    // loop thread only, resumes handle on the next pass
+    void resume_later(std::coroutine_handle<> handle) { ready.push_back(handle); }
+
+    // suspends until the next pass of the loop
+    auto yield() {
+        struct Awaiter {
+            EventLoop& loop;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) { loop.resume_later(handle); }
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{ *this };
+    }
+
+    // performs a prepared easy handle, resumes with its result code
+    auto transfer(CURL* handle) {
+        struct Awaiter {
+            EventLoop& loop;
+            CURL* easy;
+            CURLcode result = CURLE_OK;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) { loop.add_transfer(easy, handle, &result); }
+            CURLcode await_resume() const noexcept { return result; }
+        };
+        return Awaiter{ *this, handle };
+    }
+
+    // stops a transfer started with transfer(), its awaiter resumes with
+    // CURLE_ABORTED_BY_CALLBACK. false when easy is not in flight
+    bool cancel(CURL* easy);
+
+    auto sleep_for(std::chrono::milliseconds duration) {
+        struct Awaiter {
+            EventLoop& loop;
+            clock::time_point deadline;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) { loop.add_wait(nullptr, 0, deadline, handle, nullptr); }
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{ *this, clock::now() + duration };
+    }
+
+#ifndef _WIN32
+    // like ::poll, but yields: resumes with the number of ready fds (revents
+    // filled in) or 0 once timeout_ms passed
+    auto poll(pollfd* fds, size_t count, int timeout_ms) {
+        struct Awaiter {
+            EventLoop& loop;
+            pollfd* fds;
+            size_t count;
+            clock::time_point deadline;
+            int result = 0;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) { loop.add_wait(fds, count, deadline, handle, &result); }
+            int await_resume() const noexcept { return result; }
+        };
+        return Awaiter{ *this, fds, count, clock::now() + std::chrono::milliseconds(timeout_ms) };
+    }
+#endif
+
+    // runs fn on pool (anything with submit(callable)) and resumes on the loop
+    // thread with its result, exceptions are rethrown in the awaiting coroutine
+    template <typename Pool, typename F>
+    auto offload(Pool& pool, F fn) {
+        using R = decltype(fn());
+        using Slot = std::conditional_t<std::is_void_v<R>, bool, R>;
+
+        struct Awaiter {
+            EventLoop& loop;
+            Pool& pool;
+            F fn;
+            std::optional<Slot> value;
+            std::exception_ptr error;
+
+            bool await_ready() const noexcept { return false; }
+
+            void await_suspend(std::coroutine_handle<> handle) {
+                pool.submit([this, handle]() {
+                    try {
+                        if constexpr (std::is_void_v<R>) {
+                            fn();
+                            value.emplace(true);
+                        }
+                        else {
+                            value.emplace(fn());
+                        }
+                    }
+                    catch (...) {
+                        error = std::current_exception();
+                    }
+                    loop.post([handle]() { handle.resume(); });
+                });
+            }
+
+            R await_resume() {
+                if (error) std::rethrow_exception(error);
+                if constexpr (!std::is_void_v<R>) return std::move(*value);
+            }
+        };
+        return Awaiter{ *this, pool, std::move(fn) };
+    }
+
+private:
+    struct Detached;
+
+    struct Wait {
+        void* fds;      // pollfd*, null for a plain sleep
+        size_t count;
+        clock::time_point deadline;
+        std::coroutine_handle<> handle;
+        int* result;
+    };
+
+    struct Transfer {
+        std::coroutine_handle<> handle;
+        CURLcode* result;
+    };
+
+    static Detached run_detached(EventLoop& loop, Task<void> task);
+
+    template <typename T>
+    static Task<void> store(Task<T> task, std::optional<T>& value) {
+        value.emplace(co_await task);
+    }
+
+    void add_transfer(CURL* easy, std::coroutine_handle<> handle, CURLcode* result);
+    void add_wait(void* fds, size_t count, clock::time_point deadline, std::coroutine_handle<> handle, int* result);
+
+    void run_ready();
+    void wait_for_events();
+
+    CURLM* multi;
+    std::unordered_map<CURL*, Transfer> transfers;
+    std::list<Wait> waits;
+    std::deque<std::coroutine_handle<>> ready;
+
+    size_t active = 0; // spawned tasks still running
+    std::exception_ptr first_error;
+
+    std::mutex posted_mutex;
+    std::vector<std::function<void()>> posted;
+};
+
+// one shot signal between coroutines on the same loop
+class AsyncEvent {
+public:
+    bool is_set() const { return set_; }
+
+    // resumes every waiter right away
+    void set();
+
+    auto wait() {
+        struct Awaiter {
+            AsyncEvent& event;
+            bool await_ready() const noexcept { return event.set_; }
+            void await_suspend(std::coroutine_handle<> handle) { event.waiters.push_back(handle); }
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{ *this };
+    }
+
+private:
+    bool set_ = false;
+    std::vector<std::coroutine_handle<>> waiters;
+};
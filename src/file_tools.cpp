@@ -0,0 +1,324 @@
+#include "file_tools.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <system_error>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mapped_file.hpp"
+#include "read_cache.hpp"
+
+namespace {
+
+bool is_continuation(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+size_t next_line(std::string_view data, size_t pos) {
+    const void* nl = std::memchr(data.data() + pos, '\n', data.size() - pos);
+    if (!nl) return data.size();
+    return static_cast<const char*>(nl) - data.data() + 1;
+}
+
+size_t number_arg(const json& args, const char* key, size_t fallback) {
+    if (!args.contains(key) || !args[key].is_number()) return fallback;
+    double value = args[key].get<double>();
+    // the model may send 1e30, casting that to size_t is undefined
+    const size_t max = std::numeric_limits<size_t>::max();
+    if (value < 0) return 0;
+    if (!(value < static_cast<double>(max))) return max;
+    return static_cast<size_t>(value);
+}
+
+}
+
+bool valid_write_path(const std::string& path) {
+    return !path.empty() &&
+        path.find("..") == std::string::npos &&
+        path[0] != '/' &&
+        path.find(":") == std::string::npos;
+}
+
+bool write_file_atomic(const std::string& path, std::string_view content, bool sync, std::string& error) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+
+    // replace the file a link points at, not the link
+    fs::path target = path;
+    if (fs::is_symlink(target, ec)) {
+        target = fs::weakly_canonical(target, ec);
+        if (ec) {
+            error = "could not resolve " + path + ": " + ec.message();
+            return false;
+        }
+    }
+
+    static std::atomic<unsigned> serial{ 0 };
+    const std::string temp = target.string() + ".tmp." + std::to_string(getpid()) + "." + std::to_string(serial++);
+
+#ifdef _WIN32
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            error = "could not open file for writing.";
+            return false;
+        }
+        if (!file.write(content.data(), content.size())) {
+            error = "write failed.";
+            file.close();
+            fs::remove(temp, ec);
+            return false;
+        }
+    }
+    (void)sync;
+#else
+    struct stat st;
+    const bool existed = ::stat(target.c_str(), &st) == 0;
+
+    int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+    if (fd < 0) {
+        error = "could not open file for writing.";
+        return false;
+    }
+    // a new file gets the umask, an existing one keeps its mode as it is
+    if (existed) ::fchmod(fd, st.st_mode & 07777);
+
+    bool ok = true;
+    for (size_t written = 0; ok && written < content.size();) {
+        ssize_t n = ::write(fd, content.data() + written, content.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        ok = n > 0;
+        if (ok) written += static_cast<size_t>(n);
+    }
+    if (ok && sync) ok = ::fsync(fd) == 0;
+    ok = ::close(fd) == 0 && ok;
+
+    if (!ok) {
+        error = "write failed.";
+        ::unlink(temp.c_str());
+        return false;
+    }
+#endif
+
+    fs::rename(temp, target, ec);
+    if (ec) {
+        error = "could not replace " + path + ": " + ec.message();
+        fs::remove(temp, ec);
+        return false;
+    }
+
+#ifndef _WIN32
+    // the rename itself lives in the directory
+    if (sync) {
+        fs::path dir = target.parent_path();
+        int dir_fd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dir_fd >= 0) {
+            ::fsync(dir_fd);
+            ::close(dir_fd);
+        }
+    }
+#endif
+    return true;
+}
+
+ToolAccess ReadFileTool::access(const json& args) const {
+    if (!args.contains("path") || !args["path"].is_string()) return {};
+    return { normalize_tool_path(args["path"]), false };
+}
+
+void ReadFileTool::execute(const json& args, const ToolContext& ctx, std::string& out) {
+    if (!args.contains("path") || !args["path"].is_string()) {
+        out = "ERROR : invalid argumnets.";
+        return;
+    }
+
+    const std::string& path = args["path"].get_ref<const std::string&>();
+
+    //basic path traversal protection
+    if (path.find("..") != std::string::npos) {
+        out = "ERROR : path traversal detected.";
+        return;
+    }
+
+    // an unchanged re-read only costs a stat and a one line answer
+    std::string key = cache_key(path, args);
+    FileStamp stamp;
+    if (ctx.read_cache) {
+        stamp = stamp_file(path);
+        if (CacheHit earlier = ctx.read_cache->lookup(key, stamp)) {
+            out = unchanged_note(path, earlier);
+            return;
+        }
+    }
+
+    read(path, args, page_limit(ctx), out);
+
+    // a result the history cuts short is no earlier copy to point back at
+    const bool kept_whole = ctx.max_result_bytes == 0 || out.size() <= ctx.max_result_bytes;
+
+    if (ctx.read_cache && stamp.valid && kept_whole && !out.starts_with("ERROR")) {
+        uint64_t hash = content_hash(out);
+        if (CacheHit earlier = ctx.read_cache->lookup_content(key, stamp, hash)) {
+            out = unchanged_note(path, earlier);
+            return;
+        }
+
+        ctx.read_cache->remember(key, normalize_tool_path(path), stamp, hash, ctx.call_id);
+    }
+}
+
+std::string ReadFileTool::cache_key(const std::string& path, const json& args) {
+    json range = args;
+    range.erase("path");
+    return normalize_tool_path(path) + "\n" + range.dump();
+}
+
+std::string ReadFileTool::unchanged_note(const std::string& path, const CacheHit& earlier) {
+    if (earlier.written) {
+        return "UNCHANGED: " + path + " still holds exactly the content written by tool_call " +
+            earlier.call_id + " earlier in this conversation.";
+    }
+    return "UNCHANGED: " + path + " is identical to the result of tool_call " + earlier.call_id +
+        " earlier in this conversation, use that.";
+}
+
+size_t ReadFileTool::page_limit(const ToolContext& ctx) {
+    if (ctx.max_result_bytes == 0) return MAX_SIZE;
+    const size_t HEADER_ROOM = 1024;
+    size_t room = std::min(HEADER_ROOM, ctx.max_result_bytes / 2);
+    return std::min(MAX_SIZE, ctx.max_result_bytes - room);
+}
+
+void ReadFileTool::read(const std::string& path, const json& args, size_t limit, std::string& out) {
+    MappedFile file;
+    if (!file.open(path)) {
+        out = "ERROR : " + file.error();
+        return;
+    }
+
+    std::string_view data = file.view();
+
+    const bool by_lines = args.contains("start_line") || args.contains("end_line");
+    const bool by_bytes = args.contains("offset") || args.contains("length");
+
+    // plain small read, same answer as always
+    if (!by_lines && !by_bytes && data.size() <= limit) {
+        out.assign(data);
+        return;
+    }
+
+    size_t begin = 0;
+    size_t end = 0;
+    std::ostringstream header;
+
+    if (by_lines) {
+        size_t first_line = std::max<size_t>(1, number_arg(args, "start_line", 1));
+        size_t last_line = number_arg(args, "end_line", std::string::npos);
+        if (last_line < first_line) {
+            out = "ERROR: end_line before start_line.";
+            return;
+        }
+
+        // only walks (and so only faults in) the pages up to the last wanted line
+        size_t line = 1;
+        while (line < first_line && begin < data.size()) {
+            begin = next_line(data, begin);
+            line++;
+        }
+        if (line < first_line) {
+            out = "ERROR: start_line past end of file (" + std::to_string(line - 1) + " lines).";
+            return;
+        }
+
+        end = begin;
+        while (line <= last_line && end < data.size() && end - begin < limit) {
+            end = next_line(data, end);
+            line++;
+        }
+        end = std::min(end, begin + limit);
+
+        header << "[lines " << first_line << "-" << (line - 1) << " of " << path
+            << ", bytes " << begin << "-" << end << " of " << data.size() << "]\n";
+    }
+    else {
+        begin = std::min<size_t>(number_arg(args, "offset", 0), data.size());
+        size_t length = std::min<size_t>(number_arg(args, "length", std::min(PAGE_SIZE, limit)), limit);
+        end = std::min(data.size(), begin + length);
+
+        // keep utf-8 sequences whole
+        while (begin < end && is_continuation(data[begin])) begin++;
+        while (end > begin && end < data.size() && is_continuation(data[end])) end--;
+
+        header << "[bytes " << begin << "-" << end << " of " << data.size() << " in " << path;
+        if (!by_bytes) {
+            header << ", file is over " << limit << " bytes";
+        }
+        if (end < data.size()) {
+            header << "; pass offset/length or start_line/end_line for the rest";
+        }
+        header << "]\n";
+    }
+
+    std::string head = header.str();
+    out.clear();
+    out.reserve(head.size() + (end - begin));
+    out += head;
+    out.append(data.substr(begin, end - begin));
+}
+
+ToolAccess WriteFileTool::access(const json& args) const {
+    if (!args.contains("path") || !args["path"].is_string()) return { "", false };
+    return { normalize_tool_path(args["path"]), true };
+}
+
+void WriteFileTool::execute(const json& args, const ToolContext& ctx, std::string& out) {
+
+    if (!args.contains("path") || !args["path"].is_string() ||
+        !args.contains("content") || !args["content"].is_string())
+    {
+        out = "ERROR: invalid arguments";
+        return;
+    }
+
+    // references into the parsed arguments, the content can be a megabyte
+    const std::string& path = args["path"].get_ref<const std::string&>();
+    const std::string& content = args["content"].get_ref<const std::string&>();
+
+    if (!valid_write_path(path)) {
+        out = "ERROR: invalid arguments ";
+        return;
+    }
+
+    if (content.size() > MAX_SIZE) {
+        out = "ERROR: content too large.";
+        return;
+    }
+
+    std::string error;
+    if (!write_file_atomic(path, content, sync, error)) {
+        out = "ERROR: " + error;
+        return;
+    }
+
+    // the model knows what it just wrote, a read right after can point back here
+    if (ctx.read_cache) {
+        ctx.read_cache->record_write(normalize_tool_path(path), ReadFileTool::cache_key(path, json::object()),
+                                     stamp_file(path), content_hash(content), ctx.call_id);
+    }
+
+    out = "SUCESS: file written.";
+}
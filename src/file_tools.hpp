@@ -0,0 +1,82 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include <nlohmann/json.hpp>
+
+#include "tool.hpp"
+
+using json = nlohmann::json;
+
+struct CacheHit;
+
+// writes content to a temp file next to path and renames it over path, so
+// readers see the old file or the new one and never half of it. an existing
+// file keeps its permissions, a symlink keeps pointing at the file it names.
+// with sync the data (and the rename) reach the disk before this returns
+bool write_file_atomic(const std::string& path, std::string_view content, bool sync, std::string& error);
+
+// relative, inside the working directory, nothing to interpret
+bool valid_write_path(const std::string& path);
+
+// read-Tool
+class ReadFileTool : public Tool {
+public:
+    static constexpr size_t MAX_SIZE = 1'000'000;
+    static constexpr size_t PAGE_SIZE = 64 * 1024;
+
+    static constexpr ToolParam PARAMS[] = {
+        { "path", "string", "The path to the file to read", true },
+        { "offset", "integer", "Byte offset to start reading at" },
+        { "length", "integer", "Number of bytes to read (default 65536, max 1000000 or what fits in one result)" },
+        { "start_line", "integer", "First line to read, 1-based" },
+        { "end_line", "integer", "Last line to read, inclusive" },
+    };
+    static constexpr ToolSpec SPEC{
+        "read_file",
+        "Read and return the contents of a file. Files too big for one result come back as a 64 KB page, use offset/length or start_line/end_line to read a window",
+        PARAMS
+    };
+
+    const ToolSpec& spec() const override { return SPEC; }
+    ToolAccess access(const json& args) const override;
+    void execute(const json& args, const ToolContext& ctx, std::string& out) override;
+
+    // path + range, a read of the same window of the same file gets the same key
+    static std::string cache_key(const std::string& path, const json& args);
+
+private:
+    static std::string unchanged_note(const std::string& path, const CacheHit& earlier);
+
+    // the most file data one result holds: MAX_SIZE, or less when the
+    // history would cut the middle out of it, with room for the page header
+    static size_t page_limit(const ToolContext& ctx);
+
+    // the only copy of the file data is the one from the mapping into out
+    void read(const std::string& path, const json& args, size_t limit, std::string& out);
+};
+
+// Write-TOOL
+class WriteFileTool : public Tool {
+public:
+    static constexpr size_t MAX_SIZE = 1'000'000;
+
+    static constexpr ToolParam PARAMS[] = {
+        { "path", "string", "The path of the file to write", true },
+        { "content", "string", "content to write into file", true },
+    };
+    static constexpr ToolSpec SPEC{ "write_file", "Write content to a file (overwrites if exists)", PARAMS };
+
+    // sync: fsync every write before answering
+    explicit WriteFileTool(bool sync = false) : sync(sync) {}
+
+    const ToolSpec& spec() const override { return SPEC; }
+
+    // two writes (or a read and a write) of the same path keep their order
+    ToolAccess access(const json& args) const override;
+    void execute(const json& args, const ToolContext& ctx, std::string& out) override;
+
+private:
+    bool sync;
+};
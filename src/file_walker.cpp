@@ -0,0 +1,184 @@
+#include "file_walker.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+#include "gitignore.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct DirJob {
+    fs::path dir;
+    std::string rel; // "" for the root, otherwise "a/b/"
+    int depth = 0;
+    std::shared_ptr<const IgnoreChain> ignore;
+};
+
+struct WalkState {
+    const WalkOptions& options;
+    std::string display_root; // "" when walking "."
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<DirJob> stack;
+    size_t busy = 0;          // queued + being listed
+    std::atomic<size_t> count{ 0 };
+    std::atomic<bool> full{ false };
+
+    std::vector<std::vector<WalkEntry>> per_thread;
+};
+
+long long to_epoch_ns(fs::file_time_type time) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+void list_dir(WalkState& state, DirJob job, std::vector<WalkEntry>& out) {
+    const WalkOptions& options = state.options;
+
+    // this directory's own .gitignore already applies to its entries
+    std::shared_ptr<const IgnoreChain> ignore = job.ignore;
+    if (options.respect_gitignore && !job.rel.empty()) {
+        if (auto file = IgnoreFile::load((job.dir / ".gitignore").string(), job.rel)) {
+            ignore = IgnoreChain::extend(ignore, std::move(*file));
+        }
+    }
+
+    std::error_code ec;
+    fs::directory_iterator it(job.dir, fs::directory_options::skip_permission_denied, ec);
+    if (ec) return;
+
+    std::vector<DirJob> children;
+
+    for (; it != fs::directory_iterator(); it.increment(ec)) {
+        if (ec) break;
+        if (state.full.load(std::memory_order_relaxed)) break;
+
+        const fs::directory_entry& entry = *it;
+        std::string name = entry.path().filename().string();
+        if (name == ".git") continue;
+
+        std::error_code type_ec;
+        bool is_link = entry.is_symlink(type_ec);
+        bool is_dir = !is_link && entry.is_directory(type_ec);
+        if (!is_dir && !entry.is_regular_file(type_ec)) continue; // sockets, dangling links
+
+        std::string rel = job.rel + name;
+        if (options.respect_gitignore && IgnoreChain::ignored(ignore.get(), rel, is_dir)) continue;
+
+        const int depth = job.depth + 1;
+
+        if (!is_dir || !options.files_only) {
+            if (options.max_entries > 0 && state.count.fetch_add(1, std::memory_order_relaxed) >= options.max_entries) {
+                state.full.store(true, std::memory_order_relaxed);
+                break;
+            }
+
+            WalkEntry item;
+            item.path = state.display_root.empty() ? rel : state.display_root + "/" + rel;
+            item.rel = rel;
+            item.is_dir = is_dir;
+            item.depth = depth;
+            if (!is_dir) {
+                item.size = entry.file_size(type_ec);
+                item.mtime = to_epoch_ns(entry.last_write_time(type_ec));
+            }
+            out.push_back(std::move(item));
+        }
+
+        if (is_dir && (options.max_depth < 0 || depth < options.max_depth)) {
+            children.push_back(DirJob{ entry.path(), rel + "/", depth, ignore });
+        }
+    }
+
+    if (!children.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.busy += children.size();
+            for (auto& child : children) state.stack.push_back(std::move(child));
+        }
+        state.wake.notify_all();
+    }
+}
+
+void worker(WalkState& state, size_t index) {
+    std::vector<WalkEntry>& out = state.per_thread[index];
+
+    while (true) {
+        DirJob job;
+        {
+            std::unique_lock<std::mutex> lock(state.mutex);
+            state.wake.wait(lock, [&]() { return !state.stack.empty() || state.busy == 0; });
+            if (state.stack.empty()) return; // busy == 0, everything is listed
+
+            // depth first keeps the stack (and the memory it pins) small
+            job = std::move(state.stack.back());
+            state.stack.pop_back();
+        }
+
+        list_dir(state, std::move(job), out);
+
+        bool done;
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            done = --state.busy == 0;
+        }
+        if (done) state.wake.notify_all();
+    }
+}
+
+}
+
+WalkResult walk_tree(const std::string& root, const WalkOptions& options) {
+    WalkResult result;
+
+    std::error_code ec;
+    if (!fs::is_directory(root, ec)) {
+        result.error = "not a directory: " + root;
+        return result;
+    }
+
+    WalkState state{ options };
+    state.display_root = root;
+    while (state.display_root.size() > 1 && state.display_root.back() == '/') state.display_root.pop_back();
+    if (state.display_root == ".") state.display_root.clear();
+
+    size_t threads = options.threads;
+    if (threads == 0) threads = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, 8);
+    state.per_thread.resize(threads);
+
+    DirJob first{ fs::path(root), "", 0, nullptr };
+    if (options.respect_gitignore) first.ignore = IgnoreChain::for_root(root);
+    state.stack.push_back(std::move(first));
+    state.busy = 1;
+
+    // the calling thread is one of the workers
+    std::vector<std::thread> helpers;
+    for (size_t i = 1; i < threads; ++i) {
+        helpers.emplace_back(worker, std::ref(state), i);
+    }
+    worker(state, 0);
+    for (auto& helper : helpers) helper.join();
+
+    size_t total = 0;
+    for (const auto& part : state.per_thread) total += part.size();
+    result.entries.reserve(total);
+    for (auto& part : state.per_thread) {
+        std::move(part.begin(), part.end(), std::back_inserter(result.entries));
+    }
+
+    std::sort(result.entries.begin(), result.entries.end(), [](const WalkEntry& a, const WalkEntry& b) {
+        return a.rel < b.rel;
+    });
+
+    result.truncated = state.full.load();
+    return result;
+}
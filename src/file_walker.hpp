@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct WalkEntry {
+    std::string path;  // root joined with rel, what the tools print
+    std::string rel;   // relative to the walk root, '/' separated
+    bool is_dir = false;
+    uint64_t size = 0;
+    long long mtime = 0;
+    int depth = 0;     // 1 = directly inside the root
+};
+
+struct WalkOptions {
+    size_t threads = 0;           // 0 = pick from hardware_concurrency
+    bool respect_gitignore = true;
+    int max_depth = -1;           // -1 = unlimited
+    size_t max_entries = 0;       // 0 = unlimited, otherwise stop early
+    bool files_only = false;      // do not report directories (they are still walked)
+};
+
+struct WalkResult {
+    std::vector<WalkEntry> entries; // sorted by rel
+    bool truncated = false;         // max_entries was hit
+    std::string error;              // root could not be read
+};
+
+// lists the tree under root with several threads sharing one stack of
+// directories. .git is never entered, symlinked directories are not followed
+WalkResult walk_tree(const std::string& root, const WalkOptions& options = {});
@@ -0,0 +1,122 @@
+#include "gitignore.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+#include "glob.hpp"
+
+std::optional<IgnoreFile> IgnoreFile::load(const std::string& file_path, std::string base, std::string prefix) {
+    std::ifstream in(file_path);
+    if (!in) return std::nullopt;
+
+    IgnoreFile file;
+    file.base_ = std::move(base);
+    file.prefix_ = std::move(prefix);
+
+    std::string line;
+    while (std::getline(in, line)) {
+        file.add_line(line);
+    }
+
+    if (file.rules.empty()) return std::nullopt;
+    return file;
+}
+
+void IgnoreFile::add_line(std::string_view line) {
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+    // trailing blanks do not count unless escaped
+    while (!line.empty() && line.back() == ' ' && !(line.size() > 1 && line[line.size() - 2] == '\\')) {
+        line.remove_suffix(1);
+    }
+    if (line.empty() || line.front() == '#') return;
+
+    Rule rule;
+    if (line.front() == '!') {
+        rule.negate = true;
+        line.remove_prefix(1);
+    }
+    else if (line.front() == '\\') {
+        line.remove_prefix(1); // "\#file", "\!file"
+    }
+
+    if (!line.empty() && line.back() == '/') {
+        rule.dir_only = true;
+        line.remove_suffix(1);
+    }
+    if (line.empty()) return;
+
+    // a slash anywhere but the end anchors the pattern to this directory,
+    // otherwise it matches the name at any depth
+    bool anchored = line.find('/') != std::string_view::npos;
+    if (line.front() == '/') line.remove_prefix(1);
+
+    rule.pattern = anchored ? std::string(line) : "**/" + std::string(line);
+    rules.push_back(std::move(rule));
+}
+
+std::optional<bool> IgnoreFile::match(std::string_view rel_path, bool is_dir) const {
+    if (rel_path.substr(0, base_.size()) != base_) return std::nullopt;
+
+    std::string local = prefix_;
+    local.append(rel_path.substr(base_.size()));
+
+    for (auto it = rules.rbegin(); it != rules.rend(); ++it) {
+        if (it->dir_only && !is_dir) continue;
+        if (glob_match(it->pattern, local)) return !it->negate;
+    }
+    return std::nullopt;
+}
+
+std::shared_ptr<const IgnoreChain> IgnoreChain::extend(std::shared_ptr<const IgnoreChain> parent, IgnoreFile file) {
+    auto chain = std::make_shared<IgnoreChain>();
+    chain->file = std::move(file);
+    chain->parent = std::move(parent);
+    return chain;
+}
+
+std::shared_ptr<const IgnoreChain> IgnoreChain::for_root(const std::string& root) {
+    namespace fs = std::filesystem;
+
+    std::error_code ec;
+    fs::path dir = fs::absolute(root, ec).lexically_normal();
+    if (ec) return nullptr;
+    if (!dir.has_filename()) dir = dir.parent_path(); // "a/b/" -> "a/b"
+
+    // collect the directories from root up to the repository top
+    std::vector<fs::path> dirs;
+    for (fs::path cur = dir;; cur = cur.parent_path()) {
+        dirs.push_back(cur);
+        if (fs::exists(cur / ".git", ec) || cur == cur.parent_path()) break;
+    }
+
+    std::shared_ptr<const IgnoreChain> chain;
+    fs::path top = dirs.back();
+
+    // outermost first, so the innermost file ends up at the head of the chain
+    for (auto it = dirs.rbegin(); it != dirs.rend(); ++it) {
+        std::string prefix = dir.lexically_relative(*it).generic_string();
+        if (prefix == ".") prefix.clear();
+        if (!prefix.empty()) prefix += '/';
+
+        if (*it == top) {
+            if (auto exclude = IgnoreFile::load((*it / ".git" / "info" / "exclude").string(), "", prefix)) {
+                chain = extend(chain, std::move(*exclude));
+            }
+        }
+        if (auto file = IgnoreFile::load((*it / ".gitignore").string(), "", prefix)) {
+            chain = extend(chain, std::move(*file));
+        }
+    }
+
+    return chain;
+}
+
+bool IgnoreChain::ignored(const IgnoreChain* chain, std::string_view rel_path, bool is_dir) {
+    // deeper files override the ones above them
+    for (; chain; chain = chain->parent.get()) {
+        if (auto decision = chain->file.match(rel_path, is_dir)) return *decision;
+    }
+    return false;
+}
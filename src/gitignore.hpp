@@ -0,0 +1,50 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// the patterns of one .gitignore (or .git/info/exclude)
+class IgnoreFile {
+public:
+    // base: directory of the file relative to the walk root ("" or "src/"),
+    // prefix: the walk root relative to the file's directory, for files above the root
+    static std::optional<IgnoreFile> load(const std::string& file_path, std::string base, std::string prefix = "");
+
+    void add_line(std::string_view line);
+
+    // rel_path is relative to the walk root. nothing when no rule talks about it,
+    // otherwise whether the last matching rule ignores it
+    std::optional<bool> match(std::string_view rel_path, bool is_dir) const;
+
+    const std::string& base() const { return base_; }
+
+private:
+    struct Rule {
+        std::string pattern; // glob, relative to the file's directory
+        bool negate = false;
+        bool dir_only = false;
+    };
+
+    std::string base_;
+    std::string prefix_;
+    std::vector<Rule> rules;
+};
+
+// the .gitignore files that apply inside one directory, innermost first
+class IgnoreChain {
+public:
+    static std::shared_ptr<const IgnoreChain> extend(std::shared_ptr<const IgnoreChain> parent, IgnoreFile file);
+
+    // the rules for the walk root: .git/info/exclude and the .gitignore files
+    // from the repository top down to root itself
+    static std::shared_ptr<const IgnoreChain> for_root(const std::string& root);
+
+    static bool ignored(const IgnoreChain* chain, std::string_view rel_path, bool is_dir);
+
+private:
+    IgnoreFile file;
+    std::shared_ptr<const IgnoreChain> parent;
+};
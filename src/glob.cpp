@@ -0,0 +1,129 @@
+#include "glob.hpp"
+
+#include <vector>
+
+namespace {
+
+std::vector<std::string_view> split_segments(std::string_view path) {
+    std::vector<std::string_view> segments;
+    size_t start = 0;
+    while (start <= path.size()) {
+        size_t slash = path.find('/', start);
+        if (slash == std::string_view::npos) slash = path.size();
+        if (slash > start) segments.push_back(path.substr(start, slash - start));
+        start = slash + 1;
+    }
+    return segments;
+}
+
+// [...] at pattern[p], advances p past it
+bool match_class(std::string_view pattern, size_t& p, char c) {
+    size_t i = p + 1;
+    bool negate = false;
+    if (i < pattern.size() && (pattern[i] == '!' || pattern[i] == '^')) {
+        negate = true;
+        i++;
+    }
+
+    bool matched = false;
+    bool first = true;
+    while (i < pattern.size() && (first || pattern[i] != ']')) {
+        first = false;
+        char low = pattern[i];
+        if (low == '\\' && i + 1 < pattern.size()) low = pattern[++i];
+        char high = low;
+        if (i + 2 < pattern.size() && pattern[i + 1] == '-' && pattern[i + 2] != ']') {
+            high = pattern[i + 2];
+            i += 2;
+        }
+        if (c >= low && c <= high) matched = true;
+        i++;
+    }
+
+    if (i >= pattern.size()) {
+        // no closing bracket, the '[' is a plain character
+        p++;
+        return c == '[';
+    }
+
+    p = i + 1;
+    return matched != negate;
+}
+
+// one segment, no '/' on either side
+bool match_segment(std::string_view pattern, std::string_view name) {
+    size_t p = 0, n = 0;
+    size_t star_p = std::string_view::npos, star_n = 0;
+
+    while (n < name.size()) {
+        if (p < pattern.size()) {
+            char pc = pattern[p];
+            if (pc == '*') {
+                star_p = ++p;
+                star_n = n;
+                continue;
+            }
+            if (pc == '?') {
+                p++;
+                n++;
+                continue;
+            }
+            if (pc == '[') {
+                size_t next = p;
+                if (match_class(pattern, next, name[n])) {
+                    p = next;
+                    n++;
+                    continue;
+                }
+            }
+            else {
+                if (pc == '\\' && p + 1 < pattern.size()) pc = pattern[++p];
+                if (pc == name[n]) {
+                    p++;
+                    n++;
+                    continue;
+                }
+            }
+        }
+
+        // mismatch: let the last * eat one more character
+        if (star_p == std::string_view::npos) return false;
+        p = star_p;
+        n = ++star_n;
+    }
+
+    while (p < pattern.size() && pattern[p] == '*') p++;
+    return p == pattern.size();
+}
+
+bool match_segments(const std::vector<std::string_view>& pattern, size_t pi,
+                    const std::vector<std::string_view>& path, size_t si)
+{
+    while (pi < pattern.size()) {
+        if (pattern[pi] == "**") {
+            // collapse runs of ** and try every split point
+            while (pi < pattern.size() && pattern[pi] == "**") pi++;
+            if (pi == pattern.size()) return true;
+            for (size_t s = si; s < path.size(); ++s) {
+                if (match_segments(pattern, pi, path, s)) return true;
+            }
+            return false;
+        }
+
+        if (si >= path.size() || !match_segment(pattern[pi], path[si])) return false;
+        pi++;
+        si++;
+    }
+
+    return si == path.size();
+}
+
+}
+
+bool glob_match(std::string_view pattern, std::string_view path) {
+    return match_segments(split_segments(pattern), 0, split_segments(path), 0);
+}
+
+bool glob_is_literal(std::string_view pattern) {
+    return pattern.find_first_of("*?[\\") == std::string_view::npos;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string_view>
+
+// shell style match of a '/' separated path:
+// * and ? stay inside one segment, [a-z] / [!a-z] classes, ** spans any number of segments
+bool glob_match(std::string_view pattern, std::string_view path);
+
+// true when pattern has no wildcard at all
+bool glob_is_literal(std::string_view pattern);
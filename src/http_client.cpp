@@ -0,0 +1,189 @@
+#include "http_client.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+ChatClient::ChatClient(EventLoop& loop, const std::string& base_url, const std::string& api_key,
+                       HttpCompression compression)
+    : loop(loop), base_url(base_url), authorization("Bearer " + api_key), compression(compression)
+{
+    if (compression.responses) accept_encoding = accepted_encodings();
+    set_headers(false);
+
+    // h2 over https when curl supports it, plain 1.1 otherwise
+    session.SetHttpVersion(cpr::HttpVersion{ cpr::HttpVersionCode::VERSION_2_0_TLS });
+    session.SetConnectTimeout(cpr::ConnectTimeout{ std::chrono::seconds(10) });
+
+    // things cpr has no wrapper for go straight to the curl handle
+    CURL* handle = session.GetCurlHolder()->handle;
+    curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(handle, CURLOPT_TCP_KEEPIDLE, 30L);
+    curl_easy_setopt(handle, CURLOPT_TCP_KEEPINTVL, 15L);
+    curl_easy_setopt(handle, CURLOPT_DNS_CACHE_TIMEOUT, 600L);
+}
+
+Task<void> ChatClient::prewarm() {
+    // status does not matter, we only want the connection in curl's cache
+    session.SetUrl(cpr::Url{ base_url + "/models" });
+    session.PrepareHead();
+    CURLcode code = co_await loop.transfer(session.GetCurlHolder()->handle);
+    session.Complete(code);
+}
+
+void ChatClient::set_headers(bool encoded) {
+    if (encoded == headers_encoded) return;
+    cpr::Header headers{
+        {"Authorization", authorization},
+        {"Content-Type", "application/json"}
+    };
+    if (encoded) headers["Content-Encoding"] = encoding_name(compression.requests);
+    session.SetHeader(headers);
+    headers_encoded = encoded;
+}
+
+bool ChatClient::encoding_rejected(const cpr::Response& response) {
+    if (!sent_encoded || response.status_code != 415) return false;
+    std::cerr << "the endpoint does not take " << encoding_name(compression.requests)
+        << " request bodies (HTTP 415), sending them uncompressed" << std::endl;
+    compression.requests = BodyEncoding::None;
+    return true;
+}
+
+void ChatClient::install_sink() {
+    if (sink_installed) return;
+
+    session.SetWriteCallback(cpr::WriteCallback{ [this](std::string_view data, intptr_t) -> bool {
+        return sink(data);
+    } });
+    sink_installed = true;
+}
+
+Task<cpr::Response> ChatClient::perform_post(std::string_view body) {
+    // big bodies go compressed when the endpoint was said to take that
+    sent_encoded = false;
+    if (compression.requests != BodyEncoding::None && body.size() >= compression.min_bytes &&
+        compress_body(compression.requests, body, compressed, compression.level) && compressed.size() < body.size())
+    {
+        body = compressed;
+        sent_encoded = true;
+    }
+    set_headers(sent_encoded);
+
+    // what cpr::MultiPerform does: prepare, let the multi handle run it, collect
+    session.PreparePost();
+
+    // curl reads the body where the caller keeps it. cpr::Body would be one
+    // copy of a multi megabyte string, and curl's COPYPOSTFIELDS another
+    CURL* handle = session.GetCurlHolder()->handle;
+    curl_easy_setopt(handle, CURLOPT_POST, 1L);
+    curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(body.size()));
+    curl_easy_setopt(handle, CURLOPT_POSTFIELDS, body.data());
+    curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, nullptr);
+
+    // curl decodes the response before the sink sees it, null means identity only
+    curl_easy_setopt(handle, CURLOPT_ACCEPT_ENCODING, accept_encoding.empty() ? nullptr : accept_encoding.c_str());
+
+    CURLcode code = co_await loop.transfer(handle);
+    co_return session.Complete(code);
+}
+
+void ChatClient::cancel() {
+    loop.cancel(session.GetCurlHolder()->handle);
+}
+
+Task<cpr::Response> ChatClient::post(std::string_view body, std::string buffer) {
+    install_sink();
+    session.SetUrl(cpr::Url{ base_url + "/chat/completions" });
+
+    buffer.clear();
+    sink = [&buffer](std::string_view data) {
+        buffer.append(data);
+        return true;
+    };
+
+    cpr::Response response = co_await perform_post(body);
+    if (encoding_rejected(response)) {
+        buffer.clear();
+        response = co_await perform_post(body);
+    }
+    response.text = std::move(buffer);
+    sink = nullptr;
+    co_return response;
+}
+
+Task<cpr::Response> ChatClient::post_stream(std::string_view body, std::function<bool(std::string_view)> on_data) {
+    install_sink();
+    session.SetUrl(cpr::Url{ base_url + "/chat/completions" });
+
+    // enough of the body to print a useful error on a non 2xx status
+    const size_t MAX_ERROR_BODY = 64 * 1024;
+    std::string head;
+
+    // the status is known by the first body byte. only a 2xx body is the
+    // event stream, an error body (or a 415 that gets resent) stays in head
+    CURL* handle = session.GetCurlHolder()->handle;
+    sink = [&](std::string_view data) {
+        if (head.size() < MAX_ERROR_BODY) {
+            head.append(data.substr(0, MAX_ERROR_BODY - head.size()));
+        }
+        long status = 0;
+        curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &status);
+        if (status < 200 || status >= 300) return true;
+        return on_data(data);
+    };
+
+    cpr::Response response = co_await perform_post(body);
+    if (encoding_rejected(response)) {
+        // the 415 body never reached on_data, the resend starts a clean stream
+        head.clear();
+        response = co_await perform_post(body);
+    }
+    response.text = std::move(head);
+    sink = nullptr;
+    co_return response;
+}
+
+ChatClientPool::ChatClientPool(EventLoop& loop, const std::string& base_url, const std::string& api_key, size_t size,
+                               HttpCompression compression)
+    : loop(loop)
+{
+    if (size == 0) size = 1;
+
+    clients.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+        clients.push_back(std::make_unique<ChatClient>(loop, base_url, api_key, compression));
+        idle.push_back(clients.back().get());
+    }
+}
+
+ChatClientPool::ChatClientPool(EventLoop& loop, std::vector<std::unique_ptr<ChatTransport>> transports)
+    : loop(loop), clients(std::move(transports))
+{
+    if (clients.empty()) throw std::runtime_error("ChatClientPool needs at least one transport");
+    for (auto& client : clients) idle.push_back(client.get());
+}
+
+Task<void> ChatClientPool::prewarm_one(ChatClientPool& pool) {
+    auto client = co_await pool.acquire();
+    co_await client->prewarm();
+}
+
+void ChatClientPool::prewarm() {
+    for (size_t i = 0; i < clients.size(); ++i) {
+        loop.spawn(prewarm_one(*this));
+    }
+}
+
+void ChatClientPool::release(ChatTransport* client) {
+    if (waiters.empty()) {
+        idle.push_back(client);
+        return;
+    }
+
+    // hand it straight to the oldest waiter
+    Waiter waiter = waiters.front();
+    waiters.pop_front();
+    *waiter.slot = client;
+    loop.resume_later(waiter.handle);
+}
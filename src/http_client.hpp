@@ -0,0 +1,154 @@
+#pragma once
+
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cpr/cpr.h>
+
+#include "compression.hpp"
+#include "event_loop.hpp"
+#include "task.hpp"
+
+// what a conversation sends its completion requests through.
+// ChatClient is the real endpoint, an embedder (or a test) can hand the pool
+// anything that answers the same way. only used from the loop thread
+class ChatTransport {
+public:
+    virtual ~ChatTransport() = default;
+
+    // done before the first request, default: nothing to warm up
+    virtual Task<void> prewarm() { co_return; }
+
+    // body is sent from where it is and has to stay alive until the task is
+    // done. the response text is read into buffer, so its capacity gets reused
+    virtual Task<cpr::Response> post(std::string_view body, std::string buffer = {}) = 0;
+
+    // streaming variant, body bytes of a 2xx response are handed to on_data as
+    // they arrive (return false to abort). response.text only keeps the start of the body
+    virtual Task<cpr::Response> post_stream(std::string_view body, std::function<bool(std::string_view)> on_data) = 0;
+
+    // aborts the request in flight, if any. its post() resumes with an error
+    virtual void cancel() {}
+};
+
+// how bodies travel. decoding responses costs nothing but cpu, a compressed
+// request body needs an endpoint that takes Content-Encoding (openrouter
+// does not, self hosted gateways often do)
+struct HttpCompression {
+    bool responses = true;                        // Accept-Encoding with what curl can decode
+    BodyEncoding requests = BodyEncoding::None;   // Content-Encoding of request bodies
+    int level = 0;                                // 0 = the encoder's fast default
+    size_t min_bytes = 8 * 1024;                  // smaller bodies are not worth it
+};
+
+// long lived client for the chat completions endpoint
+// one cpr::Session == one curl handle, driven by the event loop's multi
+// handle, so the TCP/TLS connection and the DNS entry survive between turns
+// (and between clients) instead of being rebuilt on every Post
+class ChatClient : public ChatTransport {
+public:
+    ChatClient(EventLoop& loop, const std::string& base_url, const std::string& api_key,
+               HttpCompression compression = {});
+
+    // a cheap HEAD so the handshake is done by the time the first real request goes out
+    Task<void> prewarm() override;
+
+    Task<cpr::Response> post(std::string_view body, std::string buffer = {}) override;
+    Task<cpr::Response> post_stream(std::string_view body, std::function<bool(std::string_view)> on_data) override;
+    void cancel() override;
+
+private:
+    void install_sink();
+    void set_headers(bool encoded);
+    Task<cpr::Response> perform_post(std::string_view body);
+    // a 415 to a compressed body turns request compression off for good
+    bool encoding_rejected(const cpr::Response& response);
+
+    EventLoop& loop;
+    cpr::Session session;
+    std::string base_url;
+    std::string authorization;
+
+    HttpCompression compression;
+    std::string accept_encoding;
+    std::string compressed;   // the last encoded body, keeps its capacity
+    bool sent_encoded = false;
+    bool headers_encoded = true; // forces the first set_headers
+
+    // every response goes through the sink, into the caller's buffer
+    std::function<bool(std::string_view)> sink;
+    bool sink_installed = false;
+};
+
+// a fixed set of warm clients shared by concurrent conversations.
+// a transport runs one transfer at a time, so requests lease one.
+// only touched from the loop thread
+class ChatClientPool {
+public:
+    ChatClientPool(EventLoop& loop, const std::string& base_url, const std::string& api_key, size_t size,
+                   HttpCompression compression = {});
+    // any other transports, one lease each
+    ChatClientPool(EventLoop& loop, std::vector<std::unique_ptr<ChatTransport>> transports);
+
+    // leases every client for a HEAD once the loop runs, requests made
+    // meanwhile wait for it. only worth it when the pool idles first
+    void prewarm();
+
+    class Lease {
+    public:
+        Lease(ChatClientPool& pool, ChatTransport* client) : pool(&pool), client(client) {}
+        Lease(Lease&& other) noexcept : pool(other.pool), client(other.client) { other.client = nullptr; }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease() { if (client) pool->release(client); }
+
+        ChatTransport* operator->() { return client; }
+        ChatTransport& operator*() { return *client; }
+
+    private:
+        ChatClientPool* pool;
+        ChatTransport* client;
+    };
+
+    // yields until a client is free
+    auto acquire() {
+        struct Awaiter {
+            ChatClientPool& pool;
+            ChatTransport* client = nullptr;
+
+            bool await_ready() {
+                if (pool.idle.empty()) return false;
+                // most recently used first, its connection is the least likely to have gone stale
+                client = pool.idle.back();
+                pool.idle.pop_back();
+                return true;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) { pool.waiters.push_back({ handle, &client }); }
+
+            Lease await_resume() { return Lease(pool, client); }
+        };
+        return Awaiter{ *this };
+    }
+
+    size_t size() const { return clients.size(); }
+
+private:
+    struct Waiter {
+        std::coroutine_handle<> handle;
+        ChatTransport** slot;
+    };
+
+    static Task<void> prewarm_one(ChatClientPool& pool);
+    void release(ChatTransport* client);
+
+    EventLoop& loop;
+    std::vector<std::unique_ptr<ChatTransport>> clients;
+    std::vector<ChatTransport*> idle;
+    std::deque<Waiter> waiters;
+};
@@ -1,21 +1,35 @@
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <cstdio>
 #include <iostream>
 #include <fstream>
+#include <functional>
 #include <sstream>
 #include <string>
 #include <unordered_map>
 #include <array>
+#include <thread>
+#include <vector>
 
 #include <cpr/cpr.h>
 #include <nlohmann/json.hpp>
 
-using json = nlohmann::json;
-
-#ifdef _WIN32
-#define popen _popen
-#define pclose _pclose
-#endif
+#include "agent.hpp"
+#include "bash_tool.hpp"
+#include "batch.hpp"
+#include "command_tool.hpp"
+#include "edit_tools.hpp"
+#include "event_loop.hpp"
+#include "file_tools.hpp"
+#include "http_client.hpp"
+#include "sandbox.hpp"
+#include "search_tools.hpp"
+#include "server.hpp"
+#include "shell_tool.hpp"
+#include "tool.hpp"
+#include "tool_executor.hpp"
+#include "trace.hpp"
 
 
 //startup config
@@ -23,195 +37,203 @@ struct RuntimeConfig {
     std::string prompt;
     std::string api_key;
     std::string base_url;
+    bool prewarm = true;
+    bool stream = false;
+    size_t tool_threads = 0; // 0 = pick from hardware_concurrency
+    bool verbose = false;
+    size_t context_tokens = ContextWindow::DEFAULT_BUDGET;
+    bool prompt_cache = false;
+    bool timings = false;
+    std::string trace_file;
+    std::string batch_file; // run every line of this file instead of a single prompt
+    std::string serve_address; // take jobs on this socket instead, see server.hpp
+    std::string serve_token;   // what tcp clients of the server have to present
+    bool serve_remote = false; // tcp on a non loopback address
+    size_t concurrency = 4;
+    int max_iterations = 10;
+    int max_retries = 4;
+    double requests_per_minute = 0; // 0 = only what the provider's headers say
+    bool search_index = false; // grep keeps a trigram index of the checkout across runs
+    std::vector<std::string> tool_plugins; // manifests of extra command tools
+    size_t result_tokens = ResultCompression{}.max_tokens; // per tool result, 0 = results go in as they are
+    std::string model;      // empty = AgentOptions default
+    std::string fast_model; // tool turns, see AgentOptions
+    bool race = false;
+    std::string checkpoint; // message log of the conversation
+    bool resume = false;    // continue the conversation in checkpoint
+    bool fsync = false;     // file tools wait for their writes to reach the disk
+    SandboxOptions sandbox; // limits of every conversation's commands, --sandbox spec
+    HttpCompression compression;
 };
 
 RuntimeConfig load_config(int argc, char* argv[]) {
     // api calling section
 
-    if (argc < 3 || std::string(argv[1]) != "-p") {
-        throw std::runtime_error("Expected first argument to be '-p'");
+    const std::string mode = argc > 1 ? argv[1] : "";
+    if (argc < 3 || (mode != "-p" && mode != "--batch" && mode != "--resume" && mode != "--serve")) {
+        throw std::runtime_error("Expected first argument to be '-p', '--batch', '--resume' or '--serve'");
     }
 
-    std::string prompt = argv[2];
-
-    if (prompt.empty()) {
-        throw std::runtime_error("Prompt must not be empty");
+    RuntimeConfig config;
+    if (mode == "-p") {
+        config.prompt = argv[2];
     }
-
-    const char* api_key_env = std::getenv("OPENROUTER_API_KEY");
-    const char* base_url_env = std::getenv("OPENROUTER_BASE_URL");
-
-    std::string api_key = api_key_env ? api_key_env : "";
-    std::string base_url = base_url_env ? base_url_env : "https://openrouter.ai/api/v1";
-
-    if (api_key.empty()) {
-        throw std::runtime_error("OPENROUTER_API_KEY is not set");
+    else if (mode == "--batch") {
+        config.batch_file = argv[2];
+    }
+    else if (mode == "--serve") {
+        config.serve_address = argv[2];
+    }
+    else {
+        config.checkpoint = argv[2];
+        config.resume = true;
     }
 
-    return RuntimeConfig{
-        prompt,
-        api_key,
-        base_url
-    };
-}
+    bool timings = false;
 
-//tool interface
-class Tool {
-public:
-    virtual std::string execute(const json& args) = 0;
-    virtual ~Tool() = default;
-};
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
 
-// read-Tool
-class ReadFileTool : public Tool {
-public:
-    std::string execute(const json& args) override {
-        if (!args.contains("path") || !args["path"].is_string()) {
-            return "ERROR : invalid argumnets.";
+        if (arg == "--no-prewarm") {
+            config.prewarm = false;
         }
-
-        std::string path = args["path"];
-
-        //basic path traversal protection
-        if (path.find("..") != std::string::npos) {
-            return "ERROR : path traversal detected.";
+        else if (arg == "--stream") {
+            config.stream = true;
         }
-
-        std::ifstream file(path, std::ios::binary);
-        if (!file.is_open()) {
-            return "ERROR : could not open file.";
+        else if (arg == "--tool-threads" && i + 1 < argc) {
+            config.tool_threads = std::stoul(argv[++i]);
         }
-        
-        file.seekg(0, std::ios::end);
-        std::streamsize size = file.tellg();
-        if (size < 0) {
-            return "ERROR: could not determine file size.";
+        else if (arg == "--context-tokens" && i + 1 < argc) {
+            config.context_tokens = std::stoul(argv[++i]);
         }
-        file.seekg(0, std::ios::beg);
-
-        const std::streamsize MAX_SIZE = 1'000'000;
-
-        if (size > MAX_SIZE) {
-            return "ERROR: File too Large";
+        else if (arg == "--prompt-cache") {
+            config.prompt_cache = true;
         }
-
-        std::string content(size, '\0');
-        if (!file.read(&content[0], size)) {
-            return "ERROR: file read failed.";
+        else if (arg == "--timings") {
+            timings = true;
         }
-
-        return content;
-    }
-};
-
-// Write-TOOL
-class WriteFileTool : public Tool {
-public:
-    std::string execute(const json& args) override {
-
-        if (!args.contains("path") || !args["path"].is_string() ||
-            !args.contains("content") || !args["content"].is_string())
-        {
-            return "ERROR: invalid arguments";
+        else if (arg == "--trace" && i + 1 < argc) {
+            config.trace_file = argv[++i];
         }
-
-        std::string path = args["path"];
-        std::string content = args["content"];
-
-        if (path.empty() ||
-            path.find("..") != std::string::npos ||
-            path[0] == '/' ||
-            path.find(":") != std::string::npos) 
-        {
-            return "ERROR: invalid arguments ";
+        else if (arg == "--concurrency" && i + 1 < argc) {
+            config.concurrency = std::stoul(argv[++i]);
         }
-
-        const size_t MAX_SIZE = 1'000'000; 
-        if (content.size() > MAX_SIZE) {
-            return "ERROR: content too large.";
+        else if (arg == "--max-iter" && i + 1 < argc) {
+            config.max_iterations = std::stoi(argv[++i]);
         }
-
-        std::ofstream file(path, std::ios::binary | std::ios::trunc);
-
-        if (!file.is_open()) {
-            return "ERROR: could not open file for writing.";
+        else if (arg == "--max-retries" && i + 1 < argc) {
+            config.max_retries = std::stoi(argv[++i]);
         }
-
-        if (!file.write(content.data(), content.size())) {
-            return "ERROR: write failed.";
+        else if (arg == "--rpm" && i + 1 < argc) {
+            config.requests_per_minute = std::stod(argv[++i]);
         }
-
-        return "SUCESS: file written.";
-    }
-};
-
-class BashTool : public Tool {
-public:
-
-    std::string execute(const json& args) override {
-
-        if (!args.contains("command") || !args["command"].is_string()) {
-            return "ERROR: inveild arguments.";
+        else if (arg == "--result-tokens" && i + 1 < argc) {
+            config.result_tokens = std::stoul(argv[++i]);
         }
-
-        std::string command = args["command"];
-
-        if (command.empty()) {
-            return "ERROR: empty command";
+        else if (arg == "--model" && i + 1 < argc) {
+            config.model = argv[++i];
         }
-
-        if (command.find("sudo") != std::string::npos ||
-            command.find("rm -rf /") != std::string::npos) {
-            return "ERROR: command not allowed.";
+        else if (arg == "--fast-model" && i + 1 < argc) {
+            config.fast_model = argv[++i];
         }
-
-        const size_t MAX_OUTPUT = 1'000'000;
-
-        FILE* pipe = popen(command.c_str(), "r");
-        if (!pipe) {
-            return "ERROR: failed to execute command.";
+        else if (arg == "--race") {
+            config.race = true;
         }
-
-        std::string result;
-        char buffer[4096];
-
-        while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-            result += buffer;
-
-            if (result.size() > MAX_OUTPUT) {
-                pclose(pipe);
-                return "ERROR: output too large.";
+        else if (arg == "--checkpoint" && i + 1 < argc) {
+            config.checkpoint = argv[++i];
+        }
+        else if (arg == "--tool-plugin" && i + 1 < argc) {
+            config.tool_plugins.push_back(argv[++i]);
+        }
+        else if (arg == "--search-index") {
+            config.search_index = true;
+        }
+        else if (arg == "--sandbox" && i + 1 < argc) {
+            std::string error;
+            if (!parse_sandbox_spec(argv[++i], config.sandbox, error)) {
+                throw std::runtime_error("--sandbox: " + error);
             }
         }
+        else if (arg == "--sandbox-cgroup" && i + 1 < argc) {
+            config.sandbox.cgroup_root = argv[++i];
+        }
+        else if (arg == "--compress-requests" && i + 1 < argc) {
+            // gzip or zstd, optionally :LEVEL
+            std::string spec = argv[++i];
+            size_t colon = spec.find(':');
+            if (colon != std::string::npos) {
+                config.compression.level = std::stoi(spec.substr(colon + 1));
+                spec.resize(colon);
+            }
+            if (!parse_body_encoding(spec, config.compression.requests)) {
+                throw std::runtime_error("--compress-requests: unknown encoding " + spec);
+            }
+            if (!can_compress(config.compression.requests)) {
+                throw std::runtime_error("--compress-requests: this build has no " + spec + " encoder");
+            }
+        }
+        else if (arg == "--no-accept-encoding") {
+            config.compression.responses = false;
+        }
+        else if (arg == "--serve-remote") {
+            config.serve_remote = true;
+        }
+        else if (arg == "--fsync") {
+            config.fsync = true;
+        }
+        else if (arg == "--verbose") {
+            config.verbose = true;
+        }
+        else {
+            throw std::runtime_error("Unknown argument: " + arg);
+        }
+    }
 
-        int exit_code = pclose(pipe);
+    if (config.batch_file.empty() && config.serve_address.empty() && config.prompt.empty() && !config.resume) {
+        throw std::runtime_error("Prompt must not be empty");
+    }
 
-        std::ostringstream response;
-        response << "EXIT_CODE: " << exit_code << "\n";
-        response << "OUTPUT:\n" << result;
+    if (config.race && (config.fast_model.empty() || config.stream)) {
+        throw std::runtime_error("--race needs --fast-model and does not work with --stream");
+    }
 
-        return response.str();
+    if ((!config.batch_file.empty() || !config.serve_address.empty()) && !config.checkpoint.empty()) {
+        throw std::runtime_error("--checkpoint works for a single conversation, not with --batch or --serve");
+    }
 
+    if (config.concurrency == 0) {
+        throw std::runtime_error("--concurrency must be at least 1");
     }
 
-};
+    if (config.max_iterations <= 0) {
+        throw std::runtime_error("--max-iter must be at least 1");
+    }
 
-// Tool-Registry
-class ToolRegistry {
-public:
-    void register_tool(const std::string& name, Tool* tool) {
-        tools[name] = tool;
+    if (config.max_retries < 0 || config.requests_per_minute < 0) {
+        throw std::runtime_error("--max-retries and --rpm must not be negative");
     }
 
-    Tool* get(const std::string& name) {
-        if (tools.count(name)) return tools[name];
-        return nullptr;
+    const char* api_key_env = std::getenv("OPENROUTER_API_KEY");
+    const char* base_url_env = std::getenv("OPENROUTER_BASE_URL");
+
+    config.api_key = api_key_env ? api_key_env : "";
+    config.base_url = base_url_env ? base_url_env : "https://openrouter.ai/api/v1";
+
+    if (config.api_key.empty()) {
+        throw std::runtime_error("OPENROUTER_API_KEY is not set");
     }
 
-private:
-    std::unordered_map<std::string, Tool*> tools;
-};
+    // from the environment, so it does not show up in ps
+    const char* serve_token_env = std::getenv("CLAUDE_CODE_SERVE_TOKEN");
+    config.serve_token = serve_token_env ? serve_token_env : "";
 
+    if (!config.serve_address.empty() && !is_unix_address(config.serve_address) && config.serve_token.empty()) {
+        throw std::runtime_error("--serve on tcp needs a shared token in CLAUDE_CODE_SERVE_TOKEN");
+    }
+
+    config.timings = timings || config.verbose;
+    return config;
+}
 
 // MAIN
 
@@ -227,204 +249,168 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    std::string prompt = config.prompt;
-    std::string api_key = config.api_key;
-    std::string base_url = config.base_url;
-
+    const bool batch_mode = !config.batch_file.empty();
+    const bool serve_mode = !config.serve_address.empty();
 
-    // Tool setup
+    // every conversation, http transfer and tool wait runs on this one thread
+    EventLoop loop;
 
-    ToolRegistry registry;
-    ReadFileTool readTool;
-    WriteFileTool writeTool;
-    BashTool bashTool;
-    registry.register_tool("read_file", &readTool);
-    registry.register_tool("write_file", &writeTool);
-    registry.register_tool("bash", &bashTool);
-
-    json tools = json::array({
-        {
-            {"type", "function"},
-            {"function", {
-                {"name", "read_file"},
-                {"description", "Read and return the contents of a file"},
-                {"parameters", {
-                    {"type", "object"},
-                    {"properties", {
-                        {"path",{
-                            {"type", "string"},
-                            {"description", "The path to the file to read"}
-                        }}
-                    }},
-                    {"required", json::array({"path"})}
-                }}
-            }}
-        },
-        {
-            {"type", "function"},
-            {"function", {
-                {"name", "write_file"},
-                {"description", "Write content to a file (overwrites if exists)"},
-                {"parameters", {
-                    {"type", "object"},
-                    {"properties", {
-                        {"path",{
-                            {"type", "string"},
-                            {"description", "The path to the file to read"}
-                        }},
-                        {"content", {
-                            {"type", "string"},
-                            {"description", "content to write into file"}
-                        }}
-                    }},
-                    {"required", json::array({"path", "content"})}
-                }}
-            }}
-        },
-        {
-            {"type", "function"},
-            {"function", {
-                {"name", "bash"},
-                {"description", "Execute a shell command and return stdout and exit code"},
-                {"parameters", {
-                    {"type", "object"},
-                    {"properties", {
-                        {"command",{
-                            {"type", "string"},
-                            {"description", "Shell command to execute"}
-                        }}
-                    }},
-                    {"required", json::array({"command"})}
-                }}
-            }}
-        }
-    });
+    // warm connections for the whole run.
+    // a single conversation only ever needs one, two when it races models
+    size_t conversations = batch_mode || serve_mode ? config.concurrency : 1;
+    ChatClientPool clients(loop, config.base_url, config.api_key, conversations * (config.race ? 2 : 1),
+                           config.compression);
 
-    // conversion state
-    json messages = json::array({
-        {{"role", "user"}, {"content", prompt}}
-    });
+    // the HEAD leases the client the first request needs, and nothing runs on
+    // the loop before block_on. only a server sits idle long enough for it,
+    // a -p or --batch run would just queue its first requests behind it
+    if (config.prewarm && serve_mode) {
+        clients.prewarm();
+    }
 
-    // TOOL LOOP
-    
-    int iterations = 0; 
-    const int MAX_ITER = 10;
-    while (iterations++ < MAX_ITER) {
-
-        json request_body = {
-            {"model", "anthropic/claude-haiku-4.5"},
-            {"messages", messages},
-            {"tools", tools },
-            {"tool_choice", "auto"}
-        };
-
-
-        //  giving request to models 
-
-        /*This code snippet uses the cpr (C++ Requests) library to send an HTTP POST
-        request to an OpenAI-compatible API endpoint (like DeepSeek or OpenAI)
-        to generate text. It sets necessary authentication (Bearer token)
-        and content type headers, passing a JSON-dumped request body,
-        and stores the resulting API response.
-        */
-
-        cpr::Response response = cpr::Post(
-            cpr::Url{ base_url + "/chat/completions" },
-            cpr::Header{
-                {"Authorization", "Bearer " + api_key},
-                {"Content-Type", "application/json"}
-            },
-            cpr::Body{ request_body.dump() }  // gets json dump
-        );
-
-        // connection check
-
-        if (response.error) {
-            std::cerr << "HTTP error: " << response.error.message << std::endl;
-            return 1;
-        }
 
-        if (response.status_code < 200 || response.status_code >= 300) {
-            std::cerr << "HTTP error: " << response.status_code << "\n"
-                << response.text << std::endl;
-            return 1;
-        }
+    // Tool setup
 
-        // converting string of JSON data into native data type to make the work easy on them like usaul cpp objects
-        json result;
-        try{
-            result = json::parse(response.text);
-        }
-        catch (...) {
-            std::cerr << "Invalid JSON response \n";
-            return 1;
+    ToolRegistry registry;
+    registry.emplace<ReadFileTool>();
+    registry.emplace<WriteFileTool>(config.fsync);
+    registry.emplace<EditFileTool>(config.fsync);
+    registry.emplace<ApplyPatchTool>(config.fsync);
+    registry.emplace<BashTool>();
+    registry.emplace<ShellTool>();
+    registry.emplace<GrepTool>(config.search_index);
+    registry.emplace<GlobTool>();
+    registry.emplace<ListDirTool>();
+
+    // command output is squeezed before it joins the history. file contents
+    // stay exact, read_file pages big files itself
+    ResultCompression compression;
+    compression.max_tokens = config.result_tokens;
+    compression.enabled = config.result_tokens > 0;
+    registry.set_default_compression(compression);
+    registry.set_compression(ReadFileTool::SPEC.name, ResultCompression::none());
+
+    // plugins come last, one of them may replace a built in tool of the same name
+    try {
+        for (const auto& manifest : config.tool_plugins) {
+            registry.register_tool(load_command_tool(manifest));
         }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
 
-        if (!result.contains("choices")||
-            !result["choices"].is_array() ||
-            result["choices"].empty() ||
-            !result["choices"][0].contains("message")) {
-
-            std::cerr << "No choices in response" << std::endl;
-            return 1;
+    // blocking tools wait on disk, so more threads than cores is fine
+    size_t tool_threads = config.tool_threads;
+    if (tool_threads == 0) {
+        tool_threads = std::max<size_t>(4, std::thread::hardware_concurrency());
+    }
+    ToolExecutor executor(loop, registry, tool_threads);
+
+    // where the time goes, reported however the run ends
+    Trace trace;
+    struct TraceReport {
+        const RuntimeConfig& config;
+        Trace& trace;
+        ~TraceReport() {
+            if (config.timings) trace.print_summary(std::cerr);
+            if (!config.trace_file.empty() && !trace.write_jsonl(config.trace_file)) {
+                std::cerr << "could not write trace to " << config.trace_file << std::endl;
+            }
         }
+    } trace_report{ config, trace };
+
+    // one bucket for the whole process, a batch backs off as a whole
+    RetryPolicy retry;
+    retry.max_retries = config.max_retries;
+    RequestScheduler scheduler(loop, retry, config.requests_per_minute);
+
+    // spans pile up for as long as the process runs, only keep them when they get reported
+    bool tracing = config.timings || !config.trace_file.empty();
+    AgentEnv env{ clients, executor, scheduler, tracing ? &trace : nullptr };
+
+    AgentOptions options;
+    if (!config.model.empty()) options.model = config.model;
+    options.fast_model = config.fast_model;
+    options.race = config.race;
+    options.max_iterations = config.max_iterations;
+    options.sandbox = config.sandbox;
+    options.context_tokens = config.context_tokens;
+    options.stream = config.stream;
+    options.prompt_cache = config.prompt_cache;
+    options.verbose = config.verbose;
+    options.checkpoint = config.checkpoint;
+    options.resume = config.resume;
+
+    if (serve_mode) {
+        // one warm process for many jobs: the client pool, tool threads and
+        // registry (and with it grep's index) outlive every conversation
+        ServeOptions serve;
+        serve.address = config.serve_address;
+        serve.workers = config.concurrency;
+        serve.token = config.serve_token;
+        serve.allow_remote = config.serve_remote;
+        return run_server(env, options, serve);
+    }
 
-        json message = result["choices"][0]["message"];
+    if (batch_mode) {
+        // streamed text would interleave between tasks, results only come out whole
+        BatchOptions batch;
+        batch.input = config.batch_file;
+        batch.concurrency = config.concurrency;
+        int failed = run_batch(env, options, batch);
+        return failed == 0 ? 0 : 1;
+    }
 
-        // append  assistant message
-        if (!message.contains("role")) {
-            message["role"] = "assistant";
-        }
+    AgentSession session(env, options);
+    if (config.stream) {
+        session.on_content = [](std::string_view piece) { std::cout << piece << std::flush; };
+    }
 
-        messages.push_back(message);
+    AgentResult result;
+    if (session.start(config.prompt)) {
+        result = loop.block_on(session.run());
+    }
+    else {
+        result = session.result();
+    }
 
-        const size_t MAX_MESSAGES = 30;
-        if (messages.size() > MAX_MESSAGES) {
-            messages.erase(messages.begin() + 1);
+    // everything up to the failure is in the log, only the rest needs paying for again
+    auto resume_hint = [&]() {
+        if (!config.checkpoint.empty()) {
+            std::cerr << "conversation saved, continue with --resume " << config.checkpoint << std::endl;
         }
+    };
 
-        //check for the tool calls
-        if (message.contains("tool_calls")) {
-            for (auto& call : message["tool_calls"]) {
-                std::string tool_id = call["id"];
-                std::string name = call["function"]["name"];
-                std::string args_str = call["function"]["arguments"];
-
-                json args;
-                try {
-                    args = json::parse(args_str);
-                }
-                catch (...) {
-                    args = json::object();
-                }
-
-                Tool* tool = registry.get(name);
-                std::string tool_result = "ERROR: TOOL NOT FOUND";
-
-                if (tool) {
-                    tool_result = tool->execute(args);
-                }
-
-                //append tool result
-                messages.push_back({
-                    {"role", "tool"},
-                    {"tool_call_id", tool_id},
-                    {"content", tool_result}
-                });
-            }
+    if (result.status == AgentResult::Status::Error) {
+        std::cerr << result.error << std::endl;
+        // nothing ran when the start failed
+        if (result.iterations > 0) resume_hint();
+        return 1;
+    }
 
-            continue;
-        }
+    // streamed content is already on stdout
+    if (!config.stream && result.status == AgentResult::Status::Ok) {
+        std::cout << result.output << std::endl;
+    }
 
-        if (message.contains("content")) {
-            std::cout << message["content"].get<std::string>() << std::endl;
-        }
+    if (result.status == AgentResult::Status::MaxIterations) {
+        std::cerr << "Max tool iterations exceeded.\n";
+        resume_hint();
+    }
 
-        break;
+    if (config.prompt_cache && result.usage.present) {
+        std::cerr << "prompt cache: " << result.cache_hits << " hits / " << (result.iterations - result.cache_hits) << " misses, "
+            << result.usage.cached_tokens << " of " << result.usage.prompt_tokens << " prompt tokens cached, "
+            << result.usage.cache_write_tokens << " written" << std::endl;
     }
 
-    if (iterations > MAX_ITER) {
-        std::cerr << "Max tool iterations exceeded.\n";
+    if (config.timings && result.memory.turns > 0) {
+        auto kb = [](uint64_t bytes) { return std::to_string((bytes + 1023) / 1024) + " KB"; };
+        std::cerr << "memory: session peak " << kb(result.memory.session_peak) << ", biggest turn "
+            << kb(result.memory.turn_peak) << ", all turns " << kb(result.memory.turn_total) << ", history peak "
+            << kb(result.memory.history_peak) << ", buffers kept " << kb(result.memory.buffer_capacity) << std::endl;
     }
     return 0;
 }
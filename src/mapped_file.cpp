@@ -0,0 +1,97 @@
+#include "mapped_file.hpp"
+
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    reset();
+}
+
+void MappedFile::reset() {
+#ifndef _WIN32
+    if (mapped) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+#endif
+    mapped = false;
+    data_ = nullptr;
+    size_ = 0;
+    fallback.clear();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path) {
+    reset();
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        error_ = "could not open file.";
+        return false;
+    }
+
+    file.seekg(0, std::ios::end);
+    std::streamsize size = file.tellg();
+    if (size < 0) {
+        error_ = "could not determine file size.";
+        return false;
+    }
+    file.seekg(0, std::ios::beg);
+
+    fallback.resize(static_cast<size_t>(size));
+    if (size > 0 && !file.read(&fallback[0], size)) {
+        error_ = "file read failed.";
+        return false;
+    }
+
+    data_ = fallback.data();
+    size_ = fallback.size();
+    return true;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path) {
+    reset();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error_ = "could not open file.";
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        error_ = "not a regular file.";
+        return false;
+    }
+
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ == 0) {
+        close(fd);
+        data_ = "";
+        return true;
+    }
+
+    void* addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (addr == MAP_FAILED) {
+        size_ = 0;
+        error_ = "could not map file.";
+        return false;
+    }
+
+    data_ = static_cast<const char*>(addr);
+    mapped = true;
+    return true;
+}
+
+#endif
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// read only view of a whole file.
+// with mmap only the pages that are actually looked at get read from disk
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+
+    std::string_view view() const { return std::string_view(data_, size_); }
+    size_t size() const { return size_; }
+    const std::string& error() const { return error_; }
+
+private:
+    void reset();
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped = false;
+    std::string fallback; // platforms (or files) without mmap
+    std::string error_;
+};
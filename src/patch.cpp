@@ -0,0 +1,344 @@
+#include "patch.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+namespace {
+
+struct Lines {
+    std::vector<std::string> lines;
+    bool trailing_newline = true;
+    bool crlf = false;
+};
+
+Lines split(const std::string& text) {
+    Lines out;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos) {
+            out.lines.push_back(text.substr(start));
+            out.trailing_newline = false;
+            break;
+        }
+        out.lines.push_back(text.substr(start, end - start));
+        start = end + 1;
+    }
+    out.crlf = !out.lines.empty() && out.lines[0].ends_with('\r');
+    return out;
+}
+
+std::string join(const Lines& in) {
+    size_t size = 0;
+    for (const auto& line : in.lines) size += line.size() + 1;
+
+    std::string out;
+    out.reserve(size);
+    for (size_t i = 0; i < in.lines.size(); ++i) {
+        out += in.lines[i];
+        if (i + 1 < in.lines.size() || in.trailing_newline) out += '\n';
+    }
+    return out;
+}
+
+std::string_view rtrim(std::string_view text) {
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r')) text.remove_suffix(1);
+    return text;
+}
+
+bool matches_at(const std::vector<std::string>& lines, size_t pos, const std::vector<std::string_view>& block, bool loose) {
+    if (pos + block.size() > lines.size()) return false;
+    for (size_t i = 0; i < block.size(); ++i) {
+        std::string_view have = lines[pos + i];
+        if (loose ? rtrim(have) != rtrim(block[i]) : have != block[i]) return false;
+    }
+    return true;
+}
+
+// nearest position to hint at or after floor where block matches, npos when nowhere
+size_t find_block(const std::vector<std::string>& lines, size_t floor, size_t hint, const std::vector<std::string_view>& block) {
+    if (block.size() > lines.size()) return std::string::npos;
+    const size_t last = lines.size() - block.size();
+    if (floor > last) return std::string::npos;
+    hint = std::clamp(hint, floor, last);
+
+    for (bool loose : { false, true }) {
+        for (size_t distance = 0; hint + distance <= last || hint >= floor + distance; ++distance) {
+            if (hint + distance <= last && matches_at(lines, hint + distance, block, loose)) return hint + distance;
+            if (distance > 0 && hint >= floor + distance && matches_at(lines, hint - distance, block, loose)) return hint - distance;
+        }
+    }
+    return std::string::npos;
+}
+
+std::string describe(const Hunk& hunk, size_t index) {
+    std::string where = "hunk " + std::to_string(index + 1);
+    if (hunk.old_start > 0) where += " (@@ -" + std::to_string(hunk.old_start) + ")";
+    return where;
+}
+
+// "a/src/x.cpp\t2024-01-01" -> "src/x.cpp", "/dev/null" -> ""
+std::string diff_path(std::string_view text) {
+    size_t tab = text.find('\t');
+    if (tab != std::string_view::npos) text = text.substr(0, tab);
+    text = rtrim(text);
+    if (text == "/dev/null") return "";
+    if (text.starts_with("a/") || text.starts_with("b/")) text.remove_prefix(2);
+    return std::string(text);
+}
+
+// -a[,b] of a hunk header, 0 when it has none
+size_t hunk_start(std::string_view header) {
+    size_t minus = header.find('-');
+    if (minus == std::string_view::npos) return 0;
+    return std::strtoul(std::string(header.substr(minus + 1, 16)).c_str(), nullptr, 10);
+}
+
+// the b and d of "@@ -a,b +c,d @@" (a missing count is 1), false for a bare "@@"
+bool hunk_counts(std::string_view header, size_t& old_count, size_t& new_count) {
+    auto count_after = [&](char sign, size_t& count) {
+        size_t at = header.find(sign, 2);
+        if (at == std::string_view::npos || at + 1 >= header.size() || !std::isdigit(static_cast<unsigned char>(header[at + 1]))) {
+            return false;
+        }
+        size_t end = header.find_first_not_of("0123456789", at + 1);
+        count = 1;
+        if (end != std::string_view::npos && header[end] == ',') {
+            count = std::strtoul(std::string(header.substr(end + 1, 16)).c_str(), nullptr, 10);
+        }
+        return true;
+    };
+    return count_after('-', old_count) && count_after('+', new_count);
+}
+
+}
+
+bool apply_edits(std::string& text, const std::vector<TextEdit>& edits, std::string& error) {
+    for (size_t i = 0; i < edits.size(); ++i) {
+        const TextEdit& edit = edits[i];
+        const std::string where = "edit " + std::to_string(i + 1);
+
+        if (edit.old_text.empty()) {
+            // only an empty file can be filled without something to anchor on
+            if (!text.empty()) {
+                error = where + ": old_string is empty";
+                return false;
+            }
+            text = edit.new_text;
+            continue;
+        }
+
+        size_t pos = text.find(edit.old_text);
+        if (pos == std::string::npos) {
+            error = where + ": old_string not found, it has to match the file exactly (whitespace and indentation included)";
+            return false;
+        }
+
+        if (!edit.replace_all) {
+            size_t count = 1;
+            for (size_t more = text.find(edit.old_text, pos + 1); more != std::string::npos; more = text.find(edit.old_text, more + 1)) {
+                count++;
+            }
+            if (count > 1) {
+                error = where + ": old_string matches " + std::to_string(count) +
+                    " times, add surrounding lines to make it unique or set replace_all";
+                return false;
+            }
+            text.replace(pos, edit.old_text.size(), edit.new_text);
+            continue;
+        }
+
+        std::string out;
+        out.reserve(text.size());
+        size_t from = 0;
+        for (; pos != std::string::npos; pos = text.find(edit.old_text, from)) {
+            out.append(text, from, pos - from);
+            out += edit.new_text;
+            from = pos + edit.old_text.size();
+        }
+        out.append(text, from);
+        text = std::move(out);
+    }
+    return true;
+}
+
+bool parse_unified_diff(std::string_view diff, std::vector<FilePatch>& files, std::string& error, bool single_file) {
+    std::vector<std::string_view> lines;
+    for (size_t start = 0; start < diff.size();) {
+        size_t end = diff.find('\n', start);
+        if (end == std::string_view::npos) end = diff.size();
+        std::string_view line = diff.substr(start, end - start);
+        if (line.ends_with('\r')) line.remove_suffix(1);
+        lines.push_back(line);
+        start = end + 1;
+    }
+
+    FilePatch* file = nullptr;
+    Hunk* hunk = nullptr;
+    size_t blank_tail = 0; // empty lines at the end of the hunk taken as blank context
+
+    // lines the header's counts still expect. a removed "-- x" followed by an
+    // added "++ y" reads "--- x" / "+++ y", only these tell it from a file header
+    bool counted = false;
+    size_t old_left = 0;
+    size_t new_left = 0;
+    auto take = [&](char kind) {
+        if (kind != '+' && old_left > 0) old_left--;
+        if (kind != '-' && new_left > 0) new_left--;
+    };
+
+    // a blank line right before the next header is more likely spacing than context
+    auto close_hunk = [&]() {
+        if (hunk) hunk->lines.resize(hunk->lines.size() - blank_tail);
+        hunk = nullptr;
+        blank_tail = 0;
+        counted = false;
+    };
+
+    for (size_t i = 0; i < lines.size(); ++i) {
+        std::string_view line = lines[i];
+
+        // inside a hunk that is still short of lines, the pair is a header only
+        // when a hunk follows it and it would not complete this one exactly
+        // (models get counts wrong, a plain diff has no "diff" line in between)
+        const bool inside = hunk && counted && (old_left > 0 || new_left > 0);
+        const bool header_pair = line.starts_with("--- ") && i + 1 < lines.size() && lines[i + 1].starts_with("+++ ") &&
+            (!inside || (i + 2 < lines.size() && lines[i + 2].starts_with("@@") && !(old_left == 1 && new_left == 1)));
+
+        if (header_pair) {
+            close_hunk();
+            files.push_back({ diff_path(line.substr(4)), diff_path(lines[i + 1].substr(4)) });
+            file = &files.back();
+            i++;
+            continue;
+        }
+
+        if (line.starts_with("@@")) {
+            close_hunk();
+            if (!file) {
+                if (!single_file) {
+                    error = "line " + std::to_string(i + 1) + ": hunk before a ---/+++ file header";
+                    return false;
+                }
+                files.push_back({ "-", "-" });
+                file = &files.back();
+            }
+            file->hunks.push_back({ hunk_start(line) });
+            hunk = &file->hunks.back();
+            counted = hunk_counts(line, old_left, new_left);
+            continue;
+        }
+
+        if (line.starts_with("diff ")) {
+            close_hunk();
+            file = nullptr;
+            continue;
+        }
+
+        if (!hunk) continue; // git metadata (index, mode lines) and other text between files
+
+        if (line.starts_with('\\')) {
+            char side = hunk->lines.empty() ? ' ' : hunk->lines.back()[0];
+            if (side != '+') hunk->old_no_newline = true;
+            if (side != '-') hunk->new_no_newline = true;
+            continue;
+        }
+
+        if (line.empty()) {
+            // editors and models drop the space of a blank context line
+            hunk->lines.emplace_back(" ");
+            blank_tail++;
+            take(' ');
+            continue;
+        }
+
+        if (line[0] == ' ' || line[0] == '-' || line[0] == '+') {
+            hunk->lines.emplace_back(line);
+            blank_tail = 0;
+            take(line[0]);
+            continue;
+        }
+
+        // anything else ends the hunk
+        close_hunk();
+    }
+    close_hunk();
+
+    files.erase(std::remove_if(files.begin(), files.end(), [](const FilePatch& patch) {
+        return patch.hunks.empty() && !patch.creates();
+    }), files.end());
+
+    if (files.empty()) {
+        error = "no hunks found, expected @@ -start,count +start,count @@ blocks";
+        return false;
+    }
+    if (single_file && files.size() > 1) {
+        error = "the patch touches " + std::to_string(files.size()) + " files, use apply_patch for that";
+        return false;
+    }
+    return true;
+}
+
+bool apply_hunks(std::string& text, const std::vector<Hunk>& hunks, std::string& error, size_t* added, size_t* removed) {
+    Lines file = split(text);
+    size_t floor = 0;  // hunks apply in order, never before the end of the previous one
+    long shift = 0;    // where the original numbering is in the edited file
+
+    for (size_t h = 0; h < hunks.size(); ++h) {
+        const Hunk& hunk = hunks[h];
+
+        std::vector<std::string_view> old_block;
+        std::vector<std::string> new_block;
+        std::vector<std::pair<size_t, size_t>> context; // new_block index, old_block index
+        for (const auto& line : hunk.lines) {
+            std::string_view body = std::string_view(line).substr(1);
+            if (line[0] == ' ') context.emplace_back(new_block.size(), old_block.size());
+            if (line[0] != '+') old_block.push_back(body);
+            if (line[0] != '-') {
+                new_block.emplace_back(body);
+                if (file.crlf && !new_block.back().ends_with('\r')) new_block.back() += '\r';
+            }
+            if (added && line[0] == '+') (*added)++;
+            if (removed && line[0] == '-') (*removed)++;
+        }
+
+        // a pure insertion goes after line old_start
+        long expected = hunk.old_start == 0 ? static_cast<long>(floor)
+            : static_cast<long>(hunk.old_start) - (old_block.empty() ? 0 : 1) + shift;
+        size_t hint = static_cast<size_t>(std::max<long>(expected, 0));
+
+        size_t pos;
+        if (old_block.empty()) {
+            pos = hunk.old_start == 0 ? file.lines.size() : std::clamp(hint, floor, file.lines.size());
+        }
+        else {
+            pos = find_block(file.lines, floor, hint, old_block);
+            if (pos == std::string::npos) {
+                error = describe(hunk, h) + " does not match, the context or removed lines (starting at \"" +
+                    std::string(old_block[0].substr(0, 80)) + "\") are not in the file";
+                return false;
+            }
+        }
+
+        // a loosely matched context line stays as the file has it
+        for (const auto& [to, from] : context) new_block[to] = file.lines[pos + from];
+
+        file.lines.erase(file.lines.begin() + pos, file.lines.begin() + pos + old_block.size());
+        file.lines.insert(file.lines.begin() + pos, new_block.begin(), new_block.end());
+
+        if (hunk.old_start > 0) {
+            shift = static_cast<long>(pos) - (static_cast<long>(hunk.old_start) - (old_block.empty() ? 0 : 1)) +
+                static_cast<long>(new_block.size()) - static_cast<long>(old_block.size());
+        }
+        floor = pos + new_block.size();
+
+        if (floor == file.lines.size()) {
+            if (hunk.new_no_newline) file.trailing_newline = false;
+            else if (hunk.old_no_newline) file.trailing_newline = true;
+        }
+    }
+
+    text = join(file);
+    return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// text level edits for edit_file / apply_patch, nothing here touches the disk
+
+// replace old_text by new_text, old_text has to be there exactly once unless replace_all
+struct TextEdit {
+    std::string old_text;
+    std::string new_text;
+    bool replace_all = false;
+};
+
+// applies edits in order, every edit sees the result of the ones before.
+// false with error naming the edit that did not apply, text is then unspecified
+bool apply_edits(std::string& text, const std::vector<TextEdit>& edits, std::string& error);
+
+// one @@ block. lines keep their ' ', '-' or '+' prefix
+struct Hunk {
+    size_t old_start = 0; // 1-based, 0 when the header had no numbers
+    std::vector<std::string> lines;
+    bool old_no_newline = false; // "\ No newline at end of file" after the old side
+    bool new_no_newline = false;
+};
+
+// one file of a unified diff
+struct FilePatch {
+    std::string old_path; // "a/" and "b/" stripped, empty for /dev/null
+    std::string new_path;
+    std::vector<Hunk> hunks;
+
+    bool creates() const { return old_path.empty(); }
+    bool deletes() const { return new_path.empty(); }
+};
+
+// a (git style or plain) unified diff over one or more files. with
+// single_file, "---"/"+++" headers are optional and bare @@ hunks are accepted
+bool parse_unified_diff(std::string_view diff, std::vector<FilePatch>& files, std::string& error, bool single_file = false);
+
+// context and removed lines are looked up near the line the header names
+// (models get those numbers wrong a lot), exact first, then ignoring
+// trailing whitespace. added and removed line counts go to the counters
+bool apply_hunks(std::string& text, const std::vector<Hunk>& hunks, std::string& error,
+                 size_t* added = nullptr, size_t* removed = nullptr);
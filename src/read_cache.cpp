@@ -0,0 +1,83 @@
+#include "read_cache.hpp"
+
+#include <filesystem>
+#include <system_error>
+
+FileStamp stamp_file(const std::string& path) {
+    std::error_code ec;
+    FileStamp stamp;
+
+    auto mtime = std::filesystem::last_write_time(path, ec);
+    if (ec) return stamp;
+    auto size = std::filesystem::file_size(path, ec);
+    if (ec) return stamp;
+
+    stamp.mtime = static_cast<long long>(mtime.time_since_epoch().count());
+    stamp.size = size;
+    stamp.valid = true;
+    return stamp;
+}
+
+uint64_t content_hash(std::string_view data) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+CacheHit FileReadCache::lookup(const std::string& key, const FileStamp& stamp) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = entries.find(key);
+    if (it == entries.end() || !(it->second.stamp == stamp)) return {};
+
+    hits_++;
+    return { it->second.call_id, it->second.written };
+}
+
+CacheHit FileReadCache::lookup_content(const std::string& key, const FileStamp& stamp, uint64_t hash) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = entries.find(key);
+    if (it == entries.end() || it->second.hash != hash) return {};
+
+    // same bytes under a new mtime, keep the old call as the reference
+    it->second.stamp = stamp;
+    hits_++;
+    return { it->second.call_id, it->second.written };
+}
+
+void FileReadCache::remember(const std::string& key, const std::string& path,
+                             const FileStamp& stamp, uint64_t hash, const std::string& call_id)
+{
+    if (call_id.empty()) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    entries[key] = Entry{ path, stamp, hash, call_id, false };
+}
+
+void FileReadCache::record_write(const std::string& path, const std::string& full_key,
+                                 const FileStamp& stamp, uint64_t hash, const std::string& call_id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it->second.path == path) it = entries.erase(it);
+        else ++it;
+    }
+
+    if (!call_id.empty()) {
+        entries[full_key] = Entry{ path, stamp, hash, call_id, true };
+    }
+}
+
+void FileReadCache::forget_call(const std::string& call_id) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it->second.call_id == call_id) it = entries.erase(it);
+        else ++it;
+    }
+}
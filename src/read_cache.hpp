@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// what a file looked like when it was read
+struct FileStamp {
+    long long mtime = 0;
+    uint64_t size = 0;
+    bool valid = false;
+
+    bool operator==(const FileStamp& other) const {
+        return valid && other.valid && mtime == other.mtime && size == other.size;
+    }
+};
+
+FileStamp stamp_file(const std::string& path);
+
+// fnv-1a, only used to tell "same bytes" apart from "different bytes"
+uint64_t content_hash(std::string_view data);
+
+// earlier call that already put this exact content into the conversation
+struct CacheHit {
+    std::string call_id;
+    bool written = false; // content came from a write_file call, not a read
+
+    explicit operator bool() const { return !call_id.empty(); }
+};
+
+// remembers which tool call last returned a given read (path + range) and
+// with which content, so an identical re-read can point back at it instead of
+// pushing another full copy into the history. one per conversation
+class FileReadCache {
+public:
+    // earlier read of key that is known to be unchanged
+    CacheHit lookup(const std::string& key, const FileStamp& stamp);
+    // same, but by content, for files that were touched without changing
+    CacheHit lookup_content(const std::string& key, const FileStamp& stamp, uint64_t hash);
+
+    void remember(const std::string& key, const std::string& path,
+                  const FileStamp& stamp, uint64_t hash, const std::string& call_id);
+
+    // write_file: drops every range of path, the written content becomes
+    // the known full read under full_key
+    void record_write(const std::string& path, const std::string& full_key,
+                      const FileStamp& stamp, uint64_t hash, const std::string& call_id);
+
+    // the result of call_id left the context window, nothing may point at it anymore
+    void forget_call(const std::string& call_id);
+
+    size_t hits() const { return hits_; }
+
+private:
+    struct Entry {
+        std::string path;
+        FileStamp stamp;
+        uint64_t hash = 0;
+        std::string call_id;
+        bool written = false;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    size_t hits_ = 0;
+};
@@ -0,0 +1,125 @@
+#include "request_builder.hpp"
+
+namespace {
+
+// rewrites {"content":"...",rest} as
+// {"content":[{"cache_control":{"type":"ephemeral"},"text":"...","type":"text"}],rest}
+// straight on the serialized text, so the marker costs a copy and not a dump.
+// dump() sorts keys, so a message with a string content always starts this way
+bool append_with_breakpoint(std::string& body, const std::string& text) {
+    static const std::string prefix = "{\"content\":\"";
+    if (!text.starts_with(prefix)) return false;
+
+    size_t end = prefix.size();
+    for (; end < text.size(); ++end) {
+        if (text[end] == '\\') { ++end; continue; }
+        if (text[end] == '"') break;
+    }
+    if (end >= text.size()) return false;
+
+    const size_t start = prefix.size() - 1; // the opening quote
+    body += "{\"content\":[{\"cache_control\":{\"type\":\"ephemeral\"},\"text\":";
+    body.append(text, start, end + 1 - start);
+    body += ",\"type\":\"text\"}]";
+    body.append(text, end + 1, std::string::npos);
+    return true;
+}
+
+}
+
+void RequestBuilder::set_param(const std::string& key, const json& value) {
+    std::string dumped = value.dump();
+    pending_reserialized += dumped.size();
+
+    for (auto& param : params) {
+        if (param.first == key) {
+            param.second = std::move(dumped);
+            return;
+        }
+    }
+    params.emplace_back(key, std::move(dumped));
+}
+
+void RequestBuilder::set_tools(const json& tools) {
+    tools_json = std::make_shared<const std::string>(tools.dump());
+    pending_reserialized += tools_json->size();
+}
+
+void RequestBuilder::pin(const json& message) {
+    pending_reserialized += history_.pin(message);
+}
+
+void RequestBuilder::set_tools_json(std::shared_ptr<const std::string> tools) {
+    tools_json = std::move(tools);
+}
+
+void RequestBuilder::append(const json& message) {
+    pending_reserialized += history_.append(message);
+}
+
+void RequestBuilder::append(json&& message) {
+    pending_reserialized += history_.append(std::move(message));
+}
+
+std::string RequestBuilder::build() {
+    std::string body;
+    build_into(body);
+    return body;
+}
+
+void RequestBuilder::build_into(std::string& body) {
+    history_.enforce();
+
+    size_t total = 2 + history_.bytes() + history_.size() + 16 + (cache_breakpoints ? 128 : 0);
+    for (const auto& param : params) {
+        total += param.first.size() + param.second.size() + 4;
+    }
+    if (tools_json && !tools_json->empty()) {
+        total += tools_json->size() + 10;
+    }
+
+    body.clear();
+    body.reserve(total);
+
+    body += '{';
+    for (const auto& param : params) {
+        // keys are our own literals, plain quoting is enough
+        body += '"';
+        body += param.first;
+        body += "\":";
+        body += param.second;
+        body += ',';
+    }
+
+    body += "\"messages\":[";
+    bool first = true;
+    auto add_message = [&](const HistoryEntry& entry, bool breakpoint) {
+        if (!first) body += ',';
+        if (!breakpoint || !append_with_breakpoint(body, entry.json_text)) {
+            body += entry.json_text;
+        }
+        first = false;
+    };
+
+    const auto& pinned = history_.pinned();
+    const auto& entries = history_.entries();
+    for (size_t i = 0; i < pinned.size(); ++i) {
+        add_message(pinned[i], cache_breakpoints && i + 1 == pinned.size());
+    }
+    // the rolling breakpoint on the newest message lets the provider reuse
+    // everything up to the previous turn; markers are not part of the cached text
+    for (size_t i = 0; i < entries.size(); ++i) {
+        add_message(entries[i], cache_breakpoints && i + 1 == entries.size());
+    }
+    body += ']';
+
+    if (tools_json && !tools_json->empty()) {
+        body += ",\"tools\":";
+        body += *tools_json;
+    }
+    body += '}';
+
+    last_reserialized = pending_reserialized;
+    pending_reserialized = 0;
+    last_body = body.size();
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "context_window.hpp"
+
+using json = nlohmann::json;
+
+// keeps the request pieces in serialized form so a turn only dumps what is new.
+// the body is glued together from the cached fragments instead of copying the
+// whole history into a fresh json object and dumping all of it again
+class RequestBuilder {
+public:
+    // top level fields ("model", "tool_choice", ...), dumped once when set
+    void set_param(const std::string& key, const json& value);
+    void set_tools(const json& tools);
+    // already serialized tools array, shared between conversations
+    void set_tools_json(std::shared_ptr<const std::string> tools);
+
+    // the original prompt, survives every eviction
+    void pin(const json& message);
+    void append(const json& message);
+    void append(json&& message);
+
+    ContextWindow& history() { return history_; }
+    const ContextWindow& history() const { return history_; }
+
+    // mark the pinned prompt (and with it the tools in front of it) and the
+    // newest message with anthropic style cache_control breakpoints
+    void set_cache_breakpoints(bool enabled) { cache_breakpoints = enabled; }
+
+    // evicts down to the token budget, then glues the body together
+    std::string build();
+    // the same into body, which keeps its capacity from the last turn
+    void build_into(std::string& body);
+
+    // what the last build() cost: bytes freshly dumped since the previous
+    // build, and the size of the body that was put together
+    size_t last_reserialized_bytes() const { return last_reserialized; }
+    size_t last_body_bytes() const { return last_body; }
+
+private:
+    std::vector<std::pair<std::string, std::string>> params; // key, dumped value
+    std::shared_ptr<const std::string> tools_json;
+    ContextWindow history_;
+    bool cache_breakpoints = false;
+
+    size_t pending_reserialized = 0;
+    size_t last_reserialized = 0;
+    size_t last_body = 0;
+};
@@ -0,0 +1,223 @@
+#include "request_scheduler.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+// a provider asking for more than this is treated as "not today"
+const std::chrono::milliseconds MAX_RETRY_AFTER = std::chrono::minutes(5);
+
+std::optional<double> parse_number(const std::string& text) {
+    if (text.empty()) return std::nullopt;
+    char* end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    if (end == text.c_str() || *end != '\0' || !std::isfinite(value)) return std::nullopt;
+    return value;
+}
+
+const std::string* header(const cpr::Response& response, const char* name) {
+    auto it = response.header.find(name);
+    return it == response.header.end() ? nullptr : &it->second;
+}
+
+std::chrono::milliseconds until_epoch_ms(double epoch_ms) {
+    auto now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    return std::chrono::milliseconds(std::max<long long>(0, static_cast<long long>(epoch_ms) - now_ms));
+}
+
+// "20ms", "1.5s", "6m0s", "1h2m" (openai style durations)
+std::optional<std::chrono::milliseconds> parse_duration(const std::string& text) {
+    double total_ms = 0;
+    size_t i = 0;
+    bool any = false;
+
+    while (i < text.size()) {
+        size_t start = i;
+        while (i < text.size() && (std::isdigit(static_cast<unsigned char>(text[i])) || text[i] == '.')) i++;
+        if (start == i) return std::nullopt;
+        double value = std::strtod(text.substr(start, i - start).c_str(), nullptr);
+
+        size_t unit_start = i;
+        while (i < text.size() && std::isalpha(static_cast<unsigned char>(text[i]))) i++;
+        std::string unit = text.substr(unit_start, i - unit_start);
+
+        if (unit == "ms") total_ms += value;
+        else if (unit == "s" || unit.empty()) total_ms += value * 1000;
+        else if (unit == "m") total_ms += value * 60'000;
+        else if (unit == "h") total_ms += value * 3'600'000;
+        else return std::nullopt;
+        any = true;
+    }
+
+    if (!any) return std::nullopt;
+    return std::chrono::milliseconds(static_cast<long long>(total_ms));
+}
+
+// rate limit reset headers come as a delay, a duration or an epoch timestamp depending on the provider
+std::optional<std::chrono::milliseconds> parse_reset(const std::string& text) {
+    if (auto number = parse_number(text)) {
+        if (*number > 1e12) return until_epoch_ms(*number);        // epoch ms (openrouter)
+        if (*number > 1e9) return until_epoch_ms(*number * 1000);  // epoch seconds
+        return std::chrono::milliseconds(static_cast<long long>(*number * 1000));
+    }
+    return parse_duration(text);
+}
+
+// "Wed, 21 Oct 2015 07:28:00 GMT"
+std::optional<std::chrono::milliseconds> parse_http_date(const std::string& text) {
+    std::tm tm{};
+    std::istringstream in(text);
+    in >> std::get_time(&tm, "%a, %d %b %Y %H:%M:%S");
+    if (in.fail()) return std::nullopt;
+
+#ifdef _WIN32
+    std::time_t when = _mkgmtime(&tm);
+#else
+    std::time_t when = timegm(&tm);
+#endif
+    if (when < 0) return std::nullopt;
+    return until_epoch_ms(static_cast<double>(when) * 1000);
+}
+
+}
+
+bool is_retryable_status(long status) {
+    switch (status) {
+    case 408: // request timeout
+    case 409: // conflict, some gateways use it for "busy"
+    case 425: // too early
+    case 429: // rate limited
+    case 500:
+    case 502:
+    case 503:
+    case 504:
+    case 529: // anthropic overloaded
+        return true;
+    default:
+        return false;
+    }
+}
+
+std::optional<std::chrono::milliseconds> parse_retry_after(const cpr::Response& response) {
+    if (const std::string* ms = header(response, "retry-after-ms")) {
+        if (auto value = parse_number(*ms)) {
+            return std::chrono::milliseconds(static_cast<long long>(std::max(0.0, *value)));
+        }
+    }
+
+    if (const std::string* after = header(response, "retry-after")) {
+        if (auto seconds = parse_number(*after)) {
+            return std::chrono::milliseconds(static_cast<long long>(std::max(0.0, *seconds) * 1000));
+        }
+        return parse_http_date(*after);
+    }
+
+    return std::nullopt;
+}
+
+RequestScheduler::RequestScheduler(EventLoop& loop, RetryPolicy policy, double requests_per_minute)
+    : loop(loop),
+      policy_(policy),
+      rate_per_second(requests_per_minute / 60.0),
+      // bursts of up to five seconds worth of requests
+      capacity(std::max(1.0, requests_per_minute / 12.0)),
+      tokens(capacity),
+      refilled_at(clock::now()),
+      paused_until(clock::now()),
+      rng(std::random_device{}())
+{
+}
+
+void RequestScheduler::refill(clock::time_point now) {
+    std::chrono::duration<double> elapsed = now - refilled_at;
+    tokens = std::min(capacity, tokens + elapsed.count() * rate_per_second);
+    refilled_at = now;
+}
+
+void RequestScheduler::pause_until(clock::time_point until) {
+    paused_until = std::max(paused_until, until);
+}
+
+Task<void> RequestScheduler::acquire() {
+    while (true) {
+        auto now = clock::now();
+
+        // the provider said stop, everybody waits
+        if (now < paused_until) {
+            co_await loop.sleep_for(std::chrono::ceil<std::chrono::milliseconds>(paused_until - now));
+            continue;
+        }
+
+        if (rate_per_second <= 0) co_return;
+
+        refill(now);
+        if (tokens >= 1) {
+            tokens -= 1;
+            co_return;
+        }
+
+        auto wait = std::chrono::duration<double>((1 - tokens) / rate_per_second);
+        co_await loop.sleep_for(std::chrono::ceil<std::chrono::milliseconds>(wait));
+    }
+}
+
+void RequestScheduler::observe(const cpr::Response& response) {
+    if (response.error) return;
+
+    auto now = clock::now();
+
+    // out of requests for this window: hold every session until it resets.
+    // openai style per-resource headers first, then the plain openrouter ones
+    const std::string* remaining = header(response, "x-ratelimit-remaining-requests");
+    const std::string* reset = header(response, "x-ratelimit-reset-requests");
+    if (!remaining) {
+        remaining = header(response, "x-ratelimit-remaining");
+        reset = header(response, "x-ratelimit-reset");
+    }
+
+    if (remaining && reset) {
+        auto left = parse_number(*remaining);
+        if (left && *left <= 0) {
+            if (auto wait = parse_reset(*reset)) {
+                pause_until(now + std::min(*wait, MAX_RETRY_AFTER));
+            }
+        }
+    }
+
+    if (response.status_code == 429 || response.status_code == 503 || response.status_code == 529) {
+        if (auto wait = parse_retry_after(response)) {
+            pause_until(now + std::min(*wait, MAX_RETRY_AFTER));
+        }
+    }
+}
+
+std::optional<std::chrono::milliseconds> RequestScheduler::retry_delay(const cpr::Response& response, int attempt, bool cut_off) {
+    if (attempt > policy_.max_retries) return std::nullopt;
+
+    // transport failures (reset connections, timeouts, dns) are worth another go,
+    // so are the statuses that mean "later"
+    bool transient = cut_off || response.error || is_retryable_status(response.status_code);
+    if (!transient) return std::nullopt;
+
+    // exponential backoff with jitter in its upper half, so sessions that
+    // failed together do not come back together
+    double backoff = static_cast<double>(policy_.base_delay.count()) * std::pow(2.0, attempt - 1);
+    backoff = std::min(backoff, static_cast<double>(policy_.max_delay.count()));
+    std::uniform_real_distribution<double> jitter(backoff / 2, backoff);
+    auto delay = std::chrono::milliseconds(static_cast<long long>(jitter(rng)));
+
+    if (!response.error) {
+        if (auto after = parse_retry_after(response)) {
+            if (*after > MAX_RETRY_AFTER) return std::nullopt;
+            delay = std::max(delay, *after);
+        }
+    }
+
+    return delay;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <random>
+#include <string>
+
+#include <cpr/cpr.h>
+
+#include "event_loop.hpp"
+#include "task.hpp"
+
+struct RetryPolicy {
+    int max_retries = 4; // on top of the first attempt
+    std::chrono::milliseconds base_delay{ 500 };
+    std::chrono::milliseconds max_delay{ 30'000 };
+};
+
+// gates every completion request of the process: a token bucket shared by
+// all conversations (so a batch stays under the provider limit as a whole),
+// pauses announced by the provider, and jittered exponential backoff
+class RequestScheduler {
+public:
+    using clock = EventLoop::clock;
+
+    // requests_per_minute 0 = no local limit, only what the provider tells us
+    RequestScheduler(EventLoop& loop, RetryPolicy policy = {}, double requests_per_minute = 0);
+
+    // yields until a request may go out
+    Task<void> acquire();
+
+    // feeds rate limit headers back into the bucket, call for every response
+    void observe(const cpr::Response& response);
+
+    // how long to wait before attempt number `attempt` (1 = first retry), or
+    // nothing when the response is final or the retries are used up.
+    // cut_off marks a 2xx whose body ended early, as transient as a reset
+    std::optional<std::chrono::milliseconds> retry_delay(const cpr::Response& response, int attempt, bool cut_off = false);
+
+    const RetryPolicy& policy() const { return policy_; }
+
+private:
+    void refill(clock::time_point now);
+    void pause_until(clock::time_point until);
+
+    EventLoop& loop;
+    RetryPolicy policy_;
+
+    double rate_per_second;
+    double capacity;
+    double tokens;
+    clock::time_point refilled_at;
+    clock::time_point paused_until;
+
+    std::mt19937 rng;
+};
+
+// true for the statuses a provider uses for "try again later"
+bool is_retryable_status(long status);
+
+// Retry-After / retry-after-ms, as a wait from now
+std::optional<std::chrono::milliseconds> parse_retry_after(const cpr::Response& response);
@@ -0,0 +1,150 @@
+#include "result_compressor.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "context_window.hpp"
+
+namespace {
+
+std::vector<std::string_view> split_lines(std::string_view text) {
+    std::vector<std::string_view> lines;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string_view::npos) end = text.size();
+        lines.push_back(text.substr(start, end - start));
+        start = end + 1;
+    }
+    return lines;
+}
+
+// the line with every run of digits squashed to one '0'
+std::string shape_of(std::string_view line) {
+    std::string shape;
+    shape.reserve(line.size());
+    for (size_t i = 0; i < line.size(); ++i) {
+        if (std::isdigit(static_cast<unsigned char>(line[i]))) {
+            shape += '0';
+            while (i + 1 < line.size() && std::isdigit(static_cast<unsigned char>(line[i + 1]))) i++;
+        }
+        else {
+            shape += line[i];
+        }
+    }
+    return shape;
+}
+
+class Emitter {
+public:
+    Emitter(const ResultCompression& policy, CompressionStats& stats, size_t reserve)
+        : policy(policy), stats(stats)
+    {
+        out.reserve(reserve);
+    }
+
+    void line(std::string_view text) {
+        lines++;
+        if (policy.dedupe_lines && text.size() >= policy.dedupe_min_line) {
+            auto [it, inserted] = seen.try_emplace(text, lines);
+            if (!inserted) {
+                stats.duplicates++;
+                append("[same as line " + std::to_string(it->second) + "]");
+                return;
+            }
+        }
+        append(text);
+    }
+
+    // markers count as lines, the numbers above point into the text the model sees
+    void marker(const std::string& text) {
+        lines++;
+        append(text);
+    }
+
+    std::string take() { return std::move(out); }
+
+private:
+    void append(std::string_view text) {
+        out.append(text);
+        out += '\n';
+    }
+
+    const ResultCompression& policy;
+    CompressionStats& stats;
+    std::string out;
+    size_t lines = 0;
+    std::unordered_map<std::string_view, size_t> seen;
+};
+
+}
+
+void compress_result(std::string& text, const ResultCompression& policy, CompressionStats* stats) {
+    CompressionStats local;
+    CompressionStats& s = stats ? *stats : local;
+    s = CompressionStats{};
+    s.bytes_before = text.size();
+    s.bytes_after = text.size();
+
+    if (!policy.enabled || text.size() < policy.min_bytes) return;
+
+    const bool trailing_newline = !text.empty() && text.back() == '\n';
+    std::vector<std::string_view> lines = split_lines(text);
+
+    std::vector<std::string> shapes;
+    if (policy.max_similar_run > 0) {
+        shapes.reserve(lines.size());
+        for (std::string_view line : lines) shapes.push_back(shape_of(line));
+    }
+
+    Emitter emit(policy, s, text.size());
+    for (size_t i = 0; i < lines.size();) {
+        size_t same = i + 1;
+        while (policy.collapse_repeats && same < lines.size() && lines[same] == lines[i]) same++;
+
+        // only worth a marker when the marker is shorter than the repeats
+        const size_t repeats = same - i - 1;
+        if (repeats > 0 && repeats * (lines[i].size() + 1) > 48) {
+            emit.line(lines[i]);
+            emit.marker("[previous line repeated " + std::to_string(repeats) + " more times]");
+            s.repeats += repeats;
+            i = same;
+            continue;
+        }
+
+        if (policy.max_similar_run > 0) {
+            size_t run = i + 1;
+            while (run < lines.size() && shapes[run] == shapes[i]) run++;
+
+            if (run - i > policy.max_similar_run) {
+                const size_t head = policy.max_similar_run / 2;
+                const size_t tail = std::max<size_t>(1, policy.max_similar_run / 4);
+                const size_t dropped = run - i - head - tail;
+
+                for (size_t k = i; k < i + head; ++k) emit.line(lines[k]);
+                emit.marker("[... " + std::to_string(dropped) + " similar lines ...]");
+                for (size_t k = run - tail; k < run; ++k) emit.line(lines[k]);
+
+                s.similar += dropped;
+                i = run;
+                continue;
+            }
+        }
+
+        emit.line(lines[i]);
+        i++;
+    }
+
+    std::string out = emit.take();
+    if (!trailing_newline && !out.empty()) out.pop_back();
+
+    if (policy.max_tokens > 0) {
+        truncate_middle(out, policy.max_tokens * 4);
+    }
+
+    text = std::move(out);
+    s.bytes_after = text.size();
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// how a tool's result is shrunk before it joins the history.
+// only outputs over min_bytes are touched, small ones reach the model as they are
+struct ResultCompression {
+    bool enabled = true;
+    size_t min_bytes = 2048;
+    // consecutive identical lines become one line and a repeat count
+    bool collapse_repeats = true;
+    // longer runs of lines that only differ in their numbers (progress output,
+    // numbered test cases, log timestamps) keep their start and end
+    size_t max_similar_run = 12;   // 0 = keep every run
+    // a long line seen before is replaced by a pointer to its first occurrence
+    bool dedupe_lines = true;
+    size_t dedupe_min_line = 48;
+    // estimated tokens the whole result may take, the middle goes beyond it. 0 = no budget
+    size_t max_tokens = 8000;
+
+    static ResultCompression none() {
+        ResultCompression off;
+        off.enabled = false;
+        return off;
+    }
+};
+
+struct CompressionStats {
+    size_t bytes_before = 0;
+    size_t bytes_after = 0;
+    size_t repeats = 0;  // lines dropped as repeats of the line before
+    size_t similar = 0;  // lines dropped from similar runs
+    size_t duplicates = 0;
+};
+
+// rewrites text in place, stats (when given) says what happened
+void compress_result(std::string& text, const ResultCompression& policy, CompressionStats* stats = nullptr);
@@ -0,0 +1,421 @@
+#include "sandbox.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace {
+
+// 512, 64K, 4M, 2G (powers of 1024)
+bool parse_size(std::string_view text, uint64_t& value) {
+    if (text.empty()) return false;
+    uint64_t scale = 1;
+    switch (text.back()) {
+        case 'k': case 'K': scale = 1ull << 10; break;
+        case 'm': case 'M': scale = 1ull << 20; break;
+        case 'g': case 'G': scale = 1ull << 30; break;
+        case 't': case 'T': scale = 1ull << 40; break;
+    }
+    if (scale != 1) text.remove_suffix(1);
+
+    std::string digits(text);
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long number = std::strtoull(digits.c_str(), &end, 10);
+    if (digits.empty() || *end != '\0' || errno != 0 || digits[0] == '-') return false;
+    value = number * scale;
+    return true;
+}
+
+uint64_t smaller(uint64_t a, uint64_t b) {
+    if (a == 0) return b;
+    if (b == 0) return a;
+    return std::min(a, b);
+}
+
+#ifndef _WIN32
+
+bool write_text(const std::string& path, std::string_view text) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    ssize_t n = ::write(fd, text.data(), text.size());
+    int saved = errno;
+    ::close(fd);
+    errno = saved;
+    return n == static_cast<ssize_t>(text.size());
+}
+
+std::string read_text(const std::string& path) {
+    std::ifstream file(path);
+    std::stringstream out;
+    out << file.rdbuf();
+    return out.str();
+}
+
+std::string errno_text(const std::string& what) {
+    return what + ": " + std::strerror(errno);
+}
+
+#endif
+
+#ifdef __linux__
+
+// where the unified hierarchy is mounted, /sys/fs/cgroup on most systems
+std::string cgroup2_mount() {
+    std::ifstream mounts("/proc/self/mountinfo");
+    for (std::string line; std::getline(mounts, line);) {
+        size_t dash = line.find(" - cgroup2 ");
+        if (dash == std::string::npos) continue;
+        std::istringstream fields(line.substr(0, dash));
+        std::string field, mount_point;
+        for (int i = 0; i < 5 && fields >> field; ++i) {
+            if (i == 4) mount_point = field;
+        }
+        if (!mount_point.empty()) return mount_point;
+    }
+    return "";
+}
+
+// "0::/user.slice/..." of /proc/self/cgroup
+std::string own_cgroup() {
+    std::ifstream groups("/proc/self/cgroup");
+    for (std::string line; std::getline(groups, line);) {
+        if (line.starts_with("0::")) return line.substr(3);
+    }
+    return "";
+}
+
+bool has_word(const std::string& list, std::string_view word) {
+    std::istringstream words(list);
+    for (std::string w; words >> w;) {
+        if (w == word) return true;
+    }
+    return false;
+}
+
+#endif
+
+}
+
+bool parse_sandbox_spec(std::string_view spec, SandboxOptions& options, std::string& error) {
+    while (!spec.empty()) {
+        size_t comma = spec.find(',');
+        std::string_view item = spec.substr(0, comma);
+        spec = comma == std::string_view::npos ? std::string_view() : spec.substr(comma + 1);
+        if (item.empty()) continue;
+
+        size_t eq = item.find('=');
+        if (eq == std::string_view::npos) {
+            error = "sandbox setting " + std::string(item) + " needs a value (key=value)";
+            return false;
+        }
+        std::string_view key = item.substr(0, eq);
+        std::string_view value = item.substr(eq + 1);
+        bool ok = true;
+
+        if (key == "cpus") {
+            std::string text(value);
+            char* end = nullptr;
+            options.cpus = std::strtod(text.c_str(), &end);
+            ok = !text.empty() && *end == '\0' && options.cpus > 0 && std::isfinite(options.cpus);
+        }
+        else if (key == "memory") ok = parse_size(value, options.memory_bytes);
+        else if (key == "pids") ok = parse_size(value, options.max_pids);
+        else if (key == "cpu-time") ok = parse_size(value, options.cpu_seconds);
+        else if (key == "file-size") ok = parse_size(value, options.file_bytes);
+        else if (key == "nofile") ok = parse_size(value, options.open_files);
+        else if (key == "net") {
+            ok = value == "on" || value == "off";
+            options.no_network = value == "off";
+        }
+        else {
+            error = "unknown sandbox setting " + std::string(key) +
+                " (cpus, memory, pids, cpu-time, file-size, nofile, net)";
+            return false;
+        }
+
+        if (!ok) {
+            error = "bad value for sandbox setting " + std::string(key) + ": " + std::string(value);
+            return false;
+        }
+    }
+    return true;
+}
+
+SandboxOptions stricter(const SandboxOptions& a, const SandboxOptions& b) {
+    SandboxOptions out = a;
+    out.cpus = a.cpus <= 0 ? b.cpus : b.cpus <= 0 ? a.cpus : std::min(a.cpus, b.cpus);
+    out.memory_bytes = smaller(a.memory_bytes, b.memory_bytes);
+    out.max_pids = smaller(a.max_pids, b.max_pids);
+    out.cpu_seconds = smaller(a.cpu_seconds, b.cpu_seconds);
+    out.file_bytes = smaller(a.file_bytes, b.file_bytes);
+    out.open_files = smaller(a.open_files, b.open_files);
+    out.no_network = a.no_network || b.no_network;
+    return out;
+}
+
+#ifdef _WIN32
+
+Sandbox::~Sandbox() {}
+
+std::string Sandbox::release() { return ""; }
+
+void remove_cgroup(const std::string&) {}
+
+bool Sandbox::open(const SandboxOptions& options, std::string& error) {
+    if (!options.enabled()) return true;
+    error = "sandbox limits are not supported on windows";
+    return false;
+}
+
+int Sandbox::spawn(const char*, char* const[], int, int, int, int&) const {
+    return ENOSYS;
+}
+
+#else
+
+Sandbox::~Sandbox() {
+    std::string left = release();
+    if (!left.empty()) remove_cgroup(left);
+}
+
+std::string Sandbox::release() {
+    if (procs_fd >= 0) ::close(procs_fd);
+    procs_fd = -1;
+    if (cgroup_dir.empty()) return "";
+    std::string dir = std::move(cgroup_dir);
+    cgroup_dir.clear();
+
+    // whatever is still in there goes with the conversation
+    if (!write_text(dir + "/cgroup.kill", "1")) {
+        std::istringstream pids(read_text(dir + "/cgroup.procs"));
+        for (long pid; pids >> pid;) ::kill(static_cast<pid_t>(pid), SIGKILL);
+    }
+
+    // usually empty already, otherwise the caller waits for it somewhere else
+    if (::rmdir(dir.c_str()) == 0 || errno != EBUSY) return "";
+    return dir;
+}
+
+void remove_cgroup(const std::string& dir) {
+    // rmdir fails until the last of them has exited
+    for (int i = 0; i < 100 && ::rmdir(dir.c_str()) != 0 && errno == EBUSY; ++i) {
+        usleep(10'000);
+    }
+}
+
+bool Sandbox::open(const SandboxOptions& options, std::string& error) {
+    this->options = options;
+
+#ifndef __linux__
+    if (options.uses_cgroup() || options.no_network) {
+        error = "cgroup limits and net=off need linux";
+        return false;
+    }
+    return true;
+#else
+    if (!options.uses_cgroup()) return true;
+
+    std::string root = options.cgroup_root;
+    if (root.empty()) {
+        std::string mount = cgroup2_mount();
+        if (mount.empty()) {
+            error = "no cgroup v2 hierarchy is mounted";
+            return false;
+        }
+        root = mount + own_cgroup();
+    }
+    while (root.size() > 1 && root.back() == '/') root.pop_back();
+
+    std::vector<std::string> needed;
+    if (options.cpus > 0) needed.push_back("cpu");
+    if (options.memory_bytes > 0) needed.push_back("memory");
+    if (options.max_pids > 0) needed.push_back("pids");
+
+    const std::string available = read_text(root + "/cgroup.controllers");
+    std::string enable;
+    for (const auto& controller : needed) {
+        if (!has_word(available, controller)) {
+            error = "the " + controller + " controller is not available in cgroup " + root;
+            return false;
+        }
+        if (!has_word(read_text(root + "/cgroup.subtree_control"), controller)) enable += "+" + controller + " ";
+    }
+
+    if (!enable.empty() && !write_text(root + "/cgroup.subtree_control", enable)) {
+        // a cgroup with processes of its own can not hand controllers down.
+        // when it is ours, move into a leaf next to the conversations
+        if (errno == EBUSY && options.cgroup_root.empty()) {
+            std::string leaf = root + "/agent";
+            if ((::mkdir(leaf.c_str(), 0755) == 0 || errno == EEXIST) &&
+                write_text(leaf + "/cgroup.procs", std::to_string(getpid())) &&
+                write_text(root + "/cgroup.subtree_control", enable))
+            {
+                enable.clear();
+            }
+        }
+        if (!enable.empty()) {
+            error = errno_text("could not enable " + enable + "in " + root + "/cgroup.subtree_control") +
+                ". Pass --sandbox-cgroup with a delegated cgroup (e.g. systemd-run --user -p Delegate=yes)";
+            return false;
+        }
+    }
+
+    static std::atomic<unsigned> serial{ 0 };
+    std::string dir = root + "/claude-code-" + std::to_string(getpid()) + "-" + std::to_string(serial++);
+    if (::mkdir(dir.c_str(), 0755) != 0) {
+        error = errno_text("could not create cgroup " + dir);
+        return false;
+    }
+
+    bool ok = true;
+    if (ok && options.cpus > 0) {
+        const long period = 100'000;
+        long quota = std::max(1000L, std::lround(options.cpus * period));
+        ok = write_text(dir + "/cpu.max", std::to_string(quota) + " " + std::to_string(period));
+        if (!ok) error = errno_text("could not set cpu.max");
+    }
+    if (ok && options.memory_bytes > 0) {
+        ok = write_text(dir + "/memory.max", std::to_string(options.memory_bytes));
+        if (!ok) error = errno_text("could not set memory.max");
+        // without swap accounting the file is not there, the limit still holds for ram
+        write_text(dir + "/memory.swap.max", "0");
+    }
+    if (ok && options.max_pids > 0) {
+        ok = write_text(dir + "/pids.max", std::to_string(options.max_pids));
+        if (!ok) error = errno_text("could not set pids.max");
+    }
+    if (ok) {
+        procs_fd = ::open((dir + "/cgroup.procs").c_str(), O_WRONLY | O_CLOEXEC);
+        ok = procs_fd >= 0;
+        if (!ok) error = errno_text("could not open " + dir + "/cgroup.procs");
+    }
+
+    if (!ok) {
+        ::rmdir(dir.c_str());
+        return false;
+    }
+    cgroup_dir = std::move(dir);
+    return true;
+#endif
+}
+
+int Sandbox::spawn(const char* path, char* const argv[], int in, int out, int err, int& pid) const {
+    // everything the child needs is prepared here, after fork it only makes system calls
+    struct Limit { int resource; rlim_t value; };
+    Limit limits[3];
+    int limit_count = 0;
+    if (options.cpu_seconds > 0) limits[limit_count++] = { RLIMIT_CPU, static_cast<rlim_t>(options.cpu_seconds) };
+    if (options.file_bytes > 0) limits[limit_count++] = { RLIMIT_FSIZE, static_cast<rlim_t>(options.file_bytes) };
+    if (options.open_files > 0) limits[limit_count++] = { RLIMIT_NOFILE, static_cast<rlim_t>(options.open_files) };
+
+#ifdef __linux__
+    const bool user_namespace = options.no_network && geteuid() != 0;
+    const std::string uid_map = std::to_string(geteuid()) + " " + std::to_string(geteuid()) + " 1\n";
+    const std::string gid_map = std::to_string(getegid()) + " " + std::to_string(getegid()) + " 1\n";
+#endif
+
+    // the child reports a failed setup step here, exec closes it on success
+    int status[2];
+#ifdef __linux__
+    if (pipe2(status, O_CLOEXEC) != 0) return errno;
+#else
+    if (pipe(status) != 0) return errno;
+    fcntl(status[0], F_SETFD, FD_CLOEXEC);
+    fcntl(status[1], F_SETFD, FD_CLOEXEC);
+#endif
+
+    pid_t child = fork();
+    if (child < 0) {
+        int e = errno;
+        ::close(status[0]);
+        ::close(status[1]);
+        return e;
+    }
+
+    if (child == 0) {
+        auto fail = [&](int e) {
+            (void)!::write(status[1], &e, sizeof e);
+            _exit(127);
+        };
+        auto map = [&](const char* file, const std::string& text) {
+            int fd = ::open(file, O_WRONLY | O_CLOEXEC);
+            if (fd < 0 || ::write(fd, text.data(), text.size()) != static_cast<ssize_t>(text.size())) fail(errno);
+            ::close(fd);
+        };
+
+        setpgid(0, 0);
+        if (procs_fd >= 0 && ::write(procs_fd, "0", 1) != 1) fail(errno);
+
+#ifdef __linux__
+        if (options.no_network) {
+            if (::unshare(user_namespace ? CLONE_NEWUSER | CLONE_NEWNET : CLONE_NEWNET) != 0) fail(errno);
+            if (user_namespace) {
+                // the same ids inside, files keep their owner
+                map("/proc/self/setgroups", "deny");
+                map("/proc/self/uid_map", uid_map);
+                map("/proc/self/gid_map", gid_map);
+            }
+        }
+#endif
+
+        for (int i = 0; i < limit_count; ++i) {
+            rlimit limit{ limits[i].value, limits[i].value };
+            if (setrlimit(limits[i].resource, &limit) != 0) fail(errno);
+        }
+
+        // the agent may ignore SIGPIPE, the commands should not
+        struct sigaction dfl {};
+        dfl.sa_handler = SIG_DFL;
+        sigaction(SIGPIPE, &dfl, nullptr);
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, nullptr);
+
+        const int from[3] = { in, out, err };
+        for (int target = 0; target < 3; ++target) {
+            if (from[target] == target) fcntl(target, F_SETFD, 0);
+            else if (dup2(from[target], target) < 0) fail(errno);
+        }
+
+        execve(path, argv, environ);
+        fail(errno);
+    }
+
+    ::close(status[1]);
+    setpgid(child, child); // the child does it too, whoever is first
+    int e = 0;
+    ssize_t n;
+    while ((n = ::read(status[0], &e, sizeof e)) < 0 && errno == EINTR) {}
+    ::close(status[0]);
+
+    if (n == static_cast<ssize_t>(sizeof e)) {
+        while (waitpid(child, nullptr, 0) < 0 && errno == EINTR) {}
+        return e;
+    }
+    pid = static_cast<int>(child);
+    return 0;
+}
+
+#endif
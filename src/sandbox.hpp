@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// limits for the commands one conversation runs (bash, shell and command
+// tools). the in-process tools (files, grep) are not affected
+struct SandboxOptions {
+    // cgroup v2, one cgroup per conversation, shared by everything it starts
+    double cpus = 0;            // cpu.max in cores, 0 = no limit
+    uint64_t memory_bytes = 0;  // memory.max, swap is not allowed on top
+    uint64_t max_pids = 0;      // pids.max
+    std::string cgroup_root;    // delegated cgroup (a directory) to create them in, empty = the one we run in
+
+    // rlimits of every process
+    uint64_t cpu_seconds = 0;   // RLIMIT_CPU
+    uint64_t file_bytes = 0;    // RLIMIT_FSIZE
+    uint64_t open_files = 0;    // RLIMIT_NOFILE
+
+    bool no_network = false;    // an empty network namespace (a user namespace too when not root)
+
+    bool uses_cgroup() const { return cpus > 0 || memory_bytes > 0 || max_pids > 0; }
+    bool enabled() const { return uses_cgroup() || cpu_seconds > 0 || file_bytes > 0 || open_files > 0 || no_network; }
+};
+
+// "cpus=2,memory=4G,pids=512,cpu-time=600,file-size=1G,nofile=1024,net=off"
+// into options, keys that are not in spec stay as they are
+bool parse_sandbox_spec(std::string_view spec, SandboxOptions& options, std::string& error);
+
+// every limit of both, the smaller one where both set it. a task can
+// tighten the process wide limits but not lift them
+SandboxOptions stricter(const SandboxOptions& a, const SandboxOptions& b);
+
+// waits (up to a second) for the killed processes of a released cgroup to exit
+// and removes it. blocks, run it on a worker thread
+void remove_cgroup(const std::string& dir);
+
+// the limits of one conversation: its cgroup, and how its children are started
+class Sandbox {
+public:
+    Sandbox() = default;
+    ~Sandbox();
+
+    Sandbox(const Sandbox&) = delete;
+    Sandbox& operator=(const Sandbox&) = delete;
+
+    // creates the cgroup. false with error when a limit can not be applied,
+    // nothing is run without the limits that were asked for
+    bool open(const SandboxOptions& options, std::string& error);
+
+    // fork, limits, exec. in, out and err become the child's 0, 1 and 2, it
+    // leads its own process group. 0 or the errno of what failed, like posix_spawn
+    int spawn(const char* path, char* const argv[], int in, int out, int err, int& pid) const;
+
+    const std::string& cgroup() const { return cgroup_dir; }
+
+    // kills whatever still runs in the cgroup and lets go of it. returns the
+    // cgroup when it could not be removed yet, its processes are still dying:
+    // hand it to remove_cgroup off the event loop. the destructor does both, blocking
+    std::string release();
+
+private:
+    SandboxOptions options;
+    std::string cgroup_dir; // empty without cgroup limits
+    int procs_fd = -1;      // its cgroup.procs, children write themselves in
+};
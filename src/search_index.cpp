@@ -0,0 +1,348 @@
+#include "search_index.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char INDEX_NAME[] = ".claude-code-search.idx";
+
+const char MAGIC[8] = { 'C', 'C', 'T', 'R', 'I', 'D', 'X', '1' };
+
+// native byte order, the index never leaves the machine that wrote it
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t file_count;
+    uint32_t trigram_count;
+    uint32_t reserved;
+    uint64_t files_offset;
+    uint64_t trigrams_offset;
+    uint64_t postings_offset;
+    uint64_t postings_count;
+    uint64_t strings_offset;
+};
+
+unsigned char fold(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c + 32) : c;
+}
+
+template <typename T>
+T read_at(std::string_view data, uint64_t offset) {
+    T value;
+    std::memcpy(&value, data.data() + offset, sizeof(T));
+    return value;
+}
+
+}
+
+struct SearchIndex::FileRecord {
+    uint32_t path_offset;
+    uint32_t path_length;
+    uint64_t size;
+    int64_t mtime;
+};
+
+struct SearchIndex::TrigramRecord {
+    uint32_t trigram;
+    uint32_t first;  // index into the postings array
+    uint32_t count;
+};
+
+TrigramCollector::TrigramCollector()
+    : seen((1u << 24) / 64, 0)
+{
+}
+
+void TrigramCollector::collect(std::string_view data, TrigramSet& out) {
+    out.clear();
+    if (data.size() < 3) return;
+
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data.data());
+    uint32_t t = (uint32_t(fold(bytes[0])) << 8) | fold(bytes[1]);
+
+    for (size_t i = 2; i < data.size(); ++i) {
+        t = ((t << 8) | fold(bytes[i])) & 0xFFFFFF;
+        uint64_t& word = seen[t >> 6];
+        uint64_t bit = uint64_t(1) << (t & 63);
+        if (!(word & bit)) {
+            word |= bit;
+            touched.push_back(t);
+        }
+    }
+
+    std::sort(touched.begin(), touched.end());
+    out.assign(touched.begin(), touched.end());
+
+    // clearing only what was set keeps small files cheap
+    for (uint32_t value : touched) seen[value >> 6] = 0;
+    touched.clear();
+}
+
+TrigramSet trigrams_of(std::string_view text) {
+    TrigramSet out;
+    const auto* bytes = reinterpret_cast<const unsigned char*>(text.data());
+    for (size_t i = 0; i + 2 < text.size(); ++i) {
+        out.push_back((uint32_t(fold(bytes[i])) << 16) | (uint32_t(fold(bytes[i + 1])) << 8) | fold(bytes[i + 2]));
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return out;
+}
+
+std::string SearchIndex::location_for(const std::string& root, std::string& index_root) {
+    namespace fs = std::filesystem;
+
+    std::error_code ec;
+    fs::path dir = fs::absolute(root, ec).lexically_normal();
+    if (!dir.has_filename()) dir = dir.parent_path();
+
+    for (fs::path cur = dir;; cur = cur.parent_path()) {
+        if (fs::is_directory(cur / ".git", ec)) {
+            index_root = cur.string();
+            return (cur / ".git" / (INDEX_NAME + 1)).string();
+        }
+        if (cur == cur.parent_path()) break;
+    }
+
+    index_root = dir.string();
+    return (dir / INDEX_NAME).string();
+}
+
+bool SearchIndex::is_index_file(std::string_view path) {
+    size_t slash = path.find_last_of("/\\");
+    std::string_view name = slash == std::string_view::npos ? path : path.substr(slash + 1);
+    return name.substr(0, sizeof(INDEX_NAME) - 1) == INDEX_NAME;
+}
+
+bool SearchIndex::load(const std::string& path) {
+    if (!file.open(path)) return false;
+    data = file.view();
+    if (data.size() < sizeof(Header)) return false;
+
+    Header header = read_at<Header>(data, 0);
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) return false;
+
+    // every table has to fit, a torn or foreign file is ignored and rebuilt
+    auto fits = [&](uint64_t offset, uint64_t count, uint64_t width) {
+        return offset <= data.size() && count <= (data.size() - offset) / width;
+    };
+    if (!fits(header.files_offset, header.file_count, sizeof(FileRecord)) ||
+        !fits(header.trigrams_offset, header.trigram_count, sizeof(TrigramRecord)) ||
+        !fits(header.postings_offset, header.postings_count, sizeof(uint32_t)) ||
+        header.strings_offset > data.size())
+    {
+        return false;
+    }
+
+    files_count = header.file_count;
+    trigrams_count = header.trigram_count;
+    files_offset = header.files_offset;
+    trigrams_offset = header.trigrams_offset;
+    postings_offset = header.postings_offset;
+    postings_count = header.postings_count;
+    strings_offset = header.strings_offset;
+
+    for (uint32_t i = 0; i < files_count; ++i) {
+        const FileRecord* record = file_record(i);
+        if (strings_offset + record->path_offset + record->path_length > data.size()) return false;
+    }
+    return true;
+}
+
+const SearchIndex::FileRecord* SearchIndex::file_record(uint32_t id) const {
+    return reinterpret_cast<const FileRecord*>(data.data() + files_offset + uint64_t(id) * sizeof(FileRecord));
+}
+
+const SearchIndex::TrigramRecord* SearchIndex::trigram_record(uint32_t index) const {
+    return reinterpret_cast<const TrigramRecord*>(data.data() + trigrams_offset + uint64_t(index) * sizeof(TrigramRecord));
+}
+
+uint32_t SearchIndex::posting(uint32_t index) const {
+    return read_at<uint32_t>(data, postings_offset + uint64_t(index) * sizeof(uint32_t));
+}
+
+std::string_view SearchIndex::path(uint32_t id) const {
+    const FileRecord* record = file_record(id);
+    return data.substr(strings_offset + record->path_offset, record->path_length);
+}
+
+uint64_t SearchIndex::size(uint32_t id) const {
+    return file_record(id)->size;
+}
+
+long long SearchIndex::mtime(uint32_t id) const {
+    return file_record(id)->mtime;
+}
+
+long SearchIndex::find(std::string_view rel) const {
+    uint32_t low = 0, high = files_count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        std::string_view candidate = path(mid);
+        if (candidate == rel) return static_cast<long>(mid);
+        if (candidate < rel) low = mid + 1;
+        else high = mid;
+    }
+    return -1;
+}
+
+const SearchIndex::TrigramRecord* SearchIndex::find_trigram(uint32_t trigram) const {
+    uint32_t low = 0, high = trigrams_count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        const TrigramRecord* record = trigram_record(mid);
+        if (record->trigram == trigram) return record;
+        if (record->trigram < trigram) low = mid + 1;
+        else high = mid;
+    }
+    return nullptr;
+}
+
+std::vector<uint32_t> SearchIndex::candidates(std::string_view literal) const {
+    std::vector<const TrigramRecord*> lists;
+    for (uint32_t trigram : trigrams_of(literal)) {
+        const TrigramRecord* record = find_trigram(trigram);
+        if (!record || uint64_t(record->first) + record->count > postings_count) return {};
+        lists.push_back(record);
+    }
+    if (lists.empty()) return {};
+
+    // shortest list first, every intersection can only shrink it
+    std::sort(lists.begin(), lists.end(), [](const TrigramRecord* a, const TrigramRecord* b) {
+        return a->count < b->count;
+    });
+
+    std::vector<uint32_t> result;
+    result.reserve(lists[0]->count);
+    for (uint32_t i = 0; i < lists[0]->count; ++i) result.push_back(posting(lists[0]->first + i));
+
+    std::vector<uint32_t> next;
+    for (size_t l = 1; l < lists.size() && !result.empty(); ++l) {
+        next.clear();
+        const TrigramRecord* list = lists[l];
+        size_t a = 0;
+        uint32_t b = 0;
+        while (a < result.size() && b < list->count) {
+            uint32_t value = posting(list->first + b);
+            if (result[a] < value) a++;
+            else if (value < result[a]) b++;
+            else {
+                next.push_back(value);
+                a++;
+                b++;
+            }
+        }
+        result.swap(next);
+    }
+
+    return result;
+}
+
+std::vector<TrigramSet> SearchIndex::invert() const {
+    std::vector<TrigramSet> sets(files_count);
+    for (uint32_t i = 0; i < trigrams_count; ++i) {
+        const TrigramRecord* record = trigram_record(i);
+        if (uint64_t(record->first) + record->count > postings_count) continue;
+        for (uint32_t j = 0; j < record->count; ++j) {
+            uint32_t id = posting(record->first + j);
+            // trigrams are visited in order, so every set comes out sorted
+            if (id < files_count) sets[id].push_back(record->trigram);
+        }
+    }
+    return sets;
+}
+
+void SearchIndexWriter::add(std::string rel, uint64_t size, long long mtime, TrigramSet trigrams) {
+    entries.push_back(Entry{ std::move(rel), size, mtime, std::move(trigrams) });
+}
+
+bool SearchIndexWriter::write(const std::string& path, std::string& error) {
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.rel < b.rel; });
+    entries.erase(std::unique(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.rel == b.rel;
+    }), entries.end());
+
+    // invert: (trigram, file id) pairs sorted by trigram, then id
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    size_t total = 0;
+    for (const auto& entry : entries) total += entry.trigrams.size();
+    pairs.reserve(total);
+    for (uint32_t id = 0; id < entries.size(); ++id) {
+        for (uint32_t trigram : entries[id].trigrams) pairs.emplace_back(trigram, id);
+    }
+    std::sort(pairs.begin(), pairs.end());
+
+    std::vector<SearchIndex::TrigramRecord> trigrams;
+    std::vector<uint32_t> postings;
+    postings.reserve(pairs.size());
+    for (const auto& [trigram, id] : pairs) {
+        if (trigrams.empty() || trigrams.back().trigram != trigram) {
+            trigrams.push_back({ trigram, static_cast<uint32_t>(postings.size()), 0 });
+        }
+        trigrams.back().count++;
+        postings.push_back(id);
+    }
+
+    std::string strings;
+    std::vector<SearchIndex::FileRecord> files;
+    files.reserve(entries.size());
+    for (const auto& entry : entries) {
+        files.push_back({ static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(entry.rel.size()),
+                          entry.size, static_cast<int64_t>(entry.mtime) });
+        strings += entry.rel;
+    }
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = SearchIndex::VERSION;
+    header.file_count = static_cast<uint32_t>(files.size());
+    header.trigram_count = static_cast<uint32_t>(trigrams.size());
+    header.files_offset = sizeof(Header);
+    header.trigrams_offset = header.files_offset + files.size() * sizeof(SearchIndex::FileRecord);
+    header.postings_offset = header.trigrams_offset + trigrams.size() * sizeof(SearchIndex::TrigramRecord);
+    header.postings_count = postings.size();
+    header.strings_offset = header.postings_offset + postings.size() * sizeof(uint32_t);
+
+    // other sessions may have the old index mapped, never write it in place
+    static std::atomic<unsigned> serial{ 0 };
+    std::string temp = path + ".tmp." + std::to_string(getpid()) + "." + std::to_string(serial++);
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            error = "could not write " + temp;
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(files.data()), files.size() * sizeof(SearchIndex::FileRecord));
+        out.write(reinterpret_cast<const char*>(trigrams.data()), trigrams.size() * sizeof(SearchIndex::TrigramRecord));
+        out.write(reinterpret_cast<const char*>(postings.data()), postings.size() * sizeof(uint32_t));
+        out.write(strings.data(), strings.size());
+        if (!out) {
+            error = "could not write " + temp;
+            std::remove(temp.c_str());
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temp, path, ec);
+    if (ec) {
+        error = "could not replace " + path + ": " + ec.message();
+        std::remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mapped_file.hpp"
+
+// sorted, unique trigrams of a file's bytes with ascii letters lowercased,
+// so one index answers case sensitive and insensitive queries alike
+using TrigramSet = std::vector<uint32_t>;
+
+// reusable scratch space for collecting trigrams, one per thread (2 MB bitmap)
+class TrigramCollector {
+public:
+    TrigramCollector();
+
+    void collect(std::string_view data, TrigramSet& out);
+
+private:
+    std::vector<uint64_t> seen;
+    std::vector<uint32_t> touched;
+};
+
+TrigramSet trigrams_of(std::string_view text);
+
+// on-disk trigram index of one checkout, memory mapped and only ever read.
+// files are keyed by their path relative to the index root with the size and
+// mtime they had when indexed, a file whose stamp changed is simply not trusted
+class SearchIndex {
+public:
+    static constexpr uint32_t VERSION = 1;
+
+    // where the index for a search under root lives: inside .git of the
+    // enclosing repository when there is one, so the worktree stays clean.
+    // index_root gets the directory the indexed paths are relative to
+    static std::string location_for(const std::string& root, std::string& index_root);
+
+    // the index (or one being written) outside .git, which searches leave out
+    static bool is_index_file(std::string_view path);
+
+    // false when there is no index yet or it is from another version / damaged
+    bool load(const std::string& path);
+
+    size_t file_count() const { return files_count; }
+
+    // id of the file, -1 when it is not indexed
+    long find(std::string_view rel) const;
+    std::string_view path(uint32_t id) const;
+    uint64_t size(uint32_t id) const;
+    long long mtime(uint32_t id) const;
+
+    // ids (sorted) of files containing every trigram of literal, which must be at least 3 bytes
+    std::vector<uint32_t> candidates(std::string_view literal) const;
+
+    // trigram sets of every file, to carry unchanged files into the next index
+    std::vector<TrigramSet> invert() const;
+
+private:
+    friend class SearchIndexWriter;
+
+    struct FileRecord;
+    struct TrigramRecord;
+
+    const FileRecord* file_record(uint32_t id) const;
+    const TrigramRecord* trigram_record(uint32_t index) const;
+    const TrigramRecord* find_trigram(uint32_t trigram) const;
+    uint32_t posting(uint32_t index) const;
+
+    MappedFile file;
+    std::string_view data;
+    uint32_t files_count = 0;
+    uint32_t trigrams_count = 0;
+    uint64_t files_offset = 0;
+    uint64_t trigrams_offset = 0;
+    uint64_t postings_offset = 0;
+    uint64_t postings_count = 0;
+    uint64_t strings_offset = 0;
+};
+
+// collects the next index and writes it atomically (temp file + rename)
+class SearchIndexWriter {
+public:
+    void add(std::string rel, uint64_t size, long long mtime, TrigramSet trigrams);
+    bool write(const std::string& path, std::string& error);
+
+private:
+    struct Entry {
+        std::string rel;
+        uint64_t size;
+        long long mtime;
+        TrigramSet trigrams;
+    };
+
+    std::vector<Entry> entries;
+};
@@ -0,0 +1,511 @@
+#include "search_tools.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <regex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "file_walker.hpp"
+#include "glob.hpp"
+#include "mapped_file.hpp"
+#include "search_index.hpp"
+#include "text_search.hpp"
+
+namespace {
+
+// longer lines are cut, minified files would otherwise flood the result
+const size_t MAX_LINE_BYTES = 240;
+// bigger files are skipped by grep, they are almost never source
+const size_t MAX_GREP_FILE = 32ull * 1024 * 1024;
+// a NUL in the first block marks a file as binary, like git does
+const size_t BINARY_SNIFF = 8000;
+
+std::string string_arg(const json& args, const char* key, const std::string& fallback = "") {
+    if (args.contains(key) && args[key].is_string()) return args[key].get<std::string>();
+    return fallback;
+}
+
+bool bool_arg(const json& args, const char* key) {
+    return args.contains(key) && args[key].is_boolean() && args[key].get<bool>();
+}
+
+size_t size_arg(const json& args, const char* key, size_t fallback, size_t max) {
+    if (!args.contains(key) || !args[key].is_number()) return fallback;
+    double value = args[key].get<double>();
+    if (value < 1) return 1;
+    // clamped before the cast, a double past size_t is undefined behavior
+    if (!(value < static_cast<double>(max))) return max;
+    return static_cast<size_t>(value);
+}
+
+ToolAccess root_access(const json& args) {
+    return { normalize_tool_path(string_arg(args, "path", ".")), false };
+}
+
+// cut on a character boundary
+void append_clipped(std::string& out, std::string_view line) {
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    if (line.size() <= MAX_LINE_BYTES) {
+        out.append(line);
+        return;
+    }
+
+    size_t cut = MAX_LINE_BYTES;
+    while (cut > 0 && (static_cast<unsigned char>(line[cut]) & 0xC0) == 0x80) cut--;
+    out.append(line.substr(0, cut));
+    out += " [...]";
+}
+
+std::string format_size(uint64_t bytes) {
+    const char* units[] = { "B", "KB", "MB", "GB" };
+    double value = static_cast<double>(bytes);
+    int unit = 0;
+    while (value >= 1024 && unit < 3) {
+        value /= 1024;
+        unit++;
+    }
+
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), unit == 0 ? "%.0f %s" : "%.1f %s", value, units[unit]);
+    return buffer;
+}
+
+std::string plural(size_t count, const char* one, const char* many) {
+    return std::to_string(count) + " " + (count == 1 ? one : many);
+}
+
+size_t worker_count(size_t jobs) {
+    size_t threads = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, 8);
+    return std::max<size_t>(1, std::min(threads, jobs / 16 + 1));
+}
+
+struct LineHit {
+    size_t line = 0;
+    std::string text; // already clipped, the mapping is gone by the time we print
+};
+
+struct FileHits {
+    std::vector<LineHit> hits;
+    size_t clipped = 0; // long lines without a hit in the part the regex saw
+    TrigramSet trigrams;
+    bool indexed = false; // trigrams hold the file's current content
+};
+
+// every matching line of one file, at most limit of them. with a collector
+// the file's trigrams are taken from the same mapping for the index, and
+// without a matcher that is all that happens
+void grep_file(const std::string& path, const LineMatcher* matcher, size_t limit, FileHits& result,
+               TrigramCollector* collector = nullptr)
+{
+    MappedFile file;
+    if (!file.open(path)) return;
+
+    std::string_view data = file.view();
+    // binary and huge files go into the index without trigrams, grep skips them anyway
+    bool skipped = data.size() > MAX_GREP_FILE || std::memchr(data.data(), '\0', std::min(data.size(), BINARY_SNIFF));
+    if (collector) {
+        if (!skipped) collector->collect(data, result.trigrams);
+        result.indexed = true;
+    }
+    if (skipped || !matcher) return;
+
+    // most files of a big tree do not contain the literal at all
+    if (matcher->has_prefilter() && matcher->prefilter().find(data) == std::string_view::npos) return;
+
+    size_t line_number = 1;
+    size_t counted = 0; // line_number is the line that starts at counted
+    size_t offset = 0;
+
+    while (offset < data.size() && result.hits.size() < limit) {
+        size_t start = offset;
+        if (matcher->has_prefilter()) {
+            // jump from candidate to candidate instead of walking every line
+            size_t candidate = matcher->prefilter().find(data, offset);
+            if (candidate == std::string_view::npos) break;
+            size_t newline = candidate == 0 ? std::string_view::npos : data.rfind('\n', candidate - 1);
+            start = newline == std::string_view::npos ? 0 : newline + 1;
+            if (start < offset) start = offset;
+        }
+
+        size_t end = data.find('\n', start);
+        if (end == std::string_view::npos) end = data.size();
+
+        line_number += static_cast<size_t>(std::count(data.begin() + counted, data.begin() + start, '\n'));
+        counted = start;
+
+        std::string_view line = data.substr(start, end - start);
+        if (matcher->matches(line)) {
+            LineHit hit{ line_number, {} };
+            append_clipped(hit.text, line);
+            result.hits.push_back(std::move(hit));
+        }
+        else if (matcher->clips(line)) {
+            result.clipped++;
+        }
+
+        offset = end + 1;
+    }
+}
+
+bool path_filter_match(const std::string& filter, const WalkEntry& entry) {
+    if (filter.empty()) return true;
+    // "*.cpp" is about the name, "src/**/*.cpp" about the whole path
+    if (filter.find('/') == std::string::npos) {
+        size_t slash = entry.rel.rfind('/');
+        return glob_match(filter, slash == std::string::npos ? entry.rel : std::string_view(entry.rel).substr(slash + 1));
+    }
+    return glob_match(filter, entry.rel);
+}
+
+struct GrepJob {
+    std::string path;
+    size_t entry = 0;    // into the walk listing
+    bool search = true;  // false: only refreshing the index, the glob excludes it
+    bool collect = false;
+};
+
+// the persistent index as one grep over a directory sees it
+struct IndexState {
+    std::string path;
+    std::string prefix; // the search root relative to the index root, "" or "src/"
+    SearchIndex index;
+    bool loaded = false;
+    std::vector<long> ids; // per walk entry, -1 = not indexed or changed since
+};
+
+bool open_index(const std::string& root, IndexState& state) {
+    namespace fs = std::filesystem;
+
+    std::string index_root;
+    state.path = SearchIndex::location_for(root, index_root);
+
+    std::error_code ec;
+    fs::path rel = fs::absolute(root, ec).lexically_normal().lexically_relative(index_root);
+    std::string prefix = rel.generic_string();
+    if (ec || prefix.empty() || prefix.rfind("..", 0) == 0) return false;
+    if (!prefix.empty() && prefix.back() == '/') prefix.pop_back();
+    state.prefix = prefix == "." ? "" : prefix + "/";
+
+    state.loaded = state.index.load(state.path);
+    return true;
+}
+
+// writes the next index when anything under the searched root changed: files
+// outside it and unchanged ones keep their trigrams, refreshed ones replace
+// theirs and files under the root that are gone are dropped
+void update_index(IndexState& state, const std::vector<WalkEntry>& entries,
+                  const std::vector<GrepJob>& jobs, std::vector<FileHits>& results)
+{
+    const SearchIndex& index = state.index;
+    size_t old_count = state.loaded ? index.file_count() : 0;
+
+    std::vector<bool> kept(old_count, false);
+    for (long id : state.ids) {
+        if (id >= 0) kept[static_cast<size_t>(id)] = true;
+    }
+
+    bool dirty = !state.loaded;
+    for (size_t id = 0; id < old_count && !dirty; ++id) {
+        if (!kept[id] && index.path(static_cast<uint32_t>(id)).substr(0, state.prefix.size()) == state.prefix) dirty = true;
+    }
+    for (size_t i = 0; i < jobs.size() && !dirty; ++i) {
+        if (results[i].indexed) dirty = true;
+    }
+    if (!dirty) return;
+
+    SearchIndexWriter writer;
+    if (old_count > 0) {
+        std::vector<TrigramSet> sets = index.invert();
+        for (uint32_t id = 0; id < old_count; ++id) {
+            std::string_view rel = index.path(id);
+            bool under_root = rel.substr(0, state.prefix.size()) == state.prefix;
+            if (under_root && !kept[id]) continue;
+            writer.add(std::string(rel), index.size(id), index.mtime(id), std::move(sets[id]));
+        }
+    }
+
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        if (!results[i].indexed) continue;
+        const WalkEntry& entry = entries[jobs[i].entry];
+        writer.add(state.prefix + entry.rel, entry.size, entry.mtime, std::move(results[i].trigrams));
+    }
+
+    // the index only saves work, a read-only checkout just goes without
+    std::string error;
+    writer.write(state.path, error);
+}
+
+}
+
+ToolAccess GrepTool::access(const json& args) const {
+    return root_access(args);
+}
+
+void GrepTool::execute(const json& args, const ToolContext&, std::string& out) {
+    std::string pattern = string_arg(args, "pattern");
+    if (pattern.empty()) {
+        out = "ERROR: pattern is required";
+        return;
+    }
+
+    std::string root = string_arg(args, "path", ".");
+    std::string filter = string_arg(args, "glob");
+    bool literal = bool_arg(args, "literal");
+    bool ignore_case = bool_arg(args, "ignore_case");
+    size_t limit = size_arg(args, "max_results", DEFAULT_RESULTS, MAX_RESULTS);
+
+    std::optional<LineMatcher> matcher;
+    try {
+        matcher.emplace(pattern, literal, ignore_case);
+    }
+    catch (const std::regex_error& e) {
+        out = std::string("ERROR: invalid regex: ") + e.what() + " (set literal to search for the text as is)";
+        return;
+    }
+
+    std::vector<WalkEntry> entries;
+    std::vector<GrepJob> jobs;
+    size_t searched = 0;
+    std::optional<IndexState> state;
+
+    std::error_code ec;
+    if (std::filesystem::is_regular_file(root, ec)) {
+        jobs.push_back({ root });
+        searched = 1;
+    }
+    else {
+        WalkOptions walk;
+        walk.files_only = true;
+        walk.respect_gitignore = !bool_arg(args, "include_ignored");
+
+        WalkResult listing = walk_tree(root, walk);
+        if (!listing.error.empty()) {
+            out = "ERROR: " + listing.error;
+            return;
+        }
+        entries = std::move(listing.entries);
+
+        if (use_index) {
+            state.emplace();
+            if (!open_index(root, *state)) state.reset();
+        }
+
+        // with an index, unchanged files that lack one of the literal's
+        // trigrams are never opened, changed and new ones are read once for
+        // both the search and the index
+        std::optional<std::string> key = literal ? std::optional<std::string>(pattern) : required_literal(pattern);
+        std::vector<bool> candidate;
+        if (state && state->loaded && key && key->size() >= 3) {
+            candidate.assign(state->index.file_count(), false);
+            for (uint32_t id : state->index.candidates(*key)) candidate[id] = true;
+        }
+
+        if (state) state->ids.assign(entries.size(), -1);
+        for (size_t i = 0; i < entries.size(); ++i) {
+            const WalkEntry& entry = entries[i];
+            if (state && SearchIndex::is_index_file(entry.path)) continue;
+            bool search = path_filter_match(filter, entry);
+            if (search) searched++;
+
+            if (!state) {
+                if (search) jobs.push_back({ entry.path, i });
+                continue;
+            }
+
+            long id = state->loaded ? state->index.find(state->prefix + entry.rel) : -1;
+            if (id >= 0 && state->index.size(static_cast<uint32_t>(id)) == entry.size &&
+                state->index.mtime(static_cast<uint32_t>(id)) == entry.mtime)
+            {
+                state->ids[i] = id;
+                if (search && (candidate.empty() || candidate[static_cast<size_t>(id)])) jobs.push_back({ entry.path, i });
+            }
+            else {
+                jobs.push_back({ entry.path, i, search, true });
+            }
+        }
+    }
+
+    // workers take files in path order, so once enough is found every file
+    // before the last one taken has been searched and the first hits are exact
+    std::vector<FileHits> results(jobs.size());
+    std::atomic<size_t> next{ 0 };
+    std::atomic<size_t> found{ 0 };
+
+    auto worker = [&]() {
+        std::optional<TrigramCollector> collector;
+        for (size_t i = next++; i < jobs.size() && found.load(std::memory_order_relaxed) < limit; i = next++) {
+            const GrepJob& job = jobs[i];
+            if (job.collect && !collector) collector.emplace();
+            grep_file(job.path, job.search ? &*matcher : nullptr, limit, results[i], job.collect ? &*collector : nullptr);
+            found += results[i].hits.size();
+        }
+    };
+
+    size_t threads = worker_count(jobs.size());
+    std::vector<std::thread> helpers;
+    for (size_t i = 1; i < threads; ++i) helpers.emplace_back(worker);
+    worker();
+    for (auto& helper : helpers) helper.join();
+
+    if (state) update_index(*state, entries, jobs, results);
+
+    // a match past the first MAX_REGEX_LINE bytes of a minified line is not seen
+    size_t clipped = 0;
+    for (const auto& result : results) clipped += result.clipped;
+    auto clipped_note = [&]() {
+        return "[" + plural(clipped, "long line", "long lines") + " only searched in their first " +
+            std::to_string(LineMatcher::MAX_REGEX_LINE / 1024) + " KB]";
+    };
+
+    size_t shown = 0;
+    size_t files_with_hits = 0;
+    for (size_t i = 0; i < jobs.size() && shown < limit; ++i) {
+        if (results[i].hits.empty()) continue;
+        files_with_hits++;
+
+        for (const auto& hit : results[i].hits) {
+            if (shown == limit) break;
+            out += jobs[i].path;
+            out += ':';
+            out += std::to_string(hit.line);
+            out += ": ";
+            out += hit.text;
+            out += '\n';
+            shown++;
+        }
+    }
+
+    if (shown == 0) {
+        out = "No matches for " + pattern + " (" + std::to_string(searched) + " files searched)";
+        if (clipped) out += "\n" + clipped_note();
+        return;
+    }
+
+    if (found.load() > shown || next.load() < jobs.size()) {
+        out += "[first " + std::to_string(shown) + " matches shown, narrow pattern, path or glob for the rest]";
+    }
+    else {
+        out += "[" + plural(shown, "match", "matches") + " in " + plural(files_with_hits, "file", "files") + "]";
+    }
+    if (clipped) out += "\n" + clipped_note();
+}
+
+ToolAccess GlobTool::access(const json& args) const {
+    return root_access(args);
+}
+
+void GlobTool::execute(const json& args, const ToolContext&, std::string& out) {
+    std::string pattern = string_arg(args, "pattern");
+    if (pattern.empty()) {
+        out = "ERROR: pattern is required";
+        return;
+    }
+
+    std::string root = string_arg(args, "path", ".");
+    size_t limit = size_arg(args, "max_results", DEFAULT_RESULTS, MAX_RESULTS);
+
+    // literal leading directories only narrow where the walk starts
+    std::string rest = pattern;
+    while (true) {
+        size_t slash = rest.find('/');
+        if (slash == std::string::npos) break;
+        std::string head = rest.substr(0, slash);
+        if (!glob_is_literal(head) || head == "..") break;
+        if (!head.empty() && head != ".") {
+            root = root == "." ? head : root + "/" + head;
+        }
+        rest = rest.substr(slash + 1);
+    }
+
+    WalkOptions walk;
+    walk.respect_gitignore = !bool_arg(args, "include_ignored");
+    if (rest.find("**") == std::string::npos) {
+        walk.max_depth = static_cast<int>(std::count(rest.begin(), rest.end(), '/')) + 1;
+    }
+
+    std::error_code ec;
+    if (!std::filesystem::is_directory(root, ec)) {
+        out = "No files match " + pattern;
+        return;
+    }
+
+    WalkResult listing = walk_tree(root, walk);
+    if (!listing.error.empty()) {
+        out = "ERROR: " + listing.error;
+        return;
+    }
+
+    size_t matched = 0;
+    for (const auto& entry : listing.entries) {
+        if (!glob_match(rest, entry.rel)) continue;
+        if (++matched > limit) continue; // keep counting for the footer
+
+        out += entry.path;
+        if (entry.is_dir) out += '/';
+        out += '\n';
+    }
+
+    if (matched == 0) {
+        out = "No files match " + pattern;
+        return;
+    }
+
+    if (matched > limit) {
+        out += "[" + std::to_string(limit) + " of " + std::to_string(matched) + " matches shown, use a narrower pattern]";
+    }
+    else if (!out.empty()) {
+        out.pop_back();
+    }
+}
+
+ToolAccess ListDirTool::access(const json& args) const {
+    return root_access(args);
+}
+
+void ListDirTool::execute(const json& args, const ToolContext&, std::string& out) {
+    std::string root = string_arg(args, "path", ".");
+    size_t depth = size_arg(args, "depth", 1, MAX_DEPTH);
+    size_t limit = size_arg(args, "max_entries", DEFAULT_ENTRIES, MAX_ENTRIES);
+
+    WalkOptions walk;
+    walk.respect_gitignore = !bool_arg(args, "include_ignored");
+    walk.max_depth = static_cast<int>(depth);
+    walk.max_entries = limit;
+
+    WalkResult listing = walk_tree(root, walk);
+    if (!listing.error.empty()) {
+        out = "ERROR: " + listing.error;
+        return;
+    }
+
+    if (listing.entries.empty()) {
+        out = "(empty directory)";
+        return;
+    }
+
+    for (const auto& entry : listing.entries) {
+        out.append(static_cast<size_t>(entry.depth - 1) * 2, ' ');
+        out += entry.path;
+        if (entry.is_dir) {
+            out += "/\n";
+        }
+        else {
+            out += "  (";
+            out += format_size(entry.size);
+            out += ")\n";
+        }
+    }
+
+    if (listing.truncated) {
+        out += "[listing stopped at " + std::to_string(limit) + " entries, list a subdirectory or use a smaller depth]";
+    }
+    else {
+        out.pop_back();
+    }
+}
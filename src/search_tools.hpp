@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include "tool.hpp"
+
+using json = nlohmann::json;
+
+// native replacements for shelling out to grep / find / ls.
+// all of them walk in parallel, skip what .gitignore ignores and cap their output
+
+class GrepTool : public Tool {
+public:
+    static constexpr size_t DEFAULT_RESULTS = 100;
+    static constexpr size_t MAX_RESULTS = 1000;
+
+    static constexpr ToolParam PARAMS[] = {
+        { "pattern", "string", "ECMAScript regex, or plain text when literal is true", true },
+        { "path", "string", "File or directory to search (default .)" },
+        { "glob", "string", "Only search files matching this glob, e.g. *.cpp or src/**/*.hpp" },
+        { "literal", "boolean", "Treat pattern as plain text" },
+        { "ignore_case", "boolean", "Case insensitive match" },
+        { "include_ignored", "boolean", "Also search files ignored by .gitignore" },
+        { "max_results", "integer", "Maximum matching lines to return (default 100, max 1000)" },
+    };
+    static constexpr ToolSpec SPEC{
+        "grep",
+        "Search file contents for a regex (or literal text) across a directory tree, skipping what .gitignore ignores. "
+        "Returns path:line: text for each matching line. Prefer this over grep in bash",
+        PARAMS
+    };
+
+    // use_index keeps a trigram index of the checkout on disk (see search_index.hpp),
+    // later searches only open the files that can contain the pattern's literal
+    explicit GrepTool(bool use_index = false) : use_index(use_index) {}
+
+    const ToolSpec& spec() const override { return SPEC; }
+    ToolAccess access(const json& args) const override;
+    void execute(const json& args, const ToolContext& ctx, std::string& out) override;
+
+private:
+    bool use_index;
+};
+
+class GlobTool : public Tool {
+public:
+    static constexpr size_t DEFAULT_RESULTS = 200;
+    static constexpr size_t MAX_RESULTS = 2000;
+
+    static constexpr ToolParam PARAMS[] = {
+        { "pattern", "string", "Glob relative to path, e.g. **/*.cpp or src/*/CMakeLists.txt", true },
+        { "path", "string", "Directory to search from (default .)" },
+        { "include_ignored", "boolean", "Also return paths ignored by .gitignore" },
+        { "max_results", "integer", "Maximum paths to return (default 200, max 2000)" },
+    };
+    static constexpr ToolSpec SPEC{
+        "glob",
+        "Find files and directories whose path matches a glob (* and ? within a name, ** across directories), skipping what .gitignore ignores",
+        PARAMS
+    };
+
+    const ToolSpec& spec() const override { return SPEC; }
+    ToolAccess access(const json& args) const override;
+    void execute(const json& args, const ToolContext& ctx, std::string& out) override;
+};
+
+class ListDirTool : public Tool {
+public:
+    static constexpr size_t DEFAULT_ENTRIES = 300;
+    static constexpr size_t MAX_ENTRIES = 2000;
+    static constexpr int MAX_DEPTH = 5;
+
+    static constexpr ToolParam PARAMS[] = {
+        { "path", "string", "Directory to list (default .)" },
+        { "depth", "integer", "How many levels to descend (default 1, max 5)" },
+        { "include_ignored", "boolean", "Also list entries ignored by .gitignore" },
+        { "max_entries", "integer", "Maximum entries to return (default 300, max 2000)" },
+    };
+    static constexpr ToolSpec SPEC{
+        "list_dir",
+        "List a directory (optionally a few levels deep) with file sizes, skipping what .gitignore ignores",
+        PARAMS
+    };
+
+    const ToolSpec& spec() const override { return SPEC; }
+    ToolAccess access(const json& args) const override;
+    void execute(const json& args, const ToolContext& ctx, std::string& out) override;
+};
@@ -0,0 +1,624 @@
+#include "server.hpp"
+
+#include <algorithm>
+#include <csignal>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "batch.hpp"
+
+#ifndef _WIN32
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <strings.h>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool is_unix_address(const std::string& address) {
+    return address.rfind("unix:", 0) == 0 || address.find('/') != std::string::npos;
+}
+
+int run_server(AgentEnv&, const AgentOptions&, const ServeOptions&) {
+    std::cerr << "--serve is not supported on this platform" << std::endl;
+    return 1;
+}
+
+#else
+
+namespace {
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+void request_stop(int) {
+    stop_requested = 1;
+}
+
+// how long a stop request can go unnoticed
+const int POLL_MS = 200;
+// a job line or http request bigger than this closes its connection
+const size_t MAX_REQUEST_BYTES = 16ull * 1024 * 1024;
+
+struct Connection {
+    explicit Connection(int fd) : fd(fd) {}
+    ~Connection() { ::close(fd); }
+
+    int fd;
+    std::string outbox;
+    bool flushing = false;
+    bool broken = false; // the peer is gone, nothing more goes out
+    bool authorized = false;
+};
+
+struct Job {
+    BatchTask task;
+    AsyncEvent done;
+    json result; // the batch result line, set before done
+};
+
+// jobs waiting for a worker, workers wait for jobs the way requests wait for a client lease
+class JobQueue {
+public:
+    explicit JobQueue(EventLoop& loop) : loop(loop) {}
+
+    void push(std::shared_ptr<Job> job) {
+        if (waiters.empty()) {
+            jobs.push_back(std::move(job));
+            return;
+        }
+        Waiter waiter = waiters.front();
+        waiters.pop_front();
+        *waiter.slot = std::move(job);
+        loop.resume_later(waiter.handle);
+    }
+
+    // what is queued still runs, then every pop comes back empty
+    void close() {
+        closed = true;
+        for (const auto& waiter : waiters) loop.resume_later(waiter.handle);
+        waiters.clear();
+    }
+
+    auto pop() {
+        struct Awaiter {
+            JobQueue& queue;
+            std::shared_ptr<Job> job;
+
+            bool await_ready() {
+                if (queue.jobs.empty()) return queue.closed;
+                job = std::move(queue.jobs.front());
+                queue.jobs.pop_front();
+                return true;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) { queue.waiters.push_back({ handle, &job }); }
+
+            std::shared_ptr<Job> await_resume() { return std::move(job); }
+        };
+        return Awaiter{ *this };
+    }
+
+    size_t size() const { return jobs.size(); }
+
+private:
+    struct Waiter {
+        std::coroutine_handle<> handle;
+        std::shared_ptr<Job>* slot;
+    };
+
+    EventLoop& loop;
+    std::deque<std::shared_ptr<Job>> jobs;
+    std::deque<Waiter> waiters;
+    bool closed = false;
+};
+
+struct ServerState {
+    ServerState(AgentEnv& env, const AgentOptions& defaults) : env(env), defaults(defaults), queue(env.executor.loop()) {}
+
+    AgentEnv& env;
+    const AgentOptions& defaults;
+    std::string token; // empty when connections need none
+    JobQueue queue;
+    size_t workers = 0;
+    size_t running = 0;
+    size_t served = 0;
+    size_t next_id = 0;
+};
+
+struct HttpRequest {
+    std::string method;
+    std::string path;
+    std::string body;
+    bool keep_alive = true;
+    bool expect_continue = false;
+    std::string authorization;
+    std::string bad; // why the request can not be served, it gets a 400
+};
+
+// looks at every byte, so the time taken says nothing about where a guess went wrong
+bool token_matches(std::string_view given, std::string_view token) {
+    if (given.size() != token.size()) return false;
+    unsigned char diff = 0;
+    for (size_t i = 0; i < token.size(); ++i) {
+        diff |= static_cast<unsigned char>(given[i] ^ token[i]);
+    }
+    return diff == 0;
+}
+
+std::shared_ptr<Job> submit(ServerState& state, const std::string& text) {
+    auto job = std::make_shared<Job>();
+    job->task = parse_batch_task(text, ++state.next_id);
+
+    if (!job->task.error.empty()) {
+        AgentResult result;
+        result.status = AgentResult::Status::Error;
+        result.error = job->task.error;
+        job->result = batch_result(job->task.id, result);
+        job->done.set();
+    }
+    else {
+        state.queue.push(job);
+    }
+    return job;
+}
+
+// pulls jobs until the server stops, `workers` of these share the loop
+Task<void> serve_worker(ServerState& state) {
+    while (true) {
+        std::shared_ptr<Job> job = co_await state.queue.pop();
+        if (!job) break;
+
+        state.running++;
+        AgentResult result;
+        try {
+            result = co_await run_agent(state.env, task_options(state.defaults, job->task), job->task.prompt);
+        }
+        catch (const std::exception& e) {
+            result.status = AgentResult::Status::Error;
+            result.error = e.what();
+        }
+        state.running--;
+        state.served++;
+
+        job->result = batch_result(job->task.id, result);
+        job->done.set();
+    }
+}
+
+// one writer per connection, so replies never interleave
+Task<void> flush(EventLoop& loop, std::shared_ptr<Connection> conn) {
+    conn->flushing = true;
+    while (!conn->outbox.empty() && !conn->broken) {
+        ssize_t n = ::send(conn->fd, conn->outbox.data(), conn->outbox.size(), MSG_NOSIGNAL);
+        if (n > 0) {
+            conn->outbox.erase(0, static_cast<size_t>(n));
+        }
+        else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            pollfd pfd{ conn->fd, POLLOUT, 0 };
+            co_await loop.poll(&pfd, 1, POLL_MS);
+        }
+        else {
+            conn->broken = true;
+        }
+    }
+    conn->flushing = false;
+}
+
+void send_reply(EventLoop& loop, const std::shared_ptr<Connection>& conn, std::string_view text) {
+    if (conn->broken) return;
+    conn->outbox.append(text);
+    if (!conn->flushing) loop.spawn(flush(loop, conn));
+}
+
+std::string dump_line(const json& record) {
+    return record.dump(-1, ' ', false, json::error_handler_t::replace) + "\n";
+}
+
+Task<void> reply_line(EventLoop& loop, std::shared_ptr<Connection> conn, std::shared_ptr<Job> job) {
+    co_await job->done.wait();
+    send_reply(loop, conn, dump_line(job->result));
+}
+
+std::string http_response(int status, std::string_view reason, std::string_view body, bool keep_alive) {
+    std::string out = "HTTP/1.1 " + std::to_string(status) + " " + std::string(reason) + "\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    if (!keep_alive) out += "Connection: close\r\n";
+    out += "\r\n";
+    out.append(body);
+    return out;
+}
+
+bool header_is(std::string_view line, std::string_view name, std::string_view& value) {
+    if (line.size() <= name.size() || line[name.size()] != ':') return false;
+    if (::strncasecmp(line.data(), name.data(), name.size()) != 0) return false;
+    value = line.substr(name.size() + 1);
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+    return true;
+}
+
+bool equals_nocase(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && ::strncasecmp(a.data(), b.data(), a.size()) == 0;
+}
+
+// bytes of buffer the request took, 0 while it is not all there
+size_t parse_http(const std::string& buffer, HttpRequest& request) {
+    size_t head_end = buffer.find("\r\n\r\n");
+    if (head_end == std::string::npos) return 0;
+
+    request = HttpRequest{};
+    std::string_view head(buffer.data(), head_end);
+    size_t line_end = head.find("\r\n");
+    std::string_view request_line = head.substr(0, line_end);
+
+    size_t first_space = request_line.find(' ');
+    size_t second_space = request_line.find(' ', first_space + 1);
+    if (first_space == std::string_view::npos || second_space == std::string_view::npos) {
+        request.bad = "malformed request line";
+        return head_end + 4;
+    }
+    request.method = request_line.substr(0, first_space);
+    request.path = request_line.substr(first_space + 1, second_space - first_space - 1);
+    request.keep_alive = request_line.substr(second_space + 1) != "HTTP/1.0";
+
+    size_t content_length = 0;
+    while (line_end != std::string_view::npos && line_end < head.size()) {
+        size_t next = head.find("\r\n", line_end + 2);
+        std::string_view line = head.substr(line_end + 2, (next == std::string_view::npos ? head.size() : next) - line_end - 2);
+        std::string_view value;
+        if (header_is(line, "Content-Length", value)) {
+            content_length = std::strtoull(std::string(value).c_str(), nullptr, 10);
+        }
+        else if (header_is(line, "Connection", value)) {
+            if (equals_nocase(value, "close")) request.keep_alive = false;
+            if (equals_nocase(value, "keep-alive")) request.keep_alive = true;
+        }
+        else if (header_is(line, "Transfer-Encoding", value)) {
+            request.bad = "chunked bodies are not supported, send Content-Length";
+        }
+        else if (header_is(line, "Expect", value)) {
+            request.expect_continue = equals_nocase(value, "100-continue");
+        }
+        else if (header_is(line, "Authorization", value)) {
+            request.authorization = value;
+        }
+        line_end = next;
+    }
+
+    if (!request.bad.empty()) {
+        request.keep_alive = false;
+        return head_end + 4;
+    }
+    if (content_length > MAX_REQUEST_BYTES) {
+        request.bad = "request body too large";
+        request.keep_alive = false;
+        return head_end + 4;
+    }
+
+    const size_t total = head_end + 4 + content_length;
+    if (buffer.size() < total) return 0;
+
+    request.expect_continue = false;
+    request.body = buffer.substr(head_end + 4, content_length);
+    return total;
+}
+
+// answers one http request, a job is waited for so replies stay in request order
+Task<void> handle_http(ServerState& state, std::shared_ptr<Connection> conn, HttpRequest request) {
+    EventLoop& loop = state.env.executor.loop();
+
+    if (!request.bad.empty()) {
+        json error = { {"error", request.bad} };
+        send_reply(loop, conn, http_response(400, "Bad Request", error.dump(), request.keep_alive));
+        co_return;
+    }
+
+    if (!conn->authorized) {
+        const std::string_view BEARER = "Bearer ";
+        std::string_view given = request.authorization;
+        if (!given.starts_with(BEARER) || !token_matches(given.substr(BEARER.size()), state.token)) {
+            json error = { {"error", "missing or wrong Authorization: Bearer token"} };
+            send_reply(loop, conn, http_response(401, "Unauthorized", error.dump(), request.keep_alive));
+            co_return;
+        }
+    }
+
+    if (request.method == "GET" && request.path == "/health") {
+        json health = {
+            {"status", stop_requested ? "stopping" : "ok"},
+            {"workers", state.workers},
+            {"running", state.running},
+            {"queued", state.queue.size()},
+            {"served", state.served},
+        };
+        send_reply(loop, conn, http_response(200, "OK", health.dump(), request.keep_alive));
+        co_return;
+    }
+
+    if (request.method == "POST" && request.path == "/jobs") {
+        std::shared_ptr<Job> job = submit(state, request.body);
+        co_await job->done.wait();
+
+        const bool malformed = !job->task.error.empty();
+        std::string body = dump_line(job->result);
+        if (malformed) {
+            send_reply(loop, conn, http_response(400, "Bad Request", body, request.keep_alive));
+        }
+        else {
+            send_reply(loop, conn, http_response(200, "OK", body, request.keep_alive));
+        }
+        co_return;
+    }
+
+    json error = { {"error", "use POST /jobs or GET /health"} };
+    send_reply(loop, conn, http_response(404, "Not Found", error.dump(), request.keep_alive));
+}
+
+Task<void> serve_connection(ServerState& state, std::shared_ptr<Connection> conn) {
+    EventLoop& loop = state.env.executor.loop();
+    std::string buffer;
+    std::vector<char> chunk(64 * 1024);
+
+    // decided by the first byte: a job line starts with '{', anything else is http
+    bool decided = false;
+    bool http = false;
+    bool open = true;
+    bool continued = false;
+
+    while (open && !stop_requested && !conn->broken) {
+        if (!decided) {
+            size_t first = buffer.find_first_not_of(" \t\r\n");
+            if (first != std::string::npos) {
+                decided = true;
+                http = buffer[first] != '{';
+            }
+        }
+
+        if (decided && !http) {
+            size_t newline;
+            while ((newline = buffer.find('\n')) != std::string::npos) {
+                std::string line = buffer.substr(0, newline);
+                buffer.erase(0, newline + 1);
+                if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+                // the first line opens the connection, a line with nothing but the token is no job
+                if (!conn->authorized) {
+                    json first = json::parse(line, nullptr, false);
+                    if (!first.is_object() || !first.contains("token") || !first["token"].is_string() ||
+                        !token_matches(first["token"].get_ref<const std::string&>(), state.token))
+                    {
+                        json error = { {"error", "the first line needs the server's \"token\""} };
+                        send_reply(loop, conn, dump_line(error));
+                        open = false;
+                        break;
+                    }
+                    conn->authorized = true;
+                    if (first.size() == 1) continue;
+                }
+
+                loop.spawn(reply_line(loop, conn, submit(state, line)));
+            }
+            if (!open) break;
+        }
+        else if (decided) {
+            HttpRequest request;
+            size_t used;
+            while (open && (used = parse_http(buffer, request)) > 0) {
+                buffer.erase(0, used);
+                continued = false;
+                open = request.keep_alive;
+                co_await handle_http(state, conn, std::move(request));
+            }
+            if (!open) break;
+
+            // curl holds back bigger bodies until it is told to go on
+            if (request.expect_continue && !continued) {
+                continued = true;
+                send_reply(loop, conn, "HTTP/1.1 100 Continue\r\n\r\n");
+            }
+        }
+
+        if (buffer.size() > MAX_REQUEST_BYTES) {
+            if (http) {
+                json error = { {"error", "request too large"} };
+                send_reply(loop, conn, http_response(400, "Bad Request", error.dump(), false));
+            }
+            break;
+        }
+
+        pollfd pfd{ conn->fd, POLLIN, 0 };
+        int ready = co_await loop.poll(&pfd, 1, POLL_MS);
+        if (ready <= 0) continue;
+
+        ssize_t n = ::recv(conn->fd, chunk.data(), chunk.size(), 0);
+        if (n == 0) break;
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+            break;
+        }
+        buffer.append(chunk.data(), static_cast<size_t>(n));
+    }
+    // the socket closes once the last pending reply has gone out
+}
+
+Task<void> accept_loop(ServerState& state, int listen_fd) {
+    EventLoop& loop = state.env.executor.loop();
+
+    while (!stop_requested) {
+        pollfd pfd{ listen_fd, POLLIN, 0 };
+        int ready = co_await loop.poll(&pfd, 1, POLL_MS);
+        if (ready <= 0) continue;
+
+        int fd = ::accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) continue;
+
+        // tool children must not keep a client's connection open
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+        auto conn = std::make_shared<Connection>(fd);
+        conn->authorized = state.token.empty();
+        loop.spawn(serve_connection(state, std::move(conn)));
+    }
+
+    state.queue.close();
+}
+
+bool is_loopback(const sockaddr* addr) {
+    if (addr->sa_family == AF_INET) {
+        const auto* in = reinterpret_cast<const sockaddr_in*>(addr);
+        return (ntohl(in->sin_addr.s_addr) >> 24) == 127;
+    }
+    if (addr->sa_family == AF_INET6) {
+        const auto* in6 = reinterpret_cast<const sockaddr_in6*>(addr);
+        if (IN6_IS_ADDR_LOOPBACK(&in6->sin6_addr)) return true;
+        // ::ffff:127.x.x.x
+        return IN6_IS_ADDR_V4MAPPED(&in6->sin6_addr) && in6->sin6_addr.s6_addr[12] == 127;
+    }
+    return false;
+}
+
+// -1 with error set when the address can not be listened on
+int listen_on(const std::string& address, bool allow_remote, std::string& socket_path, std::string& error) {
+    int fd = -1;
+
+    if (is_unix_address(address)) {
+        socket_path = address.rfind("unix:", 0) == 0 ? address.substr(5) : address;
+
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (socket_path.empty() || socket_path.size() >= sizeof(addr.sun_path)) {
+            error = "unix socket path must be 1 to " + std::to_string(sizeof(addr.sun_path) - 1) + " bytes";
+            return -1;
+        }
+        std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+        // a socket left behind by a server that died, anything else is not ours to remove
+        struct stat st;
+        if (::lstat(socket_path.c_str(), &st) == 0) {
+            if (!S_ISSOCK(st.st_mode)) {
+                error = socket_path + " exists and is not a socket";
+                return -1;
+            }
+            ::unlink(socket_path.c_str());
+        }
+
+        fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            error = "could not bind " + socket_path + ": " + std::strerror(errno);
+            if (fd >= 0) ::close(fd);
+            return -1;
+        }
+    }
+    else {
+        size_t colon = address.rfind(':');
+        std::string host = colon == std::string::npos ? "127.0.0.1" : address.substr(0, colon);
+        std::string port = colon == std::string::npos ? address : address.substr(colon + 1);
+        if (host.size() > 2 && host.front() == '[' && host.back() == ']') host = host.substr(1, host.size() - 2);
+
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        addrinfo* found = nullptr;
+        if (int rc = ::getaddrinfo(host.c_str(), port.c_str(), &hints, &found); rc != 0) {
+            error = "could not resolve " + address + ": " + ::gai_strerror(rc);
+            return -1;
+        }
+
+        for (addrinfo* ai = found; ai; ai = ai->ai_next) {
+            // anyone who can reach the port can run commands as this user
+            if (!allow_remote && !is_loopback(ai->ai_addr)) {
+                error = "refusing to serve on " + address + ", it is not a loopback address (--serve-remote allows it)";
+                continue;
+            }
+            fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd < 0) continue;
+            int one = 1;
+            ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (::bind(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+            error = "could not bind " + address + ": " + std::strerror(errno);
+            ::close(fd);
+            fd = -1;
+        }
+        ::freeaddrinfo(found);
+        if (fd < 0) {
+            if (error.empty()) error = "could not bind " + address;
+            return -1;
+        }
+    }
+
+    if (::listen(fd, 128) != 0) {
+        error = "could not listen on " + address + ": " + std::strerror(errno);
+        ::close(fd);
+        return -1;
+    }
+
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+}
+
+bool is_unix_address(const std::string& address) {
+    return address.rfind("unix:", 0) == 0 || address.find('/') != std::string::npos;
+}
+
+int run_server(AgentEnv& env, const AgentOptions& defaults, const ServeOptions& options) {
+    const bool tcp = !is_unix_address(options.address);
+    if (tcp && options.token.empty()) {
+        std::cerr << "a tcp server needs a token, jobs can run commands" << std::endl;
+        return 1;
+    }
+
+    std::string socket_path;
+    std::string error;
+    int listen_fd = listen_on(options.address, options.allow_remote, socket_path, error);
+    if (listen_fd < 0) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    // no SA_RESTART, a stop interrupts whatever the loop is blocked in
+    struct sigaction action {};
+    action.sa_handler = request_stop;
+    sigemptyset(&action.sa_mask);
+    ::sigaction(SIGINT, &action, nullptr);
+    ::sigaction(SIGTERM, &action, nullptr);
+    ::signal(SIGPIPE, SIG_IGN);
+
+    EventLoop& loop = env.executor.loop();
+    ServerState state(env, defaults);
+    if (tcp) state.token = options.token;
+
+    // no point in more workers than clients to hand out
+    state.workers = std::min(std::max<size_t>(1, options.workers), env.clients.size());
+    for (size_t i = 0; i < state.workers; ++i) {
+        loop.spawn(serve_worker(state));
+    }
+    loop.spawn(accept_loop(state, listen_fd));
+
+    std::cerr << "serving on " << options.address << " with " << state.workers << " workers" << std::endl;
+    loop.run();
+
+    ::close(listen_fd);
+    if (!socket_path.empty()) ::unlink(socket_path.c_str());
+    std::cerr << "stopped after " << state.served << " jobs" << std::endl;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+
+#include "agent.hpp"
+
+struct ServeOptions {
+    // a path (anything with a '/', or unix:path) is a unix socket,
+    // [host:]port is tcp, host defaults to 127.0.0.1
+    std::string address;
+    size_t workers = 4;
+    // every job may run commands, so a tcp connection has to present this
+    // (required for tcp). a unix socket is guarded by its file permissions
+    std::string token;
+    // tcp on anything but a loopback address, open to the whole network
+    bool allow_remote = false;
+};
+
+// unix socket rather than tcp, see ServeOptions::address
+bool is_unix_address(const std::string& address);
+
+// keeps the process warm between jobs: `workers` conversations at a time run
+// on the env's loop, every one of them on the same client pool (so the
+// connections stay open), registry and tool threads.
+//
+// a connection either sends batch style lines, {"id", "prompt"[, "max_iterations", "sandbox"]},
+// and gets one result line per job as it finishes (in any order), or speaks
+// http/1.1: POST /jobs with the same object as body answers with the result,
+// GET /health with the queue state.
+// over tcp the first line carries a "token" field (on a job, or alone as
+// {"token"}), http requests an "Authorization: Bearer <token>" header.
+// runs until SIGINT / SIGTERM, then finishes the jobs it took. 0 on a clean stop
+int run_server(AgentEnv& env, const AgentOptions& defaults, const ServeOptions& options);
@@ -0,0 +1,76 @@
+#include "shell_tool.hpp"
+
+#include <chrono>
+
+#include "bash_tool.hpp"
+
+void ShellTool::execute(const json& args, const ToolContext& ctx, std::string& out) {
+    std::string command;
+    SubprocessOptions options;
+    if (!prepare(args, ctx, command, options, out)) return;
+
+    ShellResult run = ctx.shell->run(command, options);
+    format(run, options, out);
+}
+
+#ifndef _WIN32
+Task<void> ShellTool::execute_async(const json& args, const ToolContext& ctx, std::string& out) {
+    if (!ctx.loop) {
+        execute(args, ctx, out);
+        co_return;
+    }
+
+    std::string command;
+    SubprocessOptions options;
+    if (!prepare(args, ctx, command, options, out)) co_return;
+
+    ShellResult run = co_await ctx.shell->run_async(*ctx.loop, command, options);
+    format(run, options, out);
+}
+#endif
+
+bool ShellTool::prepare(const json& args, const ToolContext& ctx, std::string& command,
+                        SubprocessOptions& options, std::string& out)
+{
+    if (!ctx.shell) {
+        out = "ERROR: no shell session in this conversation, use bash.";
+        return false;
+    }
+    if (!BashTool::prepare(args, command, options, out)) return false;
+    options.sandbox = ctx.sandbox;
+
+    if (args.contains("restart") && args["restart"].is_boolean() && args["restart"].get<bool>()) {
+        ctx.shell->reset();
+    }
+    return true;
+}
+
+void ShellTool::format(const ShellResult& run, const SubprocessOptions& options, std::string& out) {
+    if (!run.error.empty() && run.out.total() == 0 && run.err.total() == 0) {
+        out = "ERROR: " + run.error;
+        return;
+    }
+
+    out.clear();
+    out.reserve(160 + run.out.text_size() + run.err.text_size());
+
+    out += "EXIT_CODE: ";
+    out += std::to_string(run.exit_code);
+    out += "\n";
+    if (run.timed_out) {
+        out += "TIMED_OUT: interrupted after ";
+        out += std::to_string(std::chrono::duration_cast<std::chrono::seconds>(options.timeout).count());
+        out += "s\n";
+    }
+    if (run.shell_reset) {
+        out += "SHELL_RESET: the shell ";
+        out += run.timed_out ? "ignored ^C and was killed" : "exited";
+        out += ", the next call starts a new one (working directory and environment are back to the start)\n";
+    }
+    out += "OUTPUT:\n";
+    run.out.append_to(out);
+    if (run.err.total() > 0) {
+        out += "\nSTDERR:\n";
+        run.err.append_to(out);
+    }
+}
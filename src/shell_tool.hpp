@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include "subprocess.hpp"
+#include "tool.hpp"
+
+using json = nlohmann::json;
+
+// bash, but every call of a conversation runs in the same shell (ToolContext::shell)
+class ShellTool : public Tool {
+public:
+    static constexpr ToolParam PARAMS[] = {
+        { "command", "string", "Shell command to execute", true },
+        { "timeout", "number", "Seconds before the command gets ^C (default 120, max 600)" },
+        { "restart", "boolean", "Start a fresh shell before running the command" },
+    };
+    static constexpr ToolSpec SPEC{
+        "shell",
+        "Execute a command in a persistent shell: the working directory, environment variables and activated virtualenvs stay from one call to the next. Returns exit code, stdout and stderr",
+        PARAMS
+    };
+
+    const ToolSpec& spec() const override { return SPEC; }
+
+    // one shell runs one command at a time, and in the order they were asked for.
+    // the command can touch any file, so nothing else overlaps it either
+    ToolAccess access(const json& args) const override { return { "", true }; }
+    void execute(const json& args, const ToolContext& ctx, std::string& out) override;
+
+#ifndef _WIN32
+    Task<void> execute_async(const json& args, const ToolContext& ctx, std::string& out) override;
+#endif
+
+private:
+    static bool prepare(const json& args, const ToolContext& ctx, std::string& command,
+                        SubprocessOptions& options, std::string& out);
+    static void format(const ShellResult& run, const SubprocessOptions& options, std::string& out);
+};
@@ -0,0 +1,170 @@
+#include "sse_stream.hpp"
+
+#include <cstdint>
+
+void SseParser::feed(std::string_view bytes) {
+    pending.append(bytes);
+
+    size_t start = 0;
+    size_t nl;
+    while (!finished && (nl = pending.find('\n', start)) != std::string::npos) {
+        std::string_view line(pending.data() + start, nl - start);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        handle_line(line);
+        start = nl + 1;
+    }
+
+    pending.erase(0, start);
+}
+
+void SseParser::handle_line(std::string_view line) {
+    // blank line ends the event
+    if (line.empty()) {
+        if (data.empty()) return;
+
+        if (data == "[DONE]") {
+            finished = true;
+        }
+        else if (on_event) {
+            on_event(data);
+        }
+        data.clear();
+        return;
+    }
+
+    // ": comment" keep-alives (openrouter sends ": OPENROUTER PROCESSING")
+    if (line.front() == ':') return;
+
+    if (line.starts_with("data:")) {
+        line.remove_prefix(5);
+        if (!line.empty() && line.front() == ' ') {
+            line.remove_prefix(1);
+        }
+        if (!data.empty()) data += '\n';
+        data.append(line);
+    }
+    // event:, id:, retry: are not used by chat completions
+}
+
+void StreamAssembler::apply(const json& chunk) {
+    // a broken stream stays broken, nothing after it is trusted
+    if (!error_.empty()) return;
+
+    if (chunk.contains("error")) {
+        const json& err = chunk["error"];
+        error_ = err.is_object() && err.contains("message") && err["message"].is_string()
+            ? err["message"].get<std::string>()
+            : err.dump();
+        return;
+    }
+
+    if (chunk.contains("usage") && chunk["usage"].is_object()) {
+        usage_ = chunk["usage"];
+    }
+
+    if (!chunk.contains("choices") || !chunk["choices"].is_array() || chunk["choices"].empty()) {
+        return;
+    }
+
+    const json& choice = chunk["choices"][0];
+
+    if (choice.contains("delta") && choice["delta"].is_object()) {
+        const json& delta = choice["delta"];
+
+        if (delta.contains("content") && delta["content"].is_string()) {
+            const std::string& piece = delta["content"].get_ref<const std::string&>();
+            has_content = true;
+            content += piece;
+            if (on_content && !piece.empty()) on_content(piece);
+        }
+
+        if (delta.contains("tool_calls") && delta["tool_calls"].is_array()) {
+            for (const auto& part : delta["tool_calls"]) {
+                if (!part.is_object()) {
+                    error_ = "malformed stream: tool call delta is not an object";
+                    return;
+                }
+
+                // the index comes from the provider: a string would throw, a huge
+                // one would grow tool_calls until memory runs out
+                size_t index = tool_calls.size() ? tool_calls.size() - 1 : 0;
+                if (part.contains("index")) {
+                    const json& given = part["index"];
+                    if (!given.is_number_integer() || given.get<int64_t>() < 0 ||
+                        static_cast<uint64_t>(given.get<int64_t>()) > tool_calls.size())
+                    {
+                        error_ = "malformed stream: bad tool call index " + given.dump();
+                        return;
+                    }
+                    index = static_cast<size_t>(given.get<int64_t>());
+                }
+
+                // the call already runs with the arguments it had, history must not say otherwise
+                if (index < ready) {
+                    error_ = "malformed stream: delta for tool call " + std::to_string(index) + " after it was started";
+                    return;
+                }
+
+                // a delta for a later index means every earlier call is complete
+                close_tool_calls(index);
+
+                while (tool_calls.size() <= index) {
+                    tool_calls.push_back({
+                        {"id", ""},
+                        {"type", "function"},
+                        {"function", {{"name", ""}, {"arguments", ""}}}
+                    });
+                }
+
+                json& call = tool_calls[index];
+                if (part.contains("id") && part["id"].is_string()) {
+                    call["id"] = part["id"];
+                }
+                if (part.contains("function") && part["function"].is_object()) {
+                    const json& fn = part["function"];
+                    if (fn.contains("name") && fn["name"].is_string()) {
+                        call["function"]["name"].get_ref<std::string&>() += fn["name"].get_ref<const std::string&>();
+                    }
+                    if (fn.contains("arguments") && fn["arguments"].is_string()) {
+                        call["function"]["arguments"].get_ref<std::string&>() += fn["arguments"].get_ref<const std::string&>();
+                    }
+                }
+            }
+        }
+    }
+
+    if (choice.contains("finish_reason") && choice["finish_reason"].is_string()) {
+        finish_reason_ = choice["finish_reason"];
+        close_tool_calls(tool_calls.size());
+    }
+}
+
+void StreamAssembler::finish() {
+    close_tool_calls(tool_calls.size());
+}
+
+void StreamAssembler::close_tool_calls(size_t upto) {
+    while (ready < upto && ready < tool_calls.size()) {
+        if (on_tool_call) on_tool_call(tool_calls[ready]);
+        ready++;
+    }
+}
+
+json StreamAssembler::take_message() {
+    json message = json::object();
+    message["role"] = "assistant";
+    message["content"] = has_content ? json(std::move(content)) : json(nullptr);
+
+    if (!tool_calls.empty()) {
+        json calls = json::array();
+        for (auto& call : tool_calls) {
+            calls.push_back(std::move(call));
+        }
+        message["tool_calls"] = std::move(calls);
+        tool_calls.clear();
+    }
+
+    return message;
+}
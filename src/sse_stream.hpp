@@ -0,0 +1,60 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// splits a text/event-stream body into events, bytes can arrive in any chunking
+class SseParser {
+public:
+    // called with the joined "data:" payload of every complete event
+    std::function<void(std::string_view)> on_event;
+
+    void feed(std::string_view bytes);
+    bool done() const { return finished; }
+
+private:
+    void handle_line(std::string_view line);
+
+    std::string pending;
+    std::string data;
+    bool finished = false;
+};
+
+// rebuilds one assistant message out of chat.completion.chunk deltas
+class StreamAssembler {
+public:
+    // printed as it comes in
+    std::function<void(std::string_view)> on_content;
+    // fired once per tool call as soon as its arguments can no longer grow
+    std::function<void(const json& call)> on_tool_call;
+
+    // a malformed chunk sets error() and every later one is ignored
+    void apply(const json& chunk);
+    // flush whatever tool calls are still open, call once the stream is over
+    void finish();
+
+    // moves the assembled content and tool calls out, call once at the end
+    json take_message();
+    const json& usage() const { return usage_; }
+    const std::string& finish_reason() const { return finish_reason_; }
+    const std::string& error() const { return error_; }
+    // marks the stream broken from outside, a chunk that could not be handled
+    void fail(std::string reason) { error_ = "malformed stream: " + std::move(reason); }
+
+private:
+    void close_tool_calls(size_t upto);
+
+    std::string content;
+    bool has_content = false;
+    std::vector<json> tool_calls;
+    size_t ready = 0;
+    json usage_;
+    std::string finish_reason_;
+    std::string error_;
+};
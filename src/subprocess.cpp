@@ -0,0 +1,706 @@
+#include "subprocess.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <random>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+#include "sandbox.hpp"
+
+BoundedCapture::BoundedCapture(size_t head_limit, size_t tail_limit)
+    : head_limit(head_limit), tail_limit(tail_limit)
+{
+}
+
+void BoundedCapture::append(std::string_view data) {
+    total_ += data.size();
+
+    if (head.size() < head_limit) {
+        size_t take = std::min(head_limit - head.size(), data.size());
+        head.append(data.substr(0, take));
+        data.remove_prefix(take);
+    }
+
+    if (data.empty() || tail_limit == 0) return;
+
+    // only the last tail_limit bytes of this chunk can survive anyway
+    if (data.size() > tail_limit) {
+        data.remove_prefix(data.size() - tail_limit);
+    }
+
+    if (tail.size() < tail_limit) {
+        tail.resize(tail_limit);
+    }
+
+    size_t first = std::min(data.size(), tail_limit - tail_pos);
+    std::copy(data.begin(), data.begin() + first, tail.begin() + tail_pos);
+    std::copy(data.begin() + first, data.end(), tail.begin());
+    tail_pos = (tail_pos + data.size()) % tail_limit;
+    tail_size = std::min(tail_size + data.size(), tail_limit);
+}
+
+std::string BoundedCapture::text() const {
+    std::string out;
+    out.reserve(text_size());
+    append_to(out);
+    return out;
+}
+
+void BoundedCapture::append_to(std::string& out) const {
+    out += head;
+
+    if (truncated()) {
+        out += "\n... [" + std::to_string(total_ - head.size() - tail_size) + " bytes elided] ...\n";
+    }
+
+    if (tail_size < tail_limit) {
+        out.append(tail, 0, tail_size);
+    }
+    else {
+        out.append(tail, tail_pos, std::string::npos);
+        out.append(tail, 0, tail_pos);
+    }
+}
+
+#ifdef _WIN32
+
+// no posix_spawn/poll here, keep the old blocking popen path (stdout only, no timeout)
+SubprocessResult run_subprocess(const std::string& command, const SubprocessOptions& options) {
+    SubprocessResult result;
+    result.out = BoundedCapture(options.head_bytes, options.tail_bytes);
+    result.err = BoundedCapture(options.head_bytes, options.tail_bytes);
+
+    FILE* pipe = _popen(command.c_str(), "r");
+    if (!pipe) {
+        result.error = "failed to execute command.";
+        return result;
+    }
+
+    std::array<char, 4096> buffer;
+    size_t n;
+    while ((n = fread(buffer.data(), 1, buffer.size(), pipe)) > 0) {
+        result.out.append(std::string_view(buffer.data(), n));
+    }
+
+    result.exit_code = _pclose(pipe);
+    return result;
+}
+
+ShellResult ShellSession::run(const std::string& command, const SubprocessOptions& options) {
+    ShellResult result;
+    static_cast<SubprocessResult&>(result) = run_subprocess(command, options);
+    return result;
+}
+
+void ShellSession::interrupt() {}
+
+void ShellSession::reset() {}
+
+#else
+
+namespace {
+
+bool make_pipe(int fds[2]) {
+#ifdef __linux__
+    // O_CLOEXEC atomically, parallel tool calls spawn from several threads
+    return pipe2(fds, O_CLOEXEC) == 0;
+#else
+    if (pipe(fds) != 0) return false;
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+#endif
+}
+
+int decode_status(int status) {
+    if (WIFEXITED(status)) return WEXITSTATUS(status);
+    if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+    return -1;
+}
+
+// one `sh -c` child and the read side of its pipes. the sync and the async
+// runner only differ in how they wait between steps
+class ShellRun {
+public:
+    using clock = std::chrono::steady_clock;
+
+    ShellRun(SubprocessResult& result, const SubprocessOptions& options)
+        : result(result), options(options)
+    {
+    }
+
+    ~ShellRun() {
+        close_fds();
+        close_exit_fd();
+    }
+
+    // false with result.error set when the child could not be started
+    bool start(const std::string& command);
+
+    // ms to wait for output (or only for the exit once the pipes are closed)
+    // before the next step, -1 once the child is reaped or the deadline passed
+    int next_wait();
+
+    // reads whatever the last wait found, notices the shell exiting
+    void step();
+
+    void close_fds();
+    void close_exit_fd();
+
+    // the pipes, and once both are closed the child's pidfd (nothing where there is none)
+    pollfd* poll_fds() { return open_fds > 0 ? fds : &exit_fd; }
+    size_t poll_count() const { return open_fds > 0 ? 2 : (exit_fd.fd >= 0 ? 1 : 0); }
+
+    bool timed_out() const { return result.timed_out; }
+    void terminate() { kill(-pid, SIGTERM); }
+    void kill_group() { kill(-pid, SIGKILL); }
+
+    bool try_reap() {
+        if (!reaped && waitpid(pid, &status, WNOHANG) == pid) reaped = true;
+        return reaped;
+    }
+
+    // a child stuck in the kernel past KILL_STEPS is left behind and reported killed
+    void finish() { result.exit_code = reaped ? decode_status(status) : 128 + SIGKILL; }
+
+private:
+    SubprocessResult& result;
+    const SubprocessOptions& options;
+
+    pid_t pid = -1;
+    pollfd fds[2] = { { -1, POLLIN, 0 }, { -1, POLLIN, 0 } };
+    int open_fds = 0;
+    pollfd exit_fd = { -1, POLLIN, 0 }; // readable once the child exits
+
+    clock::time_point deadline;
+    clock::time_point exited_at = clock::time_point::max();
+    int exit_poll_ms = 1; // without a pidfd, backs off while a child without pipes runs on
+    bool reaped = false;
+    int status = 0;
+    std::array<char, 64 * 1024> buffer;
+};
+
+// 10 ms steps a timed out group gets between SIGTERM and SIGKILL, and to be reaped after that
+const int TERM_STEPS = 20;
+const int KILL_STEPS = 100;
+
+bool ShellRun::start(const std::string& command) {
+    result.out = BoundedCapture(options.head_bytes, options.tail_bytes);
+    result.err = BoundedCapture(options.head_bytes, options.tail_bytes);
+
+    int out_pipe[2];
+    int err_pipe[2];
+    if (!make_pipe(out_pipe)) {
+        result.error = std::string("pipe failed: ") + std::strerror(errno);
+        return false;
+    }
+    if (!make_pipe(err_pipe)) {
+        result.error = std::string("pipe failed: ") + std::strerror(errno);
+        close(out_pipe[0]);
+        close(out_pipe[1]);
+        return false;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, out_pipe[1], 1);
+    posix_spawn_file_actions_adddup2(&actions, err_pipe[1], 2);
+
+    // own process group, so a timeout takes down everything the shell started
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attr, 0);
+
+    std::string shell = "/bin/sh";
+    std::string flag = "-c";
+    std::string cmd = command;
+    char* argv[] = { shell.data(), flag.data(), cmd.data(), nullptr };
+
+    int rc;
+    if (options.sandbox) {
+        int dev_null = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+        rc = dev_null < 0 ? errno : options.sandbox->spawn(shell.c_str(), argv, dev_null, out_pipe[1], err_pipe[1], pid);
+        if (dev_null >= 0) close(dev_null);
+    }
+    else {
+        rc = posix_spawn(&pid, shell.c_str(), &actions, &attr, argv, environ);
+    }
+
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    close(out_pipe[1]);
+    close(err_pipe[1]);
+
+    if (rc != 0) {
+        result.error = std::string("failed to execute command: ") + std::strerror(rc);
+        close(out_pipe[0]);
+        close(err_pipe[0]);
+        return false;
+    }
+
+    fcntl(out_pipe[0], F_SETFL, fcntl(out_pipe[0], F_GETFL) | O_NONBLOCK);
+    fcntl(err_pipe[0], F_SETFL, fcntl(err_pipe[0], F_GETFL) | O_NONBLOCK);
+
+    fds[0].fd = out_pipe[0];
+    fds[1].fd = err_pipe[0];
+    open_fds = 2;
+#if defined(__linux__) && defined(SYS_pidfd_open)
+    // linux 5.3+, older kernels poll for the exit instead
+    exit_fd.fd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    if (exit_fd.fd >= 0) fcntl(exit_fd.fd, F_SETFD, FD_CLOEXEC);
+#endif
+    deadline = clock::now() + options.timeout;
+    return true;
+}
+
+int ShellRun::next_wait() {
+    // a background job that keeps the pipe open must not hold us after the shell is gone
+    const auto linger = std::chrono::milliseconds(250);
+
+    auto now = clock::now();
+    if (reaped && (open_fds == 0 || now >= exited_at + linger)) {
+        return -1;
+    }
+    // also for a child that closed or redirected its pipes, it is not done until reaped
+    if (now >= deadline) {
+        result.timed_out = true;
+        return -1;
+    }
+
+    auto wait_until = reaped ? std::min(deadline, exited_at + linger) : deadline;
+    // wake up now and then to notice the shell exiting while a grandchild holds the pipe
+    auto wait_ms = std::chrono::duration_cast<std::chrono::milliseconds>(wait_until - now).count();
+    int limit = 100;
+    if (open_fds == 0 && exit_fd.fd < 0) {
+        // the pipes usually close right before the exit, so look again soon
+        limit = exit_poll_ms;
+        exit_poll_ms = std::min(exit_poll_ms * 2, 100);
+    }
+    return static_cast<int>(std::clamp<long long>(wait_ms, 1, limit));
+}
+
+void ShellRun::step() {
+    BoundedCapture* sinks[2] = { &result.out, &result.err };
+
+    for (int i = 0; i < 2; ++i) {
+        if (fds[i].fd < 0 || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
+        ssize_t n = read(fds[i].fd, buffer.data(), buffer.size());
+        if (n > 0) {
+            sinks[i]->append(std::string_view(buffer.data(), static_cast<size_t>(n)));
+        }
+        else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+            close(fds[i].fd);
+            fds[i].fd = -1;
+            open_fds--;
+        }
+        fds[i].revents = 0;
+    }
+
+    if (!reaped && try_reap()) {
+        exited_at = clock::now();
+    }
+}
+
+void ShellRun::close_fds() {
+    for (auto& p : fds) {
+        if (p.fd >= 0) close(p.fd);
+        p.fd = -1;
+    }
+    open_fds = 0;
+}
+
+void ShellRun::close_exit_fd() {
+    if (exit_fd.fd >= 0) close(exit_fd.fd);
+    exit_fd.fd = -1;
+}
+
+}
+
+SubprocessResult run_subprocess(const std::string& command, const SubprocessOptions& options) {
+    SubprocessResult result;
+    ShellRun run(result, options);
+    if (!run.start(command)) return result;
+
+    for (int wait_ms; (wait_ms = run.next_wait()) >= 0;) {
+        int ready = poll(run.poll_fds(), run.poll_count(), wait_ms);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        run.step();
+    }
+    run.close_fds();
+
+    // timed out, or poll itself failed
+    if (!run.try_reap()) {
+        run.terminate();
+        for (int i = 0; i < TERM_STEPS && !run.try_reap(); ++i) {
+            usleep(10'000);
+        }
+        run.kill_group();
+
+        for (int i = 0; i < KILL_STEPS && !run.try_reap(); ++i) {
+            usleep(10'000);
+        }
+    }
+
+    run.finish();
+    return result;
+}
+
+Task<SubprocessResult> run_subprocess_async(EventLoop& loop, std::string command, SubprocessOptions options) {
+    SubprocessResult result;
+    {
+        ShellRun run(result, options);
+        if (!run.start(command)) co_return result;
+
+        for (int wait_ms; (wait_ms = run.next_wait()) >= 0;) {
+            co_await loop.poll(run.poll_fds(), run.poll_count(), wait_ms);
+            run.step();
+        }
+        run.close_fds();
+
+        if (!run.try_reap()) {
+            run.terminate();
+            for (int i = 0; i < TERM_STEPS && !run.try_reap(); ++i) {
+                co_await loop.sleep_for(std::chrono::milliseconds(10));
+            }
+            run.kill_group();
+
+            for (int i = 0; i < KILL_STEPS && !run.try_reap(); ++i) {
+                co_await loop.sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+        run.finish();
+    }
+    co_return result;
+}
+
+namespace {
+
+// 'text' for sh, quotes inside become '\''
+std::string shell_quote(std::string_view text) {
+    std::string out;
+    out.reserve(text.size() + 2);
+    out += '\'';
+    for (char c : text) {
+        if (c == '\'') out += "'\\''";
+        else out += c;
+    }
+    out += '\'';
+    return out;
+}
+
+// nothing a command prints by accident
+std::string new_marker() {
+    static std::atomic<unsigned> serial{ 0 };
+    static const unsigned seed = std::random_device{}();
+    std::mt19937_64 rng(seed + serial++);
+    char hex[17];
+    std::snprintf(hex, sizeof hex, "%016llx", static_cast<unsigned long long>(rng()));
+    return std::string("__SHELL_DONE_") + hex + "__";
+}
+
+bool send_all(int fd, std::string_view data) {
+    while (!data.empty()) {
+        ssize_t n = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data.remove_prefix(static_cast<size_t>(n));
+    }
+    return true;
+}
+
+}
+
+bool ShellSession::start(const Sandbox* sandbox, std::string& error) {
+    if (pid > 0) return true;
+
+    // stdin is a socket, so writing to a shell that just died is an error and not a SIGPIPE
+    int in_pair[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, in_pair) != 0) {
+        error = std::string("socketpair failed: ") + std::strerror(errno);
+        return false;
+    }
+    int out_pipe[2];
+    int err_pipe[2];
+    if (!make_pipe(out_pipe)) {
+        error = std::string("pipe failed: ") + std::strerror(errno);
+        close(in_pair[0]);
+        close(in_pair[1]);
+        return false;
+    }
+    if (!make_pipe(err_pipe)) {
+        error = std::string("pipe failed: ") + std::strerror(errno);
+        close(in_pair[0]);
+        close(in_pair[1]);
+        close(out_pipe[0]);
+        close(out_pipe[1]);
+        return false;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, in_pair[1], 0);
+    posix_spawn_file_actions_adddup2(&actions, out_pipe[1], 1);
+    posix_spawn_file_actions_adddup2(&actions, err_pipe[1], 2);
+
+    // own process group, an interrupt or a kill reaches everything the shell started
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attr, 0);
+
+    const bool bash = ::access("/bin/bash", X_OK) == 0;
+    std::string shell = bash ? "/bin/bash" : "/bin/sh";
+    std::string no_profile = "--noprofile";
+    std::string no_rc = "--norc";
+    char* bash_argv[] = { shell.data(), no_profile.data(), no_rc.data(), nullptr };
+    char* sh_argv[] = { shell.data(), nullptr };
+
+    pid_t child = -1;
+    char** argv = bash ? bash_argv : sh_argv;
+    int rc = sandbox ? sandbox->spawn(shell.c_str(), argv, in_pair[1], out_pipe[1], err_pipe[1], child)
+        : posix_spawn(&child, shell.c_str(), &actions, &attr, argv, environ);
+
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    close(in_pair[1]);
+    close(out_pipe[1]);
+    close(err_pipe[1]);
+
+    if (rc != 0) {
+        error = std::string("failed to start shell: ") + std::strerror(rc);
+        close(in_pair[0]);
+        close(out_pipe[0]);
+        close(err_pipe[0]);
+        return false;
+    }
+
+    fcntl(out_pipe[0], F_SETFL, fcntl(out_pipe[0], F_GETFL) | O_NONBLOCK);
+    fcntl(err_pipe[0], F_SETFL, fcntl(err_pipe[0], F_GETFL) | O_NONBLOCK);
+
+    pid = child;
+    reaped = false;
+    in_fd = in_pair[0];
+    fds[0].fd = out_pipe[0];
+    fds[1].fd = err_pipe[0];
+
+    // ^C ends the command, the shell only runs the (empty) trap and goes on.
+    // an ignored SIGINT would be inherited by every command instead
+    if (!send_all(in_fd, "trap : INT\n")) {
+        error = "shell exited right after starting.";
+        reset();
+        return false;
+    }
+    return true;
+}
+
+bool ShellSession::begin(const std::string& command, const SubprocessOptions& options, ShellResult& result) {
+    result.out = BoundedCapture(options.head_bytes, options.tail_bytes);
+    result.err = BoundedCapture(options.head_bytes, options.tail_bytes);
+
+    if (!start(options.sandbox, result.error)) return false;
+
+    const std::string marker = new_marker();
+    tags[0] = "\n" + marker + " ";
+    tags[1] = "\n" + marker + "\n";
+    held[0].clear();
+    held[1].clear();
+    done[0] = done[1] = false;
+    running = true;
+    interrupted = false;
+    lost = false;
+    lost_status = -1;
+    closed_at = clock::time_point::max();
+    deadline = clock::now() + options.timeout;
+
+    // eval keeps a syntax error in the command from taking the shell with it,
+    // and the command can not read the next one from the shell's stdin
+    std::string line = "eval " + shell_quote(command) + " </dev/null; " +
+        "printf '\\n%s %d\\n' " + marker + " \"$?\"; printf '\\n%s\\n' " + marker + " >&2\n";
+    if (!send_all(in_fd, line)) {
+        lost = true;
+    }
+    return true;
+}
+
+int ShellSession::next_wait(ShellResult& result) {
+    if (lost || (done[0] && done[1])) return -1;
+
+    auto now = clock::now();
+    if (now >= deadline) {
+        if (interrupted) {
+            // ignored the ^C, nothing short of the whole shell stops it
+            lost = true;
+            return -1;
+        }
+        result.timed_out = true;
+        interrupt();
+    }
+
+    // wake up now and then to notice the shell exiting while a background job holds the pipes
+    auto wait_ms = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+    return static_cast<int>(std::clamp<long long>(wait_ms, 1, 100));
+}
+
+void ShellSession::step(ShellResult& result) {
+    for (int i = 0; i < 2; ++i) {
+        if (fds[i].fd < 0 || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+        fds[i].revents = 0;
+
+        ssize_t n = read(fds[i].fd, buffer.data(), buffer.size());
+        if (n > 0) {
+            feed(i, std::string_view(buffer.data(), static_cast<size_t>(n)), result);
+        }
+        else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+            close(fds[i].fd);
+            fds[i].fd = -1;
+        }
+    }
+
+    int status = 0;
+    if (!lost && waitpid(pid, &status, WNOHANG) == pid) {
+        lost = true;
+        lost_status = decode_status(status);
+        reaped = true;
+        return;
+    }
+
+    // both pipes closed, give the exit status a moment to arrive
+    if (fds[0].fd < 0 && fds[1].fd < 0) {
+        auto now = clock::now();
+        if (closed_at == clock::time_point::max()) closed_at = now;
+        else if (now - closed_at > std::chrono::milliseconds(250)) lost = true;
+    }
+}
+
+void ShellSession::feed(int stream, std::string_view data, ShellResult& result) {
+    // whatever a background job prints after the sentinel is not this command's
+    if (done[stream]) return;
+
+    BoundedCapture& sink = stream == 0 ? result.out : result.err;
+    std::string& pending = held[stream];
+    const std::string& tag = tags[stream];
+    pending.append(data);
+
+    size_t pos = pending.find(tag);
+    if (pos != std::string::npos) {
+        size_t eol = pending.find('\n', pos + 1);
+        if (stream == 0 && eol == std::string::npos) {
+            // the exit status is still on its way
+            sink.append(std::string_view(pending).substr(0, pos));
+            pending.erase(0, pos);
+            return;
+        }
+        sink.append(std::string_view(pending).substr(0, pos));
+        if (stream == 0) {
+            result.exit_code = std::atoi(pending.c_str() + pos + tag.size());
+        }
+        pending.clear();
+        done[stream] = true;
+        return;
+    }
+
+    // only the end can still turn out to be the start of the sentinel
+    const size_t keep = tag.size() + 16;
+    if (pending.size() > keep) {
+        sink.append(std::string_view(pending).substr(0, pending.size() - keep));
+        pending.erase(0, pending.size() - keep);
+    }
+}
+
+void ShellSession::end(ShellResult& result) {
+    running = false;
+    if (!lost) return;
+
+    // what it printed before it went is still part of the answer
+    for (int i = 0; i < 2; ++i) {
+        if (!done[i]) (i == 0 ? result.out : result.err).append(held[i]);
+        held[i].clear();
+    }
+
+    if (result.error.empty() && lost_status < 0 && !interrupted) {
+        result.error = "lost the connection to the shell.";
+    }
+    result.exit_code = lost_status >= 0 ? lost_status : 128 + SIGKILL;
+    result.shell_reset = true;
+    reset();
+}
+
+ShellResult ShellSession::run(const std::string& command, const SubprocessOptions& options) {
+    ShellResult result;
+    if (!begin(command, options, result)) return result;
+
+    for (int wait_ms; (wait_ms = next_wait(result)) >= 0;) {
+        int ready = poll(fds, 2, wait_ms);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            lost = true;
+            break;
+        }
+        step(result);
+    }
+    end(result);
+    return result;
+}
+
+Task<ShellResult> ShellSession::run_async(EventLoop& loop, std::string command, SubprocessOptions options) {
+    ShellResult result;
+    if (!begin(command, options, result)) co_return result;
+
+    for (int wait_ms; (wait_ms = next_wait(result)) >= 0;) {
+        co_await loop.poll(fds, 2, wait_ms);
+        step(result);
+    }
+    end(result);
+    co_return result;
+}
+
+void ShellSession::interrupt() {
+    if (!running || pid <= 0 || interrupted) return;
+    kill(-pid, SIGINT);
+    interrupted = true;
+    deadline = clock::now() + INTERRUPT_GRACE;
+}
+
+void ShellSession::reset() {
+    if (in_fd >= 0) close(in_fd);
+    in_fd = -1;
+    for (auto& p : fds) {
+        if (p.fd >= 0) close(p.fd);
+        p.fd = -1;
+    }
+
+    // a reaped shell can still have left jobs running in its group
+    if (pid > 0) {
+        kill(-pid, SIGKILL);
+        while (!reaped && waitpid(pid, nullptr, 0) < 0 && errno == EINTR) {}
+    }
+    pid = -1;
+    reaped = false;
+}
+
+#endif
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <string_view>
+
+#include "event_loop.hpp"
+#include "task.hpp"
+
+// keeps the first head_limit bytes and the last tail_limit bytes of a stream,
+// everything in between is only counted
+class BoundedCapture {
+public:
+    BoundedCapture(size_t head_limit, size_t tail_limit);
+
+    void append(std::string_view data);
+
+    size_t total() const { return total_; }
+    bool truncated() const { return total_ > head.size() + tail_size; }
+
+    // head + elision marker + tail
+    std::string text() const;
+    void append_to(std::string& out) const;
+    // upper bound of what append_to adds
+    size_t text_size() const { return head.size() + tail_size + 64; }
+
+private:
+    std::string head;
+    std::string tail;     // ring buffer, tail_pos is the oldest byte once full
+    size_t head_limit;
+    size_t tail_limit;
+    size_t tail_pos = 0;
+    size_t tail_size = 0;
+    size_t total_ = 0;
+};
+
+class Sandbox;
+
+struct SubprocessOptions {
+    std::chrono::milliseconds timeout{ std::chrono::seconds(120) };
+    size_t head_bytes = 128 * 1024;
+    size_t tail_bytes = 128 * 1024;
+    const Sandbox* sandbox = nullptr; // limits the child starts with, null = none
+};
+
+struct SubprocessResult {
+    int exit_code = -1;     // 128 + signal when the child was killed
+    bool timed_out = false;
+    std::string error;      // set when the command could not be started
+    BoundedCapture out{ 0, 0 };
+    BoundedCapture err{ 0, 0 };
+};
+
+// runs `sh -c command` with stdin on /dev/null, stdout and stderr on their own
+// pipes, and kills the whole process group once the timeout is hit
+SubprocessResult run_subprocess(const std::string& command, const SubprocessOptions& options = {});
+
+#ifndef _WIN32
+// same as run_subprocess, but waits for output and exit on the loop instead of blocking a thread
+Task<SubprocessResult> run_subprocess_async(EventLoop& loop, std::string command, SubprocessOptions options = {});
+#endif
+
+struct ShellResult : SubprocessResult {
+    bool shell_reset = false; // the shell exited or had to be killed, cwd and environment are gone
+};
+
+// one long lived shell (bash when there is one) that runs command after
+// command, so cd, exports and sourced virtualenvs carry over between runs.
+// each command is followed by a sentinel line on stdout and stderr that ends
+// its output and carries its exit status. a timeout sends SIGINT like ^C,
+// which the shell itself survives; when the command still runs after
+// INTERRUPT_GRACE the shell is killed and the next run starts a new one.
+// runs one command at a time, and on windows every run gets a fresh shell
+class ShellSession {
+public:
+    static constexpr std::chrono::milliseconds INTERRUPT_GRACE{ 2000 };
+
+    ShellSession() = default;
+    ~ShellSession() { reset(); }
+
+    ShellSession(const ShellSession&) = delete;
+    ShellSession& operator=(const ShellSession&) = delete;
+
+    ShellResult run(const std::string& command, const SubprocessOptions& options = {});
+#ifndef _WIN32
+    Task<ShellResult> run_async(EventLoop& loop, std::string command, SubprocessOptions options = {});
+#endif
+
+    // ^C for the running command, the run then answers with status 130
+    void interrupt();
+
+    // kills the shell and everything it left running
+    void reset();
+
+    bool alive() const { return pid > 0 && !reaped; }
+
+private:
+#ifndef _WIN32
+    using clock = std::chrono::steady_clock;
+
+    bool start(const Sandbox* sandbox, std::string& error);
+    bool begin(const std::string& command, const SubprocessOptions& options, ShellResult& result);
+    int next_wait(ShellResult& result);
+    void step(ShellResult& result);
+    void feed(int stream, std::string_view data, ShellResult& result);
+    void end(ShellResult& result);
+
+    int in_fd = -1;
+    pollfd fds[2] = { { -1, POLLIN, 0 }, { -1, POLLIN, 0 } };
+
+    // state of the running command
+    bool running = false;
+    bool interrupted = false;
+    bool lost = false;    // the shell is gone, reset at the end of the run
+    int lost_status = -1; // its exit code when it went by itself
+    clock::time_point deadline;
+    clock::time_point closed_at; // when the shell closed both pipes
+    std::string tags[2];  // sentinels on stdout and stderr
+    std::string held[2];  // read but maybe the start of a sentinel
+    bool done[2] = { false, false };
+    std::array<char, 64 * 1024> buffer;
+#endif
+    int pid = -1;
+    bool reaped = false;
+};
@@ -0,0 +1,202 @@
+#include "text_search.hpp"
+
+#include <cctype>
+#include <cstring>
+
+namespace {
+
+// most frequent bytes in source code and prose, most common first.
+// anything not listed counts as rare
+const char COMMON_BYTES[] = " etaoinsrlcdu\n\tpmhfgb_(),;.y=w/v\"k*-x:{}ETSAIRNOCLDMP0123456789<>#&'[]+!|";
+
+int rarity(unsigned char c) {
+    const char* at = static_cast<const char*>(std::memchr(COMMON_BYTES, c, sizeof(COMMON_BYTES) - 1));
+    return at ? static_cast<int>(at - COMMON_BYTES) : 1000;
+}
+
+char lower(char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); }
+char upper(char c) { return static_cast<char>(std::toupper(static_cast<unsigned char>(c))); }
+
+}
+
+LiteralFinder::LiteralFinder(std::string needle_, bool ignore_case)
+    : needle(std::move(needle_)), ignore_case(ignore_case)
+{
+    if (ignore_case) {
+        for (char& c : needle) c = lower(c);
+    }
+
+    int best = -1;
+    for (size_t i = 0; i < needle.size(); ++i) {
+        // upper and lower case are both searched for, score the pair by its commoner half
+        unsigned char c = static_cast<unsigned char>(needle[i]);
+        int score = ignore_case ? std::min(rarity(c), rarity(static_cast<unsigned char>(upper(needle[i])))) : rarity(c);
+        if (score > best) {
+            best = score;
+            rare_index = i;
+        }
+    }
+
+    if (!needle.empty()) {
+        rare_lower = needle[rare_index];
+        rare_upper = ignore_case ? upper(rare_lower) : rare_lower;
+    }
+}
+
+bool LiteralFinder::equal_at(const char* at) const {
+    if (!ignore_case) return std::memcmp(at, needle.data(), needle.size()) == 0;
+
+    for (size_t i = 0; i < needle.size(); ++i) {
+        if (lower(at[i]) != needle[i]) return false;
+    }
+    return true;
+}
+
+size_t LiteralFinder::find(std::string_view haystack, size_t from) const {
+    if (needle.empty()) return from <= haystack.size() ? from : std::string_view::npos;
+    if (haystack.size() < needle.size()) return std::string_view::npos;
+
+    const char* base = haystack.data();
+    // the rare byte can only sit in [from + rare_index, size - len + rare_index]
+    const char* scan = base + from + rare_index;
+    const char* last = base + haystack.size() - needle.size() + rare_index;
+
+    while (scan <= last) {
+        size_t left = static_cast<size_t>(last - scan) + 1;
+        const char* hit = static_cast<const char*>(std::memchr(scan, rare_lower, left));
+        if (rare_upper != rare_lower) {
+            const char* other = static_cast<const char*>(std::memchr(scan, rare_upper, hit ? static_cast<size_t>(hit - scan) : left));
+            if (other) hit = other;
+        }
+        if (!hit) return std::string_view::npos;
+
+        const char* start = hit - rare_index;
+        if (equal_at(start)) return static_cast<size_t>(start - base);
+        scan = hit + 1;
+    }
+
+    return std::string_view::npos;
+}
+
+std::optional<std::string> required_literal(std::string_view pattern) {
+    std::string best;
+    std::string run;
+    int group_depth = 0;
+
+    auto close_run = [&]() {
+        if (run.size() > best.size()) best = run;
+        run.clear();
+    };
+
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        char c = pattern[i];
+
+        // a quantifier that allows zero makes the previous character optional
+        auto next_is_optional = [&](size_t at) {
+            if (at >= pattern.size()) return false;
+            char q = pattern[at];
+            return q == '*' || q == '?' || q == '{';
+        };
+
+        switch (c) {
+        case '|':
+            return std::nullopt; // either side could match alone
+        case '(':
+            group_depth++;
+            close_run();
+            // (?:...), (?=...) and friends
+            if (i + 1 < pattern.size() && pattern[i + 1] == '?') i++;
+            continue;
+        case ')':
+            if (group_depth > 0) group_depth--;
+            close_run();
+            // a whole optional group says nothing about the rest
+            if (next_is_optional(i + 1)) i++;
+            continue;
+        case '[': {
+            close_run();
+            size_t j = i + 1;
+            if (j < pattern.size() && pattern[j] == '^') j++;
+            if (j < pattern.size() && pattern[j] == ']') j++;
+            while (j < pattern.size() && pattern[j] != ']') {
+                if (pattern[j] == '\\') j++;
+                j++;
+            }
+            i = j;
+            continue;
+        }
+        case '.': case '^': case '$': case '*': case '+': case '?': case '{': case '}':
+            close_run();
+            if (c == '{') {
+                while (i < pattern.size() && pattern[i] != '}') i++;
+            }
+            continue;
+        case '\\': {
+            if (i + 1 >= pattern.size()) return std::nullopt;
+            char e = pattern[++i];
+            // \d \w \s \b ... are classes or assertions, \. \( \\ are the character itself
+            if (std::isalnum(static_cast<unsigned char>(e))) {
+                close_run();
+                // the operand of \x41 \u0041 \cJ and the rest of a \12 backreference
+                // is no literal text either
+                auto skip = [&](size_t most, auto accepts) {
+                    for (; most > 0 && i + 1 < pattern.size() && accepts(static_cast<unsigned char>(pattern[i + 1])); --most) i++;
+                };
+                if (e == 'x') skip(2, [](unsigned char d) { return std::isxdigit(d) != 0; });
+                else if (e == 'u') skip(4, [](unsigned char d) { return std::isxdigit(d) != 0; });
+                else if (e == 'c') skip(1, [](unsigned char d) { return std::isalpha(d) != 0; });
+                else if (std::isdigit(static_cast<unsigned char>(e))) skip(std::string::npos, [](unsigned char d) { return std::isdigit(d) != 0; });
+                continue;
+            }
+            c = e;
+            break;
+        }
+        default:
+            break;
+        }
+
+        if (next_is_optional(i + 1)) {
+            close_run();
+            continue;
+        }
+
+        // inside a group the literal is only required if the group is,
+        // which we do not track, so only count what lives outside groups
+        if (group_depth > 0) {
+            close_run();
+            continue;
+        }
+
+        run += c;
+        // "ab+" still requires the b, but nothing can be appended after it
+        if (i + 1 < pattern.size() && pattern[i + 1] == '+') close_run();
+    }
+    close_run();
+
+    if (best.empty()) return std::nullopt;
+    return best;
+}
+
+LineMatcher::LineMatcher(const std::string& pattern, bool literal, bool ignore_case)
+    : literal(literal)
+{
+    if (literal) {
+        filter = LiteralFinder(pattern, ignore_case);
+        return;
+    }
+
+    auto flags = std::regex::ECMAScript | std::regex::optimize;
+    if (ignore_case) flags |= std::regex::icase;
+    regex.emplace(pattern, flags);
+
+    if (auto required = required_literal(pattern)) {
+        filter = LiteralFinder(std::move(*required), ignore_case);
+    }
+}
+
+bool LineMatcher::matches(std::string_view line) const {
+    if (literal) return filter.find(line) != std::string_view::npos;
+    if (has_prefilter() && filter.find(line) == std::string_view::npos) return false;
+    if (line.size() > MAX_REGEX_LINE) line = line.substr(0, MAX_REGEX_LINE);
+    return std::regex_search(line.begin(), line.end(), *regex);
+}
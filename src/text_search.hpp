@@ -0,0 +1,56 @@
+#pragma once
+
+#include <optional>
+#include <regex>
+#include <string>
+#include <string_view>
+
+// substring search that memchr()s for the needle's rarest byte (memchr is
+// vectorized in every libc we care about) and only then compares the rest
+class LiteralFinder {
+public:
+    LiteralFinder() = default;
+    LiteralFinder(std::string needle, bool ignore_case);
+
+    // offset of the first match at or after from, npos if none
+    size_t find(std::string_view haystack, size_t from = 0) const;
+
+    bool empty() const { return needle.empty(); }
+
+private:
+    bool equal_at(const char* at) const;
+
+    std::string needle; // lowercased when ignore_case
+    bool ignore_case = false;
+    size_t rare_index = 0;
+    char rare_lower = 0;
+    char rare_upper = 0;
+};
+
+// the longest run of plain characters every match of an ECMAScript pattern
+// must contain, or nothing when there is none we can prove (alternation etc)
+std::optional<std::string> required_literal(std::string_view pattern);
+
+// what grep looks for in one line: a literal, or a regex with an optional literal prefilter
+class LineMatcher {
+public:
+    // throws std::regex_error for a bad pattern
+    LineMatcher(const std::string& pattern, bool literal, bool ignore_case);
+
+    // a file without this can not match at all
+    const LiteralFinder& prefilter() const { return filter; }
+    bool has_prefilter() const { return !filter.empty(); }
+
+    // std::regex recurses once per character and a minified line takes the
+    // stack with it, so a regex only sees this much of a line
+    static constexpr size_t MAX_REGEX_LINE = 4096;
+
+    bool matches(std::string_view line) const;
+    // whether matches() saw only the start of the line
+    bool clips(std::string_view line) const { return !literal && line.size() > MAX_REGEX_LINE; }
+
+private:
+    bool literal;
+    LiteralFinder filter;
+    std::optional<std::regex> regex;
+};
@@ -0,0 +1,168 @@
+#include "tool.hpp"
+#include "event_loop.hpp"
+#include "tool_executor.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+
+std::string normalize_tool_path(const std::string& path) {
+    std::error_code ec;
+    std::filesystem::path full = std::filesystem::absolute(path, ec);
+    if (ec) return path;
+
+    return full.lexically_normal().string();
+}
+
+json tool_schema(const ToolSpec& spec) {
+    json properties = json::object();
+    json required = json::array();
+    for (const ToolParam& param : spec.params) {
+        properties[std::string(param.name)] = {
+            {"type", std::string(param.type)},
+            {"description", std::string(param.description)}
+        };
+        if (!param.items.empty()) properties[std::string(param.name)]["items"] = json::parse(param.items);
+        if (param.required) required.push_back(std::string(param.name));
+    }
+
+    json parameters = {
+        {"type", "object"},
+        {"properties", std::move(properties)}
+    };
+    if (!required.empty()) parameters["required"] = std::move(required);
+
+    return {
+        {"type", "function"},
+        {"function", {
+            {"name", std::string(spec.name)},
+            {"description", std::string(spec.description)},
+            {"parameters", std::move(parameters)}
+        }}
+    };
+}
+
+Tool& ToolRegistry::register_tool(std::unique_ptr<Tool> tool) {
+    std::shared_ptr<Tool> owned(std::move(tool));
+    std::string name(owned->spec().name);
+
+    std::unique_lock lock(mutex);
+    auto [it, inserted] = tools.try_emplace(std::move(name), Entry{ owned, std::nullopt });
+    if (inserted) {
+        order.push_back(owned);
+    }
+    else {
+        // a replacement keeps the compression set up for the name
+        std::replace(order.begin(), order.end(), it->second.tool, owned);
+        it->second.tool = owned;
+    }
+
+    schema_json_.reset();
+    return *owned;
+}
+
+bool ToolRegistry::unregister_tool(std::string_view name) {
+    std::unique_lock lock(mutex);
+    auto it = tools.find(name);
+    if (it == tools.end()) return false;
+
+    order.erase(std::remove(order.begin(), order.end(), it->second.tool), order.end());
+    tools.erase(it);
+    schema_json_.reset();
+    return true;
+}
+
+RegisteredTool ToolRegistry::find(std::string_view name) const {
+    std::shared_lock lock(mutex);
+    auto it = tools.find(name);
+    if (it == tools.end()) return {};
+    return { it->second.tool, it->second.compression.value_or(default_compression) };
+}
+
+bool ToolRegistry::set_compression(std::string_view name, const ResultCompression& compression) {
+    std::unique_lock lock(mutex);
+    auto it = tools.find(name);
+    if (it == tools.end()) return false;
+    it->second.compression = compression;
+    return true;
+}
+
+void ToolRegistry::set_default_compression(const ResultCompression& compression) {
+    std::unique_lock lock(mutex);
+    default_compression = compression;
+}
+
+size_t ToolRegistry::size() const {
+    std::shared_lock lock(mutex);
+    return tools.size();
+}
+
+json ToolRegistry::build_schema() const {
+    json schema = json::array();
+    for (const auto& tool : order) schema.push_back(tool_schema(tool->spec()));
+    return schema;
+}
+
+json ToolRegistry::schema() const {
+    std::shared_lock lock(mutex);
+    return build_schema();
+}
+
+std::shared_ptr<const std::string> ToolRegistry::schema_json() const {
+    {
+        std::shared_lock lock(mutex);
+        if (schema_json_) return schema_json_;
+    }
+
+    std::unique_lock lock(mutex);
+    if (!schema_json_) schema_json_ = std::make_shared<const std::string>(build_schema().dump());
+    return schema_json_;
+}
+
+json parse_tool_args(const json& call) {
+    if (!call.contains("function") || !call["function"].contains("arguments") ||
+        !call["function"]["arguments"].is_string())
+    {
+        return json::object();
+    }
+
+    const std::string& args_str = call["function"]["arguments"].get_ref<const std::string&>();
+
+    json args;
+    try {
+        args = json::parse(args_str);
+    }
+    catch (...) {
+        args = json::object();
+    }
+
+    return args;
+}
+
+Task<void> Tool::execute_async(const json& args, const ToolContext& ctx, std::string& out) {
+    if (!ctx.loop || !ctx.pool) {
+        execute(args, ctx, out);
+        co_return;
+    }
+
+    co_await ctx.loop->offload(*ctx.pool, [&]() { execute(args, ctx, out); });
+}
+
+Task<void> run_tool(const RegisteredTool& entry, std::string_view name, const json& args,
+                    const ToolContext& ctx, std::string& out)
+{
+    ScopedSpan span(ctx.trace, ctx.turn, "tool", std::string(name));
+    out.clear();
+
+    if (!entry) {
+        out = "ERROR: TOOL NOT FOUND";
+        co_return;
+    }
+
+    co_await entry.tool->execute_async(args, ctx, out);
+
+    // a find . or a chatty build must not take over the context window
+    compress_result(out, entry.compression);
+    span.set_bytes(out.size());
+}
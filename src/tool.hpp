@@ -0,0 +1,158 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "result_compressor.hpp"
+#include "task.hpp"
+
+using json = nlohmann::json;
+
+class EventLoop;
+class FileReadCache;
+class Sandbox;
+class ShellSession;
+class ThreadPool;
+class Trace;
+
+// per call state handed to execute.
+// everything but call_id belongs to the conversation and may be null
+struct ToolContext {
+    std::string call_id;
+    FileReadCache* read_cache = nullptr;
+    ShellSession* shell = nullptr; // the conversation's long lived shell
+    const Sandbox* sandbox = nullptr; // limits for the processes tools start, null = none
+    Trace* trace = nullptr;
+    int turn = 0;
+    size_t max_result_bytes = 0; // what the history keeps of one result, 0 = no limit
+    EventLoop* loop = nullptr;
+    ThreadPool* pool = nullptr; // where blocking execute() calls go
+};
+
+// what a single call touches, the executor uses it to decide what may overlap
+struct ToolAccess {
+    std::string resource;   // normalized path, covers everything below it. empty = nothing in particular
+    bool exclusive = false; // writes, must not overlap other calls on the same resource
+};
+
+// one argument in a tool's schema
+struct ToolParam {
+    std::string_view name;
+    std::string_view type; // json schema type
+    std::string_view description;
+    bool required = false;
+    std::string_view items; // json schema of the elements of an "array", empty = any
+};
+
+// what the model is told about a tool. tools keep it as static constexpr
+// data, the registry turns it into the request schema once
+struct ToolSpec {
+    std::string_view name;
+    std::string_view description;
+    std::span<const ToolParam> params;
+};
+
+// the "tools" array entry for one spec
+json tool_schema(const ToolSpec& spec);
+
+//tool interface
+class Tool {
+public:
+    virtual const ToolSpec& spec() const = 0;
+
+    // the answer goes into out (empty on entry), which the caller later moves
+    // into the tool message, so reserve what you know and write in place
+    virtual void execute(const json& args, const ToolContext& ctx, std::string& out) = 0;
+
+    // what the agent loop actually calls. the default runs execute() on
+    // ctx.pool, tools that mostly wait (child processes, sockets) override it
+    // and yield on ctx.loop instead of holding a thread
+    virtual Task<void> execute_async(const json& args, const ToolContext& ctx, std::string& out);
+
+    // default: free to run next to anything else.
+    // exclusive with an empty resource serializes against every other call
+    virtual ToolAccess access(const json& args) const { return {}; }
+
+    virtual ~Tool() = default;
+};
+
+// a registry entry as seen by one call
+struct RegisteredTool {
+    std::shared_ptr<Tool> tool;
+    ResultCompression compression; // applied to the result before it goes to the model
+
+    explicit operator bool() const { return tool != nullptr; }
+};
+
+// Tool-Registry
+// owns the tools. registration is safe while calls run, so plugins can come and
+// go at runtime: a replaced or removed tool lives on until its last call returns
+class ToolRegistry {
+public:
+    // under spec().name, replacing a tool of that name in its place in the schema
+    Tool& register_tool(std::unique_ptr<Tool> tool);
+
+    template <typename T, typename... Args>
+    T& emplace(Args&&... args) {
+        return static_cast<T&>(register_tool(std::make_unique<T>(std::forward<Args>(args)...)));
+    }
+
+    bool unregister_tool(std::string_view name);
+
+    // one hash of the name as it sits in the parsed call, no copy
+    RegisteredTool find(std::string_view name) const;
+    std::shared_ptr<Tool> get(std::string_view name) const { return find(name).tool; }
+
+    // how results of one tool are compressed, false when there is no such tool.
+    // tools without their own setting follow the default
+    bool set_compression(std::string_view name, const ResultCompression& compression);
+    void set_default_compression(const ResultCompression& compression);
+
+    size_t size() const;
+
+    // the request "tools" array, in registration order
+    json schema() const;
+    // and serialized, conversations share these bytes instead of copying them.
+    // built on first use after a change, a conversation keeps the version it started with
+    std::shared_ptr<const std::string> schema_json() const;
+
+private:
+    struct NameHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view name) const noexcept { return std::hash<std::string_view>{}(name); }
+    };
+
+    struct Entry {
+        std::shared_ptr<Tool> tool;
+        std::optional<ResultCompression> compression;
+    };
+
+    json build_schema() const;
+
+    mutable std::shared_mutex mutex;
+    std::unordered_map<std::string, Entry, NameHash, std::equal_to<>> tools;
+    ResultCompression default_compression;
+    std::vector<std::shared_ptr<Tool>> order;
+    mutable std::shared_ptr<const std::string> schema_json_;
+};
+
+// key for ToolAccess::resource, so "a/../b", "./b" and "b" all collide
+std::string normalize_tool_path(const std::string& path);
+
+// parses the arguments of one message["tool_calls"] entry
+json parse_tool_args(const json& call);
+
+// runs a tool looked up earlier (no tool = no such tool, name is only for the
+// trace then), compresses the result and leaves what goes back to the model in out.
+// everything is taken by reference, await it right away
+Task<void> run_tool(const RegisteredTool& entry, std::string_view name, const json& args,
+                    const ToolContext& ctx, std::string& out);
@@ -0,0 +1,152 @@
+#include "tool_executor.hpp"
+
+#include <exception>
+#include <filesystem>
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) threads = 1;
+
+    workers.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back([this]() { worker_loop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::worker_loop() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+
+            if (jobs.empty()) return; // only when stopping
+            job = std::move(jobs.front());
+            jobs.pop();
+        }
+        job();
+    }
+}
+
+ToolExecutor::ToolExecutor(EventLoop& loop, ToolRegistry& registry, size_t threads)
+    : loop_(loop), registry_(registry), pool_(threads)
+{
+}
+
+namespace {
+
+bool is_separator(char c) {
+    return c == '/' || c == static_cast<char>(std::filesystem::path::preferred_separator);
+}
+
+// the same path, or one is a directory the other lies under. compared per
+// component, so "src" covers "src/a.cpp" but not "srcs"
+bool overlaps(const std::string& a, const std::string& b) {
+    const std::string& outer = a.size() <= b.size() ? a : b;
+    const std::string& inner = a.size() <= b.size() ? b : a;
+    if (!inner.starts_with(outer)) return false;
+    if (inner.size() == outer.size()) return true;
+    return is_separator(outer.back()) || is_separator(inner[outer.size()]);
+}
+
+bool conflicts(const ToolAccess& a, const ToolAccess& b) {
+    if (!a.exclusive && !b.exclusive) return false;
+    if (a.exclusive && a.resource.empty()) return true;
+    if (b.exclusive && b.resource.empty()) return true;
+    return !a.resource.empty() && !b.resource.empty() && overlaps(a.resource, b.resource);
+}
+
+}
+
+ToolBatch::ToolBatch(ToolExecutor& executor, ToolContext session, ToolRegistry* registry)
+    : executor(executor), registry(registry ? *registry : executor.registry()), session(std::move(session))
+{
+    this->session.loop = &executor.loop();
+    this->session.pool = &executor.pool();
+}
+
+Task<void> ToolBatch::run_call(RegisteredTool tool, std::string missing, json args, ToolContext ctx,
+                               std::vector<std::shared_ptr<AsyncEvent>> deps,
+                               std::shared_ptr<AsyncEvent> done, std::shared_ptr<std::string> result)
+{
+    for (const auto& dep : deps) {
+        co_await dep->wait();
+    }
+
+    std::string_view name = missing;
+    if (tool) name = tool.tool->spec().name;
+
+    // a throwing tool is a failed call, the ones waiting on it and results() still go on
+    try {
+        co_await run_tool(tool, name, args, ctx, *result);
+    }
+    catch (const std::exception& e) {
+        *result = std::string("ERROR: ") + e.what();
+    }
+    catch (...) {
+        *result = "ERROR: the tool failed";
+    }
+    done->set();
+}
+
+void ToolBatch::add(const json& call) {
+    // looked up once, straight from the parsed message
+    std::string_view name;
+    if (call.contains("function") && call["function"].contains("name") && call["function"]["name"].is_string()) {
+        name = call["function"]["name"].get_ref<const std::string&>();
+    }
+    RegisteredTool tool = registry.find(name);
+
+    // parsed once here, used for the access check and then moved into the call
+    json args = parse_tool_args(call);
+
+    ToolAccess access;
+    if (tool) {
+        access = tool.tool->access(args);
+    }
+
+    ToolContext ctx = session;
+    if (call.contains("id") && call["id"].is_string()) {
+        ctx.call_id = call["id"];
+    }
+
+    // only earlier calls can be waited on, so this can not deadlock
+    std::vector<std::shared_ptr<AsyncEvent>> deps;
+    for (const auto& earlier : pending) {
+        if (conflicts(access, earlier.access)) {
+            deps.push_back(earlier.done);
+        }
+    }
+
+    auto done = std::make_shared<AsyncEvent>();
+    auto result = std::make_shared<std::string>();
+    std::string missing = tool ? std::string() : std::string(name);
+    executor.loop().spawn(run_call(std::move(tool), std::move(missing), std::move(args), std::move(ctx),
+                                   std::move(deps), done, result));
+
+    pending.push_back({ std::move(access), std::move(done), std::move(result) });
+}
+
+Task<std::vector<std::string>> ToolBatch::results() {
+    std::vector<std::string> out;
+    out.reserve(pending.size());
+
+    for (auto& p : pending) {
+        co_await p.done->wait();
+        out.push_back(std::move(*p.result));
+    }
+
+    pending.clear();
+    co_return out;
+}
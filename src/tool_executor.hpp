@@ -0,0 +1,99 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "event_loop.hpp"
+#include "task.hpp"
+#include "tool.hpp"
+
+// fixed set of workers pulling from one FIFO queue
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    template <typename F>
+    auto submit(F&& fn) -> std::future<decltype(fn())> {
+        using R = decltype(fn());
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(fn));
+        std::future<R> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.emplace([task]() { (*task)(); });
+        }
+        wake.notify_one();
+        return result;
+    }
+
+    size_t size() const { return workers.size(); }
+
+private:
+    void worker_loop();
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+// runs tool calls on a shared pool, can be shared by several sessions.
+// the pool only runs the blocking tools, the rest wait on the loop
+class ToolExecutor {
+public:
+    ToolExecutor(EventLoop& loop, ToolRegistry& registry, size_t threads);
+
+    EventLoop& loop() { return loop_; }
+    ToolRegistry& registry() { return registry_; }
+    ThreadPool& pool() { return pool_; }
+
+private:
+    EventLoop& loop_;
+    ToolRegistry& registry_;
+    ThreadPool pool_;
+};
+
+// the tool calls of one assistant turn.
+// calls start as soon as they are added and only wait for earlier calls they
+// conflict with; results come back in the order the calls were added
+class ToolBatch {
+public:
+    // session is copied into the context of every call. calls are looked up
+    // in registry, the executor's own when null
+    explicit ToolBatch(ToolExecutor& executor, ToolContext session = {}, ToolRegistry* registry = nullptr);
+
+    void add(const json& call);
+    size_t size() const { return pending.size(); }
+
+    // resumes once every call is done. also how to drain a batch that is thrown away,
+    // calls may point into the conversation that owns it
+    Task<std::vector<std::string>> results();
+
+private:
+    struct Pending {
+        ToolAccess access;
+        std::shared_ptr<AsyncEvent> done;    // later conflicting calls wait on this
+        std::shared_ptr<std::string> result; // filled by the call, moved out by results()
+    };
+
+    // missing is the requested name when there is no such tool, empty otherwise
+    static Task<void> run_call(RegisteredTool tool, std::string missing, json args, ToolContext ctx,
+                               std::vector<std::shared_ptr<AsyncEvent>> deps,
+                               std::shared_ptr<AsyncEvent> done, std::shared_ptr<std::string> result);
+
+    ToolExecutor& executor;
+    ToolRegistry& registry;
+    ToolContext session;
+    std::vector<Pending> pending;
+};
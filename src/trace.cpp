@@ -0,0 +1,120 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+Trace::Trace()
+    : start(clock::now())
+{
+}
+
+int64_t Trace::now_us() const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start).count();
+}
+
+void Trace::record(int turn, const std::string& phase, const std::string& name,
+                   int64_t start_us, int64_t dur_us, size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    spans.push_back({ turn, phase, name, start_us, dur_us, bytes });
+}
+
+void Trace::record_usage(int turn, const Usage& usage) {
+    if (!usage.present) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    usages.emplace_back(turn, usage);
+}
+
+void Trace::print_summary(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    struct Totals {
+        size_t count = 0;
+        int64_t total = 0;
+        int64_t max = 0;
+    };
+
+    // ordered by key so the table reads the same every run
+    std::map<std::string, Totals> by_phase;
+    int turns = 0;
+    for (const auto& span : spans) {
+        std::string key = span.name.empty() ? span.phase : span.phase + ":" + span.name;
+        Totals& t = by_phase[key];
+        t.count++;
+        t.total += span.dur_us;
+        t.max = std::max(t.max, span.dur_us);
+        turns = std::max(turns, span.turn);
+    }
+
+    out << "timing summary: " << turns << " turns, " << std::fixed << std::setprecision(1)
+        << now_us() / 1000.0 << " ms wall\n";
+    out << std::left << std::setw(22) << "phase" << std::right
+        << std::setw(7) << "count" << std::setw(12) << "total ms"
+        << std::setw(10) << "avg ms" << std::setw(10) << "max ms" << "\n";
+
+    for (const auto& [key, t] : by_phase) {
+        out << std::left << std::setw(22) << key << std::right
+            << std::setw(7) << t.count
+            << std::setw(12) << t.total / 1000.0
+            << std::setw(10) << (t.total / 1000.0) / static_cast<double>(t.count)
+            << std::setw(10) << t.max / 1000.0 << "\n";
+    }
+
+    Usage total;
+    for (const auto& [turn, usage] : usages) total.add(usage);
+    if (total.present) {
+        out << "usage: prompt " << total.prompt_tokens << " (cached " << total.cached_tokens
+            << "), completion " << total.completion_tokens << "\n";
+    }
+}
+
+bool Trace::write_jsonl(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (const auto& span : spans) {
+        json line = {
+            {"type", "span"},
+            {"turn", span.turn},
+            {"phase", span.phase},
+            {"start_us", span.start_us},
+            {"dur_us", span.dur_us}
+        };
+        if (!span.name.empty()) line["name"] = span.name;
+        if (span.bytes) line["bytes"] = span.bytes;
+        file << line.dump() << "\n";
+    }
+
+    for (const auto& [turn, usage] : usages) {
+        json line = {
+            {"type", "usage"},
+            {"turn", turn},
+            {"prompt_tokens", usage.prompt_tokens},
+            {"completion_tokens", usage.completion_tokens},
+            {"cached_tokens", usage.cached_tokens},
+            {"cache_write_tokens", usage.cache_write_tokens}
+        };
+        file << line.dump() << "\n";
+    }
+
+    return static_cast<bool>(file);
+}
+
+ScopedSpan::ScopedSpan(Trace* trace, int turn, std::string phase, std::string name)
+    : trace(trace), turn(turn), phase(std::move(phase)), name(std::move(name))
+{
+    if (trace) start_us = trace->now_us();
+}
+
+ScopedSpan::~ScopedSpan() {
+    if (trace) trace->record(turn, phase, name, start_us, trace->now_us() - start_us, bytes);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "usage.hpp"
+
+// monotonic timings of every phase of every turn, plus the usage per turn.
+// safe to record into from tool worker threads
+class Trace {
+public:
+    using clock = std::chrono::steady_clock;
+
+    Trace();
+
+    // microseconds since the trace was created
+    int64_t now_us() const;
+
+    void record(int turn, const std::string& phase, const std::string& name,
+                int64_t start_us, int64_t dur_us, size_t bytes = 0);
+    void record_usage(int turn, const Usage& usage);
+
+    void print_summary(std::ostream& out) const;
+    // one json object per line: spans first, then usage records
+    bool write_jsonl(const std::string& path) const;
+
+private:
+    struct Span {
+        int turn;
+        std::string phase;
+        std::string name;
+        int64_t start_us;
+        int64_t dur_us;
+        size_t bytes;
+    };
+
+    clock::time_point start;
+    mutable std::mutex mutex;
+    std::vector<Span> spans;
+    std::vector<std::pair<int, Usage>> usages;
+};
+
+// records [construction, destruction) as one span, does nothing without a trace
+class ScopedSpan {
+public:
+    ScopedSpan(Trace* trace, int turn, std::string phase, std::string name = "");
+    ~ScopedSpan();
+
+    ScopedSpan(const ScopedSpan&) = delete;
+    ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+    void set_bytes(size_t value) { bytes = value; }
+
+private:
+    Trace* trace;
+    int turn;
+    std::string phase;
+    std::string name;
+    int64_t start_us = 0;
+    size_t bytes = 0;
+};
@@ -0,0 +1,29 @@
+#include "turn_buffers.hpp"
+
+#include <algorithm>
+
+std::string TurnBuffers::take_response() {
+    std::string out;
+    out.swap(response_);
+    out.clear();
+    return out;
+}
+
+void TurnBuffers::give_back(std::string&& response) {
+    turn_bytes += response.size();
+    if (response.capacity() > response_.capacity()) response_ = std::move(response);
+}
+
+void TurnBuffers::end_turn(size_t history_bytes) {
+    // an outlier turn does not get to pin its memory for the rest of the session
+    if (body_.capacity() > MAX_RETAINED) std::string().swap(body_);
+    if (response_.capacity() > MAX_RETAINED) std::string().swap(response_);
+
+    stats_.turns++;
+    stats_.turn_peak = std::max(stats_.turn_peak, turn_bytes);
+    stats_.turn_total += turn_bytes;
+    stats_.history_peak = std::max(stats_.history_peak, history_bytes);
+    stats_.buffer_capacity = body_.capacity() + response_.capacity();
+    stats_.session_peak = std::max(stats_.session_peak, history_bytes + turn_bytes + stats_.buffer_capacity);
+    turn_bytes = 0;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// what a conversation's turns held in memory, in bytes. a turn's data is its
+// request body, the response and the tool results, history is the
+// serialized messages kept from one request to the next
+struct MemoryStats {
+    size_t turn_peak = 0;        // the biggest single turn
+    uint64_t turn_total = 0;     // every turn added up
+    size_t history_peak = 0;
+    size_t session_peak = 0;     // history + turn data + kept buffers, at the worst turn
+    size_t buffer_capacity = 0;  // what the reused buffers hold on to now
+    int turns = 0;
+};
+
+// the request body and response buffers of one conversation. they keep
+// their capacity from turn to turn, so once a conversation has seen its
+// biggest body it stops allocating (and faulting in) fresh megabytes every
+// turn, and other sessions on the loop are not fighting it for the heap.
+// a buffer over MAX_RETAINED is freed after its turn. loop thread only
+class TurnBuffers {
+public:
+    static constexpr size_t MAX_RETAINED = 16 * 1024 * 1024;
+
+    // the request body, built in place each turn
+    std::string& body() { return body_; }
+
+    // an empty string with the capacity of the last response, and back
+    std::string take_response();
+    void give_back(std::string&& response);
+
+    // the rest of the turn's data: the body that was sent, tool results, streamed bytes
+    void add(size_t bytes) { turn_bytes += bytes; }
+
+    // closes the turn's accounting
+    void end_turn(size_t history_bytes);
+
+    const MemoryStats& stats() const { return stats_; }
+
+private:
+    std::string body_;
+    std::string response_;
+    size_t turn_bytes = 0;
+    MemoryStats stats_;
+};
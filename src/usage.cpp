@@ -0,0 +1,38 @@
+#include "usage.hpp"
+
+namespace {
+
+long number_at(const json& obj, const char* key) {
+    if (!obj.is_object() || !obj.contains(key) || !obj[key].is_number()) return 0;
+    return obj[key].get<long>();
+}
+
+}
+
+void Usage::add(const Usage& other) {
+    prompt_tokens += other.prompt_tokens;
+    completion_tokens += other.completion_tokens;
+    cached_tokens += other.cached_tokens;
+    cache_write_tokens += other.cache_write_tokens;
+    present = present || other.present;
+}
+
+Usage parse_usage(const json& usage) {
+    Usage out;
+    if (!usage.is_object()) return out;
+
+    out.present = true;
+    out.prompt_tokens = number_at(usage, "prompt_tokens");
+    out.completion_tokens = number_at(usage, "completion_tokens");
+
+    if (usage.contains("prompt_tokens_details")) {
+        const json& details = usage["prompt_tokens_details"];
+        out.cached_tokens = number_at(details, "cached_tokens");
+        out.cache_write_tokens = number_at(details, "cache_write_tokens");
+    }
+
+    if (!out.cached_tokens) out.cached_tokens = number_at(usage, "cache_read_input_tokens");
+    if (!out.cache_write_tokens) out.cache_write_tokens = number_at(usage, "cache_creation_input_tokens");
+
+    return out;
+}
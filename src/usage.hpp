@@ -0,0 +1,20 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// token counts from the "usage" field of a completion
+struct Usage {
+    long prompt_tokens = 0;
+    long completion_tokens = 0;
+    long cached_tokens = 0;      // prompt tokens read from the provider cache
+    long cache_write_tokens = 0; // prompt tokens written to it
+    bool present = false;
+
+    void add(const Usage& other);
+};
+
+// understands the openai/openrouter shape (prompt_tokens_details) and the
+// anthropic one (cache_read_input_tokens / cache_creation_input_tokens)
+Usage parse_usage(const json& usage);
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// just enough of a test framework for table tests of the pure parts:
+// TEST(name) { CHECK(...); CHECK_EQ(a, b); } anywhere under tests/, run by
+// claude-code-tests [name substring]
+
+struct TestCase {
+    const char* name;
+    void (*run)();
+};
+
+std::vector<TestCase>& test_registry();
+bool register_test(const char* name, void (*run)());
+
+// records a failure of the running test and prints where
+void check_failed(const char* file, int line, const std::string& what);
+
+#define TEST(name) \
+    static void name(); \
+    static const bool name##_registered = register_test(#name, name); \
+    static void name()
+
+#define CHECK(cond) \
+    do { if (!(cond)) check_failed(__FILE__, __LINE__, #cond); } while (0)
+
+#define CHECK_EQ(actual, expected) \
+    do { \
+        const auto& check_a = (actual); \
+        const auto& check_e = (expected); \
+        if (!(check_a == check_e)) { \
+            std::ostringstream check_s; \
+            check_s << #actual << " == " << #expected << "\n    got: " << check_a << "\n    expected: " << check_e; \
+            check_failed(__FILE__, __LINE__, check_s.str()); \
+        } \
+    } while (0)
+
+// a fresh directory under $TMPDIR, removed with everything in it
+class TempDir {
+public:
+    TempDir();
+    ~TempDir();
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+
+    const std::filesystem::path& path() const { return root; }
+    // relative to the directory, parents are created
+    std::string file(const std::string& rel, const std::string& content) const;
+    std::string read(const std::string& rel) const;
+
+private:
+    std::filesystem::path root;
+};
@@ -0,0 +1,111 @@
+#include <string>
+
+#include "check.hpp"
+#include "gitignore.hpp"
+
+namespace {
+
+IgnoreFile rules(std::initializer_list<std::string_view> lines) {
+    IgnoreFile file;
+    for (auto line : lines) file.add_line(line);
+    return file;
+}
+
+// "ignored", "kept" (a negation rule matched) or "-" (no rule talks about it)
+std::string decide(const IgnoreFile& file, std::string_view path, bool is_dir = false) {
+    auto decision = file.match(path, is_dir);
+    if (!decision) return "-";
+    return *decision ? "ignored" : "kept";
+}
+
+}
+
+TEST(gitignore_unanchored_rules_match_at_any_depth) {
+    IgnoreFile file = rules({ "*.o", "node_modules" });
+    CHECK_EQ(decide(file, "x.o"), "ignored");
+    CHECK_EQ(decide(file, "src/deep/x.o"), "ignored");
+    CHECK_EQ(decide(file, "web/node_modules", true), "ignored");
+    CHECK_EQ(decide(file, "x.oo"), "-");
+}
+
+TEST(gitignore_slash_anchors_to_the_directory) {
+    IgnoreFile file = rules({ "/build", "doc/*.txt" });
+    CHECK_EQ(decide(file, "build", true), "ignored");
+    CHECK_EQ(decide(file, "src/build", true), "-");
+    CHECK_EQ(decide(file, "doc/a.txt"), "ignored");
+    CHECK_EQ(decide(file, "src/doc/a.txt"), "-");
+    CHECK_EQ(decide(file, "doc/sub/a.txt"), "-");
+}
+
+TEST(gitignore_last_matching_rule_wins) {
+    IgnoreFile file = rules({ "*.log", "!keep.log" });
+    CHECK_EQ(decide(file, "a.log"), "ignored");
+    CHECK_EQ(decide(file, "sub/keep.log"), "kept");
+
+    IgnoreFile again = rules({ "!keep.log", "*.log" });
+    CHECK_EQ(decide(again, "keep.log"), "ignored");
+}
+
+TEST(gitignore_trailing_slash_only_matches_directories) {
+    IgnoreFile file = rules({ "out/" });
+    CHECK_EQ(decide(file, "out", true), "ignored");
+    CHECK_EQ(decide(file, "out", false), "-");
+    CHECK_EQ(decide(file, "src/out", true), "ignored");
+}
+
+TEST(gitignore_comments_blanks_and_escapes) {
+    IgnoreFile file = rules({ "# comment", "", "   ", "\\#hash", "\\!bang", "trailing   ", "crlf\r" });
+    CHECK_EQ(decide(file, "# comment"), "-");
+    CHECK_EQ(decide(file, "#hash"), "ignored");
+    CHECK_EQ(decide(file, "!bang"), "ignored");
+    CHECK_EQ(decide(file, "trailing"), "ignored");
+    CHECK_EQ(decide(file, "crlf"), "ignored");
+}
+
+TEST(gitignore_file_in_a_subdirectory) {
+    TempDir dir;
+    std::string path = dir.file("src/.gitignore", "*.tmp\n/gen\n");
+    auto file = IgnoreFile::load(path, "src/");
+    CHECK(file.has_value());
+    if (!file) return;
+
+    CHECK_EQ(decide(*file, "src/a.tmp"), "ignored");
+    CHECK_EQ(decide(*file, "src/gen", true), "ignored");
+    CHECK_EQ(decide(*file, "src/x/gen", true), "-");
+    CHECK_EQ(decide(*file, "a.tmp"), "-"); // outside the file's directory
+    CHECK(!IgnoreFile::load(dir.file("empty/.gitignore", "# nothing\n"), "empty/"));
+}
+
+TEST(gitignore_deeper_files_override_parents) {
+    auto chain = IgnoreChain::extend(nullptr, rules({ "*.log" }));
+    TempDir dir;
+    auto sub = IgnoreFile::load(dir.file("sub/.gitignore", "!debug.log\n"), "sub/");
+    CHECK(sub.has_value());
+    if (!sub) return;
+    chain = IgnoreChain::extend(chain, std::move(*sub));
+
+    CHECK(IgnoreChain::ignored(chain.get(), "debug.log", false));
+    CHECK(IgnoreChain::ignored(chain.get(), "sub/x.log", false));
+    CHECK(!IgnoreChain::ignored(chain.get(), "sub/debug.log", false));
+    CHECK(!IgnoreChain::ignored(chain.get(), "sub/main.c", false));
+}
+
+TEST(gitignore_rules_from_above_the_root) {
+    // the walk starts in pkg/, the repository's rules still apply to it
+    TempDir dir;
+    dir.file(".git/info/exclude", "secret\n");
+    dir.file(".gitignore", "/pkg/gen/\n*.bak\n/top-only\n");
+    dir.file("pkg/.gitignore", "!keep.bak\n");
+    dir.file("pkg/src/main.c", "");
+
+    auto chain = IgnoreChain::for_root((dir.path() / "pkg").string());
+    CHECK(chain != nullptr);
+
+    CHECK(IgnoreChain::ignored(chain.get(), "gen", true));
+    CHECK(!IgnoreChain::ignored(chain.get(), "src/gen", true));
+    CHECK(IgnoreChain::ignored(chain.get(), "a.bak", false));
+    CHECK(!IgnoreChain::ignored(chain.get(), "keep.bak", false));
+    CHECK(IgnoreChain::ignored(chain.get(), "src/secret", false));
+    CHECK(!IgnoreChain::ignored(chain.get(), "top-only", false)); // anchored to the top, not to pkg/
+    CHECK(!IgnoreChain::ignored(chain.get(), "src/main.c", false));
+}
@@ -0,0 +1,86 @@
+#include <string_view>
+
+#include "check.hpp"
+#include "glob.hpp"
+
+namespace {
+
+struct GlobCase {
+    std::string_view pattern;
+    std::string_view path;
+    bool match;
+};
+
+void check_cases(std::initializer_list<GlobCase> cases) {
+    for (const auto& c : cases) {
+        if (glob_match(c.pattern, c.path) != c.match) {
+            check_failed(__FILE__, __LINE__, std::string(c.pattern) + " vs " + std::string(c.path) +
+                         (c.match ? " should match" : " should not match"));
+        }
+    }
+}
+
+}
+
+TEST(glob_stars_stay_in_one_segment) {
+    check_cases({
+        { "*.cpp", "main.cpp", true },
+        { "*.cpp", "src/main.cpp", false },
+        { "src/*.cpp", "src/main.cpp", true },
+        { "src/*", "src/a/b.cpp", false },
+        { "*a*b*", "xxaybz", true },
+        { "*a*b", "xxaybz", false },
+        { "a*", "a", true },
+        { "?.c", "a.c", true },
+        { "?.c", "ab.c", false },
+        { "a?c", "a/c", false },
+    });
+}
+
+TEST(glob_double_star_splits_at_every_segment) {
+    check_cases({
+        { "**", "a/b/c", true },
+        { "**/x.h", "x.h", true },
+        { "**/x.h", "a/b/x.h", true },
+        { "src/**/*.hpp", "src/c.hpp", true },
+        { "src/**/*.hpp", "src/a/b/c.hpp", true },
+        { "src/**/*.hpp", "lib/src/c.hpp", false },
+        { "a/**/b/**/c", "a/x/b/y/z/c", true },
+        { "a/**/b/**/c", "a/x/y/c", false },
+        { "a/**/**/b", "a/b", true },
+        { "a/**", "a/b/c", true },
+    });
+}
+
+TEST(glob_character_classes) {
+    check_cases({
+        { "[a-c]x", "bx", true },
+        { "[a-c]x", "dx", false },
+        { "[!a-c]x", "bx", false },
+        { "[!a-c]x", "dx", true },
+        { "[^a-c]x", "dx", true },
+        { "[]]", "]", true },
+        { "[a-]", "-", true },
+        { "[xyz].h", "y.h", true },
+        { "[\\]]", "]", true },
+        // no closing bracket: the '[' is just a character
+        { "[ab", "[ab", true },
+        { "[ab", "a", false },
+    });
+}
+
+TEST(glob_escapes) {
+    check_cases({
+        { "\\*", "*", true },
+        { "\\*", "a", false },
+        { "a\\?", "a?", true },
+        { "a\\?", "ab", false },
+        { "\\[x]", "[x]", true },
+    });
+
+    CHECK(glob_is_literal("src/main.cpp"));
+    CHECK(!glob_is_literal("src/*.cpp"));
+    CHECK(!glob_is_literal("a?"));
+    CHECK(!glob_is_literal("[ab]"));
+    CHECK(!glob_is_literal("\\*"));
+}
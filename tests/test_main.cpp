@@ -0,0 +1,81 @@
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+
+#include <unistd.h>
+
+#include "check.hpp"
+
+namespace {
+
+int failures_in_test = 0;
+
+}
+
+std::vector<TestCase>& test_registry() {
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+bool register_test(const char* name, void (*run)()) {
+    test_registry().push_back({ name, run });
+    return true;
+}
+
+void check_failed(const char* file, int line, const std::string& what) {
+    failures_in_test++;
+    std::cerr << file << ":" << line << ": CHECK failed: " << what << std::endl;
+}
+
+TempDir::TempDir() {
+    const char* tmp = std::getenv("TMPDIR");
+    std::string pattern = std::string(tmp && *tmp ? tmp : "/tmp") + "/claude-code-test-XXXXXX";
+    if (!mkdtemp(pattern.data())) throw std::runtime_error("mkdtemp failed");
+    root = pattern;
+}
+
+TempDir::~TempDir() {
+    std::error_code ec;
+    std::filesystem::remove_all(root, ec);
+}
+
+std::string TempDir::file(const std::string& rel, const std::string& content) const {
+    std::filesystem::path target = root / rel;
+    std::filesystem::create_directories(target.parent_path());
+    std::ofstream(target, std::ios::binary) << content;
+    return target.string();
+}
+
+std::string TempDir::read(const std::string& rel) const {
+    std::ifstream in(root / rel, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+int main(int argc, char* argv[]) {
+    std::string_view filter = argc > 1 ? argv[1] : "";
+
+    int run = 0;
+    int failed = 0;
+    for (const auto& test : test_registry()) {
+        if (!filter.empty() && std::string_view(test.name).find(filter) == std::string_view::npos) continue;
+
+        failures_in_test = 0;
+        try {
+            test.run();
+        }
+        catch (const std::exception& e) {
+            check_failed(test.name, 0, std::string("exception: ") + e.what());
+        }
+
+        run++;
+        if (failures_in_test) {
+            failed++;
+            std::cerr << "FAIL " << test.name << std::endl;
+        }
+    }
+
+    std::cout << (run - failed) << "/" << run << " tests passed" << std::endl;
+    return failed == 0 && run > 0 ? 0 : 1;
+}
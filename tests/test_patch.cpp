@@ -0,0 +1,190 @@
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "check.hpp"
+#include "edit_tools.hpp"
+#include "patch.hpp"
+
+namespace {
+
+struct PatchCase {
+    std::string_view name;
+    std::string_view before;
+    std::string_view diff;
+    std::string_view after;
+};
+
+// every diff goes through the parser as a single file, then onto before
+void check_cases(std::initializer_list<PatchCase> cases) {
+    for (const auto& c : cases) {
+        std::vector<FilePatch> files;
+        std::string error;
+        if (!parse_unified_diff(c.diff, files, error, true)) {
+            check_failed(__FILE__, __LINE__, std::string(c.name) + ": parse failed: " + error);
+            continue;
+        }
+
+        std::string text(c.before);
+        if (!apply_hunks(text, files[0].hunks, error)) {
+            check_failed(__FILE__, __LINE__, std::string(c.name) + ": apply failed: " + error);
+            continue;
+        }
+        if (text != c.after) {
+            check_failed(__FILE__, __LINE__, std::string(c.name) + "\n    got: " + text + "\n    expected: " + std::string(c.after));
+        }
+    }
+}
+
+// apply_patch works on paths relative to the working directory
+class WorkingDirectory {
+public:
+    explicit WorkingDirectory(const std::filesystem::path& dir) : saved(std::filesystem::current_path()) {
+        std::filesystem::current_path(dir);
+    }
+    ~WorkingDirectory() { std::filesystem::current_path(saved); }
+
+private:
+    std::filesystem::path saved;
+};
+
+}
+
+TEST(patch_recovers_blank_context_lines) {
+    check_cases({
+        // the space of a blank context line is gone
+        { "inner blank", "a\n\nb\nc\n",
+          "@@ -1,3 +1,3 @@\n a\n\n-b\n+B\n", "a\n\nB\nc\n" },
+        // a blank line before the next hunk is spacing, not context
+        { "spacing between hunks", "a\nb\nc\nd\n",
+          "@@ -1,2 +1,2 @@\n-a\n+A\n b\n\n@@ -4,1 +4,1 @@\n-d\n+D\n", "A\nb\nc\nD\n" },
+    });
+}
+
+TEST(patch_no_newline_markers) {
+    check_cases({
+        { "both sides", "a\nb",
+          "@@ -1,2 +1,2 @@\n a\n-b\n\\ No newline at end of file\n+c\n\\ No newline at end of file\n", "a\nc" },
+        { "old side only, the newline is added", "a\nb",
+          "@@ -1,2 +1,2 @@\n a\n-b\n\\ No newline at end of file\n+b\n", "a\nb\n" },
+        { "new side only, the newline is dropped", "a\nb\n",
+          "@@ -1,2 +1,2 @@\n a\n-b\n+b\n\\ No newline at end of file\n", "a\nb" },
+    });
+}
+
+TEST(patch_keeps_crlf_files_crlf) {
+    check_cases({
+        { "lf diff on a crlf file", "a\r\nb\r\nc\r\n",
+          "@@ -1,3 +1,3 @@\n a\n-b\n+B\n c\n", "a\r\nB\r\nc\r\n" },
+        { "crlf diff on a crlf file", "a\r\nb\r\nc\r\n",
+          "@@ -1,3 +1,3 @@\r\n a\r\n-b\r\n+B\r\n c\r\n", "a\r\nB\r\nc\r\n" },
+    });
+}
+
+TEST(patch_finds_hunks_away_from_their_line) {
+    check_cases({
+        { "wrong line number", "1\n2\n3\n4\n5\nx\ny\n8\n",
+          "@@ -2,2 +2,2 @@\n x\n-y\n+Y\n", "1\n2\n3\n4\n5\nx\nY\n8\n" },
+        { "nearest of two matches", "x\n1\n2\n3\n4\nx\n",
+          "@@ -5,1 +5,1 @@\n-x\n+X\n", "x\n1\n2\n3\n4\nX\n" },
+        { "trailing whitespace", "a  \nb\t\nc\n",
+          "@@ -1,3 +1,3 @@\n a\n-b\n+B\n c\n", "a  \nB\nc\n" },
+        { "a later hunk shifted by an earlier one", "a\nb\nc\nd\ne\n",
+          "@@ -1,1 +1,3 @@\n a\n+a1\n+a2\n@@ -4,1 +6,1 @@\n-d\n+D\n", "a\na1\na2\nb\nc\nD\ne\n" },
+    });
+
+    std::vector<FilePatch> files;
+    std::string error;
+    CHECK(parse_unified_diff("@@ -1,1 +1,1 @@\n-missing\n+x\n", files, error, true));
+    std::string text = "a\nb\n";
+    CHECK(!apply_hunks(text, files[0].hunks, error));
+    CHECK(error.find("does not match") != std::string::npos);
+}
+
+TEST(patch_tells_removed_dashes_from_file_headers) {
+    // "-- old" removed and "++ new" added look like a ---/+++ header
+    const std::string_view diff =
+        "--- a/sig.txt\n"
+        "+++ b/sig.txt\n"
+        "@@ -1,3 +1,3 @@\n"
+        " a\n"
+        "--- old\n"
+        "+++ new\n"
+        " b\n";
+
+    std::vector<FilePatch> files;
+    std::string error;
+    CHECK(parse_unified_diff(diff, files, error));
+    CHECK_EQ(files.size(), 1u);
+    if (files.size() != 1) return;
+    CHECK_EQ(files[0].new_path, "sig.txt");
+    CHECK_EQ(files[0].hunks.size(), 1u);
+    if (files[0].hunks.size() != 1) return;
+    CHECK_EQ(files[0].hunks[0].lines.size(), 4u);
+
+    std::string text = "a\n-- old\nb\n";
+    CHECK(apply_hunks(text, files[0].hunks, error));
+    CHECK_EQ(text, "a\n++ new\nb\n");
+
+    // a real header after a complete hunk still starts the next file
+    files.clear();
+    CHECK(parse_unified_diff(
+        "--- a/x\n+++ b/x\n@@ -1,1 +1,1 @@\n-x\n+X\n"
+        "--- a/y\n+++ b/y\n@@ -1,1 +1,1 @@\n-y\n+Y\n", files, error));
+    CHECK_EQ(files.size(), 2u);
+
+    // and so does one after a hunk whose counts were too big
+    files.clear();
+    CHECK(parse_unified_diff(
+        "--- a/x\n+++ b/x\n@@ -1,5 +1,5 @@\n-x\n+X\n"
+        "--- a/y\n+++ b/y\n@@ -1,1 +1,1 @@\n-y\n+Y\n", files, error));
+    CHECK_EQ(files.size(), 2u);
+}
+
+TEST(apply_patch_rolls_back_every_file) {
+    TempDir dir;
+    dir.file("a.txt", "a\nb\n");
+    // a file where the last patch wants a directory, its write fails
+    dir.file("blocked", "not a directory\n");
+
+    const std::string patch =
+        "--- /dev/null\n"
+        "+++ b/new.txt\n"
+        "@@ -0,0 +1,1 @@\n"
+        "+created\n"
+        "--- a/a.txt\n"
+        "+++ b/a.txt\n"
+        "@@ -1,2 +1,2 @@\n"
+        " a\n"
+        "-b\n"
+        "+B\n"
+        "--- /dev/null\n"
+        "+++ b/blocked/c.txt\n"
+        "@@ -0,0 +1,1 @@\n"
+        "+c\n";
+
+    std::string out;
+    {
+        WorkingDirectory cwd(dir.path());
+        ApplyPatchTool tool;
+        tool.execute({ {"patch", patch} }, ToolContext{}, out);
+    }
+
+    CHECK(out.starts_with("ERROR: writing blocked/c.txt"));
+    CHECK_EQ(dir.read("a.txt"), "a\nb\n");
+    CHECK(!std::filesystem::exists(dir.path() / "new.txt"));
+    CHECK_EQ(dir.read("blocked"), "not a directory\n");
+
+    // the same patch without the blocked file goes through whole
+    const std::string good = patch.substr(0, patch.find("--- /dev/null\n+++ b/blocked"));
+    {
+        WorkingDirectory cwd(dir.path());
+        ApplyPatchTool tool;
+        out.clear();
+        tool.execute({ {"patch", good} }, ToolContext{}, out);
+    }
+    CHECK(out.starts_with("SUCCESS: patched 2 files"));
+    CHECK_EQ(dir.read("a.txt"), "a\nB\n");
+    CHECK_EQ(dir.read("new.txt"), "created\n");
+}
@@ -0,0 +1,87 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "sse_stream.hpp"
+
+namespace {
+
+// {"choices":[{"delta":{"tool_calls":[part]}}]}
+json chunk_with(json part) {
+    json delta = json::object();
+    delta["tool_calls"] = json::array({ std::move(part) });
+    json choice = json::object();
+    choice["delta"] = std::move(delta);
+    json chunk = json::object();
+    chunk["choices"] = json::array({ std::move(choice) });
+    return chunk;
+}
+
+json tool_delta(const json& index, const std::string& arguments) {
+    json part = json::object();
+    part["function"] = { {"arguments", arguments} };
+    if (!index.is_null()) part["index"] = index;
+    return chunk_with(std::move(part));
+}
+
+json first_delta(size_t index, const std::string& name) {
+    json part = json::object();
+    part["index"] = index;
+    part["id"] = "call_" + name;
+    part["function"] = { {"name", name}, {"arguments", ""} };
+    return chunk_with(std::move(part));
+}
+
+}
+
+TEST(stream_assembler_rejects_bad_tool_call_indexes) {
+    for (const json& index : { json("0"), json(-1), json(1e9), json(1000000000), json(UINT64_MAX), json(0.5) }) {
+        StreamAssembler assembler;
+        size_t started = 0;
+        assembler.on_tool_call = [&](const json&) { started++; };
+
+        assembler.apply(first_delta(0, "read_file"));
+        assembler.apply(tool_delta(index, "{}"));
+
+        if (assembler.error().empty()) {
+            check_failed(__FILE__, __LINE__, "index " + index.dump() + " was accepted");
+        }
+        assembler.finish();
+        CHECK_EQ(started, 1u);
+        CHECK(assembler.take_message()["tool_calls"].size() == 1);
+    }
+
+    // the next index and a delta without one are fine
+    StreamAssembler assembler;
+    assembler.apply(first_delta(0, "read_file"));
+    assembler.apply(tool_delta(json(), "{\"path\":"));
+    assembler.apply(tool_delta(0, "\"a\"}"));
+    assembler.apply(first_delta(1, "glob"));
+    CHECK(assembler.error().empty());
+    json message = assembler.take_message();
+    CHECK_EQ(message["tool_calls"].size(), 2u);
+    CHECK_EQ(message["tool_calls"][0]["function"]["arguments"].get<std::string>(), "{\"path\":\"a\"}");
+}
+
+TEST(stream_assembler_rejects_deltas_for_started_calls) {
+    StreamAssembler assembler;
+    std::vector<std::string> started;
+    assembler.on_tool_call = [&](const json& call) {
+        started.push_back(call["function"]["arguments"].get<std::string>());
+    };
+
+    assembler.apply(first_delta(0, "read_file"));
+    assembler.apply(tool_delta(0, "{}"));
+    // call 0 is complete once call 1 begins, and starts with {}
+    assembler.apply(first_delta(1, "glob"));
+    CHECK_EQ(started.size(), 1u);
+
+    // history would say {}X while the tool ran with {}
+    assembler.apply(tool_delta(0, "X"));
+    CHECK(!assembler.error().empty());
+
+    json message = assembler.take_message();
+    CHECK_EQ(message["tool_calls"][0]["function"]["arguments"].get<std::string>(), "{}");
+    if (!started.empty()) CHECK_EQ(started[0], "{}");
+}
@@ -0,0 +1,64 @@
+#include <chrono>
+
+#include "check.hpp"
+#include "event_loop.hpp"
+#include "subprocess.hpp"
+
+namespace {
+
+using test_clock = std::chrono::steady_clock;
+
+SubprocessOptions short_timeout() {
+    SubprocessOptions options;
+    options.timeout = std::chrono::milliseconds(300);
+    return options;
+}
+
+double seconds_since(test_clock::time_point start) {
+    return std::chrono::duration<double>(test_clock::now() - start).count();
+}
+
+}
+
+TEST(subprocess_captures_output_and_status) {
+    SubprocessResult result = run_subprocess("echo out; echo err >&2; exit 3");
+    CHECK_EQ(result.exit_code, 3);
+    CHECK(!result.timed_out);
+    CHECK_EQ(result.out.text(), "out\n");
+    CHECK_EQ(result.err.text(), "err\n");
+}
+
+TEST(subprocess_timeout_holds_without_pipes) {
+    // the child closes both pipes right away, the deadline still has to hold
+    auto start = test_clock::now();
+    SubprocessResult result = run_subprocess("exec sleep 5 >/dev/null 2>&1", short_timeout());
+    CHECK(result.timed_out);
+    CHECK(seconds_since(start) < 2.0);
+    CHECK_EQ(result.exit_code, 128 + 15);
+
+    start = test_clock::now();
+    result = run_subprocess("exec >/dev/null 2>&1; true");
+    CHECK(!result.timed_out);
+    CHECK_EQ(result.exit_code, 0);
+    CHECK(seconds_since(start) < 1.0);
+}
+
+TEST(subprocess_async_timeout_holds_without_pipes) {
+    EventLoop loop;
+    auto start = test_clock::now();
+    SubprocessResult result = loop.block_on(run_subprocess_async(loop, "exec sleep 5 >/dev/null 2>&1", short_timeout()));
+    CHECK(result.timed_out);
+    CHECK(seconds_since(start) < 2.0);
+
+    result = loop.block_on(run_subprocess_async(loop, "exec >/dev/null 2>&1; exit 4"));
+    CHECK(!result.timed_out);
+    CHECK_EQ(result.exit_code, 4);
+}
+
+TEST(subprocess_timeout_kills_what_ignores_term) {
+    auto start = test_clock::now();
+    SubprocessResult result = run_subprocess("trap '' TERM; exec >/dev/null 2>&1; while :; do sleep 0.05; done", short_timeout());
+    CHECK(result.timed_out);
+    CHECK_EQ(result.exit_code, 128 + 9);
+    CHECK(seconds_since(start) < 2.0);
+}
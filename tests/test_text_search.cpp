@@ -0,0 +1,75 @@
+#include <string>
+
+#include "check.hpp"
+#include "search_tools.hpp"
+#include "text_search.hpp"
+
+// a 300 KB minified bundle, the kind that used to overflow std::regex's recursion
+std::string minified_line(size_t bytes) {
+    std::string line = "var a=1;";
+    while (line.size() < bytes) line += "x=function(e){return e+1};";
+    return line + "b";
+}
+
+TEST(literal_finder_finds_rare_byte_matches) {
+    LiteralFinder finder("needle", false);
+    CHECK_EQ(finder.find("haystack with a needle in it"), 16u);
+    CHECK_EQ(finder.find("needle needle", 1), 7u);
+    CHECK(finder.find("no match here") == std::string_view::npos);
+
+    LiteralFinder icase("NeEdLe", true);
+    CHECK_EQ(icase.find("a NEEDLE"), 2u);
+}
+
+TEST(required_literal_of_patterns) {
+    CHECK_EQ(required_literal("foo.*barbaz").value_or(""), "barbaz");
+    CHECK_EQ(required_literal("\\bparse_\\w+").value_or(""), "parse_");
+    CHECK(!required_literal("foo|bar"));
+    CHECK(!required_literal("a?b?"));
+    CHECK_EQ(required_literal("ab+c").value_or(""), "ab");
+
+    // the operand of an escape is not text the line has to contain
+    CHECK_EQ(required_literal("\\x41BC").value_or(""), "BC");
+    CHECK_EQ(required_literal("\\u0041BC").value_or(""), "BC");
+    CHECK_EQ(required_literal("\\cJabc").value_or(""), "abc");
+    CHECK_EQ(required_literal("(a)\\12xyz").value_or(""), "xyz");
+    CHECK_EQ(required_literal("\\0xy").value_or(""), "xy");
+
+    CHECK(LineMatcher("\\x41BC", false, false).matches("ABC"));
+    CHECK(LineMatcher("\\u0041BC", false, false).matches("ABC"));
+    CHECK(LineMatcher("a\\cJ?b", false, false).matches("ab"));
+    CHECK(LineMatcher("(ab)\\1cd", false, false).matches("ababcd"));
+}
+
+TEST(regex_on_long_line_does_not_overflow) {
+    std::string line = minified_line(300 * 1024);
+
+    LineMatcher greedy("var.*return", false, false);
+    CHECK(greedy.clips(line));
+    CHECK(greedy.matches(line)); // "var a=1;x=function(e){return" is inside the window
+
+    LineMatcher late("x=.*;b$", false, false);
+    CHECK(!late.matches(line)); // the end of the line is past what the regex sees
+
+    LineMatcher literal("};b", true, false);
+    CHECK(!literal.clips(line));
+    CHECK(literal.matches(line)); // literals search the whole line
+}
+
+TEST(grep_reports_clipped_long_lines) {
+    TempDir dir;
+    dir.file("bundle.min.js", minified_line(300 * 1024) + "\n");
+    dir.file("src.js", "var short = 1;\n");
+
+    GrepTool grep;
+    std::string out;
+    grep.execute({ {"pattern", "x=.*;b$"}, {"path", dir.path().string()} }, ToolContext{}, out);
+    CHECK(out.starts_with("No matches"));
+    CHECK(out.find("[1 long line only searched in their first 4 KB]") != std::string::npos);
+
+    out.clear();
+    grep.execute({ {"pattern", "var.*1"}, {"path", dir.path().string()} }, ToolContext{}, out);
+    CHECK(out.find("bundle.min.js:1: var a=1;") != std::string::npos);
+    CHECK(out.find("src.js:1: var short = 1;") != std::string::npos);
+    CHECK(out.find("long line") == std::string::npos);
+}
@@ -0,0 +1,142 @@
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "event_loop.hpp"
+#include "tool_executor.hpp"
+
+namespace {
+
+// answers with its "say" argument, throws when there is none.
+// exclusive, so every later call depends on the one before
+class EchoTool : public Tool {
+public:
+    static constexpr ToolParam PARAMS[] = {
+        { "say", "string", "What to answer" },
+    };
+    static constexpr ToolSpec SPEC{ "echo", "Answers with say", PARAMS };
+
+    const ToolSpec& spec() const override { return SPEC; }
+    ToolAccess access(const json& args) const override { return { "", true }; }
+
+    void execute(const json& args, const ToolContext& ctx, std::string& out) override {
+        // json::type_error when say is missing, like a tool reading its args carelessly
+        out = args.at("say").get<std::string>();
+    }
+};
+
+// the same, but it throws on the loop instead of on a pool thread
+class AsyncThrowTool : public Tool {
+public:
+    static constexpr ToolSpec SPEC{ "async_throw", "Throws", {} };
+
+    const ToolSpec& spec() const override { return SPEC; }
+    void execute(const json& args, const ToolContext& ctx, std::string& out) override {}
+    Task<void> execute_async(const json& args, const ToolContext& ctx, std::string& out) override {
+        throw std::runtime_error("boom");
+        co_return;
+    }
+};
+
+// claims its path exclusively and takes a while, look tells whether it ran already
+bool slow_write_done = false;
+
+class SlowWriteTool : public Tool {
+public:
+    static constexpr ToolParam PARAMS[] = {
+        { "path", "string", "What to claim", true },
+    };
+    static constexpr ToolSpec SPEC{ "slow_write", "Claims path for a while", PARAMS };
+
+    const ToolSpec& spec() const override { return SPEC; }
+    ToolAccess access(const json& args) const override { return { normalize_tool_path(args.at("path")), true }; }
+
+    void execute(const json& args, const ToolContext& ctx, std::string& out) override {}
+    Task<void> execute_async(const json& args, const ToolContext& ctx, std::string& out) override {
+        co_await ctx.loop->sleep_for(std::chrono::milliseconds(20));
+        slow_write_done = true;
+        out = "written";
+    }
+};
+
+// reads below its path, like grep or list_dir
+class LookTool : public Tool {
+public:
+    static constexpr ToolParam PARAMS[] = {
+        { "path", "string", "Where to look", true },
+    };
+    static constexpr ToolSpec SPEC{ "look", "Answers whether slow_write finished", PARAMS };
+
+    const ToolSpec& spec() const override { return SPEC; }
+    ToolAccess access(const json& args) const override { return { normalize_tool_path(args.at("path")), false }; }
+
+    void execute(const json& args, const ToolContext& ctx, std::string& out) override {}
+    Task<void> execute_async(const json& args, const ToolContext& ctx, std::string& out) override {
+        out = slow_write_done ? "after" : "before";
+        co_return;
+    }
+};
+
+json call(const std::string& name, const json& args) {
+    return { {"id", "call_" + name}, {"function", { {"name", name}, {"arguments", args.dump()} }} };
+}
+
+}
+
+TEST(tool_batch_survives_throwing_tools) {
+    EventLoop loop;
+    ToolRegistry registry;
+    registry.emplace<EchoTool>();
+    registry.emplace<AsyncThrowTool>();
+    ToolExecutor executor(loop, registry, 2);
+
+    ToolBatch batch(executor);
+    batch.add(call("echo", { {"say", "first"} }));
+    batch.add(call("echo", json::object()));
+    batch.add(call("async_throw", json::object()));
+    batch.add(call("echo", { {"say", "after"} }));
+
+    std::vector<std::string> results = loop.block_on(batch.results());
+    CHECK_EQ(results.size(), 4u);
+    if (results.size() != 4) return;
+
+    CHECK_EQ(results[0], "first");
+    CHECK(results[1].starts_with("ERROR: "));
+    CHECK_EQ(results[2], "ERROR: boom");
+    CHECK_EQ(results[3], "after");
+}
+
+TEST(tool_batch_orders_directories_against_files_below) {
+    EventLoop loop;
+    ToolRegistry registry;
+    registry.emplace<SlowWriteTool>();
+    registry.emplace<LookTool>();
+    ToolExecutor executor(loop, registry, 2);
+
+    auto run = [&](const std::string& written, const std::vector<std::string>& looked) {
+        slow_write_done = false;
+        ToolBatch batch(executor);
+        batch.add(call("slow_write", { {"path", written} }));
+        for (const auto& path : looked) batch.add(call("look", { {"path", path} }));
+        return loop.block_on(batch.results());
+    };
+
+    // a file written in the turn and a search of its directory
+    std::vector<std::string> results = run("/work/src/a.cpp", { "/work/src", "/work/srcs", "/work/src/", "/work", "/work/src/a.cpp.bak" });
+    CHECK_EQ(results.size(), 6u);
+    if (results.size() != 6) return;
+    CHECK_EQ(results[1], "after");
+    CHECK_EQ(results[2], "before");
+    CHECK_EQ(results[3], "after");
+    CHECK_EQ(results[4], "after");
+    CHECK_EQ(results[5], "before");
+
+    // and the other way round, a directory claimed and a file below it
+    results = run("/work/src", { "/work/src/a.cpp", "/work/lib/b.cpp" });
+    CHECK_EQ(results.size(), 3u);
+    if (results.size() != 3) return;
+    CHECK_EQ(results[1], "after");
+    CHECK_EQ(results[2], "before");
+}